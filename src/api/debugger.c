@@ -440,6 +440,32 @@ EXPORT void CALL DebugBreakpointTriggeredBy(uint32_t *flags, uint32_t *accessed)
 #endif
 }
 
+EXPORT m64p_error CALL DebugBreakpointSetCondition(unsigned int index, const char *condition, const char *log_value)
+{
+#ifdef DBG
+    if (index >= (unsigned int) g_NumBreakpoints)
+        return M64ERR_INPUT_INVALID;
+    if (set_breakpoint_condition((int) index, condition, log_value) != 0)
+        return M64ERR_INPUT_INVALID;
+    return M64ERR_SUCCESS;
+#else
+    DebugMessage(M64MSG_ERROR, "Bug: DebugBreakpointSetCondition() called, but Debugger not supported in Core library");
+    return M64ERR_UNSUPPORTED;
+#endif
+}
+
+EXPORT int CALL DebugBreakpointReadLog(m64p_dbg_log_entry *entries, int max)
+{
+#ifdef DBG
+    if (entries == NULL || max <= 0)
+        return 0;
+    return read_breakpoint_log(entries, max);
+#else
+    DebugMessage(M64MSG_ERROR, "Bug: DebugBreakpointReadLog() called, but Debugger not supported in Core library");
+    return 0;
+#endif
+}
+
 EXPORT uint32_t CALL DebugVirtualToPhysical(uint32_t address)
 {
 #ifdef DBG
@@ -1,13 +1,27 @@
 #include <SDL.h>
 #include "api/event.h"
 
+#define EVENT_RING_SIZE 256 /* must be a power of two */
+
 EventCallback gVICallback = NULL;
 EventIntCallback gResetCallback = NULL;
 EventCallback gPauseCallback = NULL;
 
+int gSyncCallbacks = 1;
+
 extern SDL_Window* g_backup_current_window;
 extern SDL_GLContext g_backup_current_context;
 
+/* The semaphores are created once and live for the whole process so that a
+ * consumer blocked in EventChannelWait never sees them go away under it. */
+static ML64_Event l_ring[EVENT_RING_SIZE];
+static SDL_atomic_t l_head;    /* written by the emulation thread only */
+static SDL_atomic_t l_tail;    /* written by the consumer thread only */
+static SDL_atomic_t l_dropped;
+static SDL_atomic_t l_enabled;
+static SDL_sem* l_pending = NULL;
+static SDL_sem* l_pause_wake = NULL;
+
 EXPORT void* CALL GetCurrentWindow(void) {
     return (void*)g_backup_current_window;
 }
@@ -28,5 +42,96 @@ EXPORT void CALL PauseSetCallback(EventCallback callback) {
     gPauseCallback = callback;
 }
 
+EXPORT void CALL EventSetSyncCallbacks(int enable) {
+    gSyncCallbacks = enable;
+}
+
+EXPORT void CALL EventChannelEnable(int enable) {
+    event_init();
+    SDL_AtomicSet(&l_enabled, enable != 0);
+}
+
+EXPORT int CALL EventChannelWait(ML64_Event* event, int timeout_ms) {
+    int tail;
+    int status;
+
+    if (l_pending == NULL) {
+        return 0;
+    }
+
+    if (timeout_ms < 0) {
+        status = SDL_SemWait(l_pending);
+    }
+    else if (timeout_ms == 0) {
+        status = SDL_SemTryWait(l_pending);
+    }
+    else {
+        status = SDL_SemWaitTimeout(l_pending, (Uint32)timeout_ms);
+    }
+
+    if (status != 0) {
+        return 0;
+    }
+
+    /* the semaphore count never exceeds the number of queued events */
+    tail = SDL_AtomicGet(&l_tail);
+    SDL_MemoryBarrierAcquire();
+    *event = l_ring[tail & (EVENT_RING_SIZE - 1)];
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&l_tail, tail + 1);
+    return 1;
+}
+
+EXPORT u32 CALL EventChannelDropped(void) {
+    return (u32)SDL_AtomicGet(&l_dropped);
+}
+
+void event_init(void)
+{
+    if (l_pending == NULL) {
+        l_pending = SDL_CreateSemaphore(0);
+    }
+    if (l_pause_wake == NULL) {
+        l_pause_wake = SDL_CreateSemaphore(0);
+    }
+}
+
+void event_post(u32 type, u32 count)
+{
+    int head;
+
+    if (!SDL_AtomicGet(&l_enabled) || l_pending == NULL) {
+        return;
+    }
+
+    head = SDL_AtomicGet(&l_head);
+    if (head - SDL_AtomicGet(&l_tail) >= EVENT_RING_SIZE) {
+        SDL_AtomicAdd(&l_dropped, 1);
+        return;
+    }
+
+    l_ring[head & (EVENT_RING_SIZE - 1)].type = type;
+    l_ring[head & (EVENT_RING_SIZE - 1)].count = count;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&l_head, head + 1);
+    SDL_SemPost(l_pending);
+}
+
+/* Sleeps the paused emulation thread until event_pause_wake is called or the
+ * timeout expires. Returns non-zero when woken up explicitly. */
+int event_pause_wait(unsigned int timeout_ms)
+{
+    if (l_pause_wake == NULL) {
+        SDL_Delay(timeout_ms);
+        return 0;
+    }
 
+    return SDL_SemWaitTimeout(l_pause_wake, timeout_ms) == 0;
+}
 
+void event_pause_wake(void)
+{
+    if (l_pause_wake != NULL && SDL_SemValue(l_pause_wake) == 0) {
+        SDL_SemPost(l_pause_wake);
+    }
+}
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include "m64p_types.h"
+#include "modloader_common.h"
 
 typedef void(*EventCallback)();
 typedef void(*EventIntCallback)(int);
@@ -18,9 +19,39 @@ EXPORT void CALL VISetCallback(EventCallback callback);
 EXPORT void CALL ResetSetCallback(EventIntCallback callback);
 EXPORT void CALL PauseSetCallback(EventCallback callback);
 
+/* Event channel
+ *
+ * VI, frame and pause transitions are pushed by the emulation thread into a
+ * single-producer / single-consumer ring and can be drained from any one
+ * consumer thread with EventChannelWait. Posting never blocks: when the ring
+ * is full the event is dropped and counted. The synchronous VI and pause
+ * callbacks above keep working unless disabled with EventSetSyncCallbacks. */
+typedef enum {
+    ML64_EVENT_VI     = 1,
+    ML64_EVENT_FRAME  = 2,
+    ML64_EVENT_PAUSE  = 3,
+    ML64_EVENT_RESUME = 4
+} ML64_EventType;
+
+typedef struct ML64_Event {
+    u32 type;
+    u32 count; /* VI count for ML64_EVENT_VI, frame number otherwise */
+} ML64_Event;
+
+EXPORT void CALL EventChannelEnable(int enable);
+EXPORT int CALL EventChannelWait(ML64_Event* event, int timeout_ms);
+EXPORT u32 CALL EventChannelDropped(void);
+EXPORT void CALL EventSetSyncCallbacks(int enable);
+
+extern int gSyncCallbacks;
+
+void event_init(void);
+void event_post(u32 type, u32 count);
+int event_pause_wait(unsigned int timeout_ms);
+void event_pause_wake(void);
+
 #ifdef __cplusplus
 }
 #endif
 
 #endif
-
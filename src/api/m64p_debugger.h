@@ -204,6 +204,30 @@ typedef void (*ptr_DebugBreakpointTriggeredBy)(uint32_t *, uint32_t *);
 EXPORT void CALL DebugBreakpointTriggeredBy(uint32_t *, uint32_t *);
 #endif
 
+/* DebugBreakpointSetCondition()
+ *
+ * This function attaches a condition and a log expression to the breakpoint
+ * at the given index. The breakpoint only triggers when the condition is
+ * non-zero; a logpoint records the value of its log expression for
+ * DebugBreakpointReadLog() instead of pausing. NULL or an empty string
+ * removes the expression.
+ */
+typedef m64p_error (*ptr_DebugBreakpointSetCondition)(unsigned int, const char *, const char *);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL DebugBreakpointSetCondition(unsigned int, const char *, const char *);
+#endif
+
+/* DebugBreakpointReadLog()
+ *
+ * This function removes up to the given number of the oldest logpoint hits
+ * from the core's log and copies them to the array. It returns the number of
+ * entries copied.
+ */
+typedef int (*ptr_DebugBreakpointReadLog)(m64p_dbg_log_entry *, int);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT int CALL DebugBreakpointReadLog(m64p_dbg_log_entry *, int);
+#endif
+
 /* DebugVirtualToPhysical()
  *
  * This function is used to translate virtual addresses to physical addresses.
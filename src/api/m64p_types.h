@@ -387,7 +387,8 @@ typedef enum {
   M64P_BKP_FLAG_READ = 0x02,
   M64P_BKP_FLAG_WRITE = 0x04,
   M64P_BKP_FLAG_EXEC = 0x08,
-  M64P_BKP_FLAG_LOG = 0x10 /* Log to the console when this breakpoint hits */
+  M64P_BKP_FLAG_LOG = 0x10, /* Log to the console when this breakpoint hits */
+  M64P_BKP_FLAG_LOGPOINT = 0x20 /* Record hits for DebugBreakpointReadLog() instead of pausing */
 } m64p_dbg_bkp_flags;
 
 #define BPT_CHECK_FLAG(a, b)  ((a.flags & b) == b)
@@ -401,6 +402,14 @@ typedef struct {
   unsigned int flags;
 } m64p_breakpoint;
 
+typedef struct {
+  uint32_t     pc;
+  uint32_t     accessed;   /* physical address for memory breakpoints */
+  unsigned int flags;      /* M64P_BKP_FLAG_* reason of the hit */
+  int          breakpoint; /* index of the logpoint when it was hit */
+  int64_t      value;      /* value of its log expression, 0 without one */
+} m64p_dbg_log_entry;
+
 /* ------------------------------------------------- */
 /* Structures and Types for Core Video Extension API */
 /* ------------------------------------------------- */
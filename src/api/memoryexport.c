@@ -1,21 +1,39 @@
 #include "api/memoryexport.h"
+#include "api/event.h"
 #include "device/device.h"
 
+#include <SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 extern struct device g_dev;
 
 extern u32* mem_base_u32(MemoryBase* mem_base, uint32_t address);
 
 ML64_CodeCallbackNode* g_ml64_codecallback_head = NULL;
+ML64_NativeReplacementNode* g_ml64_native_buckets[ML64_NATIVE_BUCKETS];
+u32 g_ml64_native_count = 0;
 u32 current_uuid = 0;
+static int l_rdram_exported = 0;
+static int l_rom_exported = 0;
+static SDL_atomic_t l_rom_export_pending;
+
+/* Compile log and code cache dump requests, queued by the front-end and
+   carried out on the emulation thread by DynarecApplyRequests */
+static SDL_SpinLock l_dynarec_request_lock = 0;
+static int l_compile_log_pending = 0;
+static char* l_compile_log_path = NULL;
+static char* l_code_cache_dump_path = NULL;
 
 EXPORT void* CALL Memory_GetBaseAddress(void) {
+    l_rdram_exported = 1;
     return g_mem_base.rdram;
 }
 
 EXPORT void* CALL ROM_GetBaseAddress(void) {
+    l_rom_exported = 1;
+    SDL_AtomicSet(&l_rom_export_pending, 1);
     return g_mem_base.cartrom;
 }
 
@@ -39,6 +57,99 @@ EXPORT void CALL InvalidateSpecificCachedCode(u32 address, u32 size) {
 #endif
 }
 
+EXPORT void CALL Dynarec_GetDispatchStats(ML64_DispatchStats* stats) {
+#ifdef NEW_DYNAREC
+    struct new_dynarec_dispatch_stats dispatch;
+    new_dynarec_get_dispatch_stats(&dispatch);
+    stats->lookups = dispatch.lookups;
+    stats->ht_misses = dispatch.ht_misses;
+    stats->compiles = dispatch.compiles;
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+EXPORT void CALL Dynarec_ResetDispatchStats(void) {
+#ifdef NEW_DYNAREC
+    new_dynarec_reset_dispatch_stats();
+#endif
+}
+
+EXPORT int CALL Dynarec_SetCompileLog(const char* path) {
+#ifdef NEW_DYNAREC
+    char* copy = NULL;
+    char* old;
+
+    if (path != NULL && (copy = strdup(path)) == NULL) {
+        return -1;
+    }
+
+    SDL_AtomicLock(&l_dynarec_request_lock);
+    old = l_compile_log_path;
+    l_compile_log_path = copy;
+    l_compile_log_pending = 1;
+    SDL_AtomicUnlock(&l_dynarec_request_lock);
+
+    free(old);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+EXPORT int CALL Dynarec_DumpCodeCache(const char* path) {
+#ifdef NEW_DYNAREC
+    char* copy;
+    char* old;
+
+    if (path == NULL || (copy = strdup(path)) == NULL) {
+        return -1;
+    }
+
+    SDL_AtomicLock(&l_dynarec_request_lock);
+    old = l_code_cache_dump_path;
+    l_code_cache_dump_path = copy;
+    SDL_AtomicUnlock(&l_dynarec_request_lock);
+
+    free(old);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void DynarecApplyRequests(void) {
+#ifdef NEW_DYNAREC
+    int log_pending;
+    char* log_path;
+    char* dump_path;
+
+    /* Mods patch the ROM through the pointer without invalidating, so
+       code compiled with ROM reads folded in goes once they have it */
+    if (SDL_AtomicCAS(&l_rom_export_pending, 1, 0)) {
+        invalidate_r4300_cached_code(&g_dev.r4300, R4300_KSEG1 + MM_CART_ROM, g_dev.cart.cart_rom.rom_size);
+    }
+
+    SDL_AtomicLock(&l_dynarec_request_lock);
+    log_pending = l_compile_log_pending;
+    log_path = l_compile_log_path;
+    dump_path = l_code_cache_dump_path;
+    l_compile_log_pending = 0;
+    l_compile_log_path = NULL;
+    l_code_cache_dump_path = NULL;
+    SDL_AtomicUnlock(&l_dynarec_request_lock);
+
+    if (log_pending) {
+        new_dynarec_set_compile_log(log_path);
+        free(log_path);
+    }
+    if (dump_path != NULL) {
+        new_dynarec_dump_code_cache(dump_path);
+        free(dump_path);
+    }
+#endif
+}
+
 ML64_CodeCallbackNode* CreateNode(u32 address, Ml64_CodeCallbackFn pfn, u32 uuid) {
     ML64_CodeCallbackNode* newNode = (ML64_CodeCallbackNode*)malloc(sizeof(ML64_CodeCallbackNode));
     if (!newNode) {
@@ -98,11 +209,86 @@ EXPORT u32 CALL InstallCodeCallback(u32 address, Ml64_CodeCallbackFn pfn) {
         return -1;
     }
     AppendNode(newNode);
+    r4300_update_hooks(&g_dev.r4300);
     InvalidateSpecificCachedCode(address, 8);
     return current_uuid++;
 }
 
 EXPORT void CALL UninstallCodeCallback(u32 uuid) {
     RemoveNode(uuid);
+    r4300_update_hooks(&g_dev.r4300);
+}
+
+#define NATIVE_BUCKET(address) (((address) >> 2) & (ML64_NATIVE_BUCKETS - 1))
+
+/* Drop whatever was compiled for the entry point, dirty copies included:
+   new_dynarec would otherwise bring an unchanged block back by checksum. */
+static void DiscardEntryPoint(u32 address) {
+    discard_r4300_cached_code(&g_dev.r4300, address, 4);
+}
+
+Ml64_NativeFn FindNativeReplacement(u32 address) {
+    ML64_NativeReplacementNode* node;
+
+    if (g_ml64_native_count == 0) {
+        return NULL;
+    }
+
+    for (node = g_ml64_native_buckets[NATIVE_BUCKET(address)]; node; node = node->next) {
+        if (node->address == address) {
+            return node->pfn;
+        }
+    }
+    return NULL;
+}
+
+EXPORT u32 CALL InstallNativeReplacement(u32 address, Ml64_NativeFn pfn) {
+    ML64_NativeReplacementNode* newNode;
+    u32 bucket = NATIVE_BUCKET(address);
+
+    if (!pfn || (address & 3)) {
+        return -1;
+    }
+
+    newNode = (ML64_NativeReplacementNode*)malloc(sizeof(ML64_NativeReplacementNode));
+    if (!newNode) {
+        return -1;
+    }
+    newNode->address = address;
+    newNode->pfn = pfn;
+    newNode->uuid = current_uuid;
+
+    /* the latest replacement of an address wins */
+    newNode->next = g_ml64_native_buckets[bucket];
+    g_ml64_native_buckets[bucket] = newNode;
+    g_ml64_native_count++;
+
+    r4300_update_hooks(&g_dev.r4300);
+    DiscardEntryPoint(address);
+    return current_uuid++;
 }
 
+EXPORT void CALL UninstallNativeReplacement(u32 uuid) {
+    ML64_NativeReplacementNode** cur;
+    ML64_NativeReplacementNode* node;
+    u32 bucket;
+
+    for (bucket = 0; bucket < ML64_NATIVE_BUCKETS; bucket++) {
+        for (cur = &g_ml64_native_buckets[bucket]; *cur; cur = &(*cur)->next) {
+            if ((*cur)->uuid == uuid) {
+                node = *cur;
+                *cur = node->next;
+                g_ml64_native_count--;
+                r4300_update_hooks(&g_dev.r4300);
+                DiscardEntryPoint(node->address);
+                free(node);
+                return;
+            }
+        }
+    }
+}
+
+int ModLoaderHooksActive(void) {
+    return l_rdram_exported || l_rom_exported || g_ml64_codecallback_head != NULL
+        || g_ml64_native_count != 0 || gVICallback != NULL;
+}
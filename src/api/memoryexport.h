@@ -16,6 +16,29 @@ EXPORT u32 CALL ROM_GetBaseSize(void);
 EXPORT void CALL InvalidateCachedCode(void);
 EXPORT void CALL InvalidateSpecificCachedCode(u32 address, u32 size);
 
+typedef struct {
+	u64 lookups;   /* compiled block lookups by address (indirect jumps, unlinked branches) */
+	u64 ht_misses; /* lookups that missed the dispatch table */
+	u64 compiles;  /* lookups that had to compile a new block */
+} ML64_DispatchStats;
+
+EXPORT void CALL Dynarec_GetDispatchStats(ML64_DispatchStats* stats);
+EXPORT void CALL Dynarec_ResetDispatchStats(void);
+
+/* Per-block compile log: guest range, host size, compile time and how often
+   the block was compiled/invalidated.  path=NULL closes the log.
+   Both requests are carried out by the emulation thread at the next VI
+   (or when it starts or stops); failures to open 'path' are logged then.
+   Returns 0 when the request was queued. */
+EXPORT int CALL Dynarec_SetCompileLog(const char* path);
+/* Dump the code cache map (live and dirty blocks, restore candidates) */
+EXPORT int CALL Dynarec_DumpCodeCache(const char* path);
+
+/* Carry out the queued compile log and dump requests, and drop code that
+   embeds ROM reads once the ROM was handed out. Emulation thread only,
+   outside of the recompiler. */
+void DynarecApplyRequests(void);
+
 typedef void(*Ml64_CodeCallbackFn)(void);
 
 EXPORT u32 CALL InstallCodeCallback(u32 address, Ml64_CodeCallbackFn pfn);
@@ -31,6 +54,36 @@ typedef struct ML64_CodeCallbackNode  {
 
 extern ML64_CodeCallbackNode* g_ml64_codecallback_head;
 
+/* Native replacement for the guest function starting at 'address'.
+   It gets the GPR file (a0-a3 are gpr[4..7], stacked arguments start at
+   gpr[29]+16), leaves its results in gpr[2]/gpr[3] (sign-extended like
+   the guest would) and the guest resumes
+   at gpr[31] without executing the function. */
+typedef void(*Ml64_NativeFn)(u64* gpr);
+
+EXPORT u32 CALL InstallNativeReplacement(u32 address, Ml64_NativeFn pfn);
+EXPORT void CALL UninstallNativeReplacement(u32 uuid);
+
+typedef struct ML64_NativeReplacementNode {
+	struct ML64_NativeReplacementNode* next;
+	Ml64_NativeFn pfn;
+	u32 address;
+	u32 uuid;
+} ML64_NativeReplacementNode;
+
+#define ML64_NATIVE_BUCKETS 256
+
+extern ML64_NativeReplacementNode* g_ml64_native_buckets[ML64_NATIVE_BUCKETS];
+extern u32 g_ml64_native_count;
+
+/* NULL when nothing replaces the function at 'address' */
+Ml64_NativeFn FindNativeReplacement(u32 address);
+
+/* Whether a mod may change guest state behind the emulation's back:
+   RDRAM or cart ROM was handed out, or code callbacks, native
+   replacements or a VI callback are installed */
+int ModLoaderHooksActive(void);
+
 #ifdef __cplusplus
 }
 #endif
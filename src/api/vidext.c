@@ -112,6 +112,11 @@ int VidExt_VideoRunning(void)
     return l_VideoOutputActive;
 }
 
+int VidExt_Overridden(void)
+{
+    return l_VideoExtensionActive;
+}
+
 /* video extension functions to be called by the video plugin */
 EXPORT m64p_error CALL VidExt_Init(void)
 {
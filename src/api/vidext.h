@@ -34,5 +34,6 @@ extern m64p_error OverrideVideoFunctions(m64p_video_extension_functions *VideoFu
 /* these functions are only used by the core */
 extern int VidExt_InFullscreenMode(void);
 extern int VidExt_VideoRunning(void);
+extern int VidExt_Overridden(void);
 
 #endif /* API_VIDEXT_H */
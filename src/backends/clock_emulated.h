@@ -0,0 +1,43 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - clock_emulated.h                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_BACKENDS_CLOCK_EMULATED_H
+#define M64P_BACKENDS_CLOCK_EMULATED_H
+
+#include "backends/api/clock_backend.h"
+
+#include <time.h>
+
+struct vi_controller;
+
+/* Clock backend derived from emulated time (number of VI interrupts since power-on)
+ * instead of host wall-clock. Two runs with the same inputs will see the same RTC values.
+ */
+struct emulated_clock
+{
+    time_t epoch;                   /* time reported at power-on */
+    const struct vi_controller* vi;
+};
+
+extern const struct clock_backend_interface g_iclock_emulated;
+
+#endif
@@ -25,14 +25,59 @@
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 #include "dbg_breakpoints.h"
+#include "dbg_condition.h"
 #include "dbg_debugger.h"
 #include "device/memory/memory.h"
+#include "device/r4300/r4300_core.h"
+#include "main/main.h"
 
 #ifdef DBG
 
+#define BREAKPOINT_LOG_SIZE 1024
+
 int g_NumBreakpoints=0;
 m64p_breakpoint g_Breakpoints[BREAKPOINTS_MAX_NUMBER];
 
+/* Compiled expressions of each breakpoint, NULL when it has none. The
+ * front-end replaces them while the emulation thread evaluates them, so
+ * both hold expressions_lock; breakpoints without any are hit lock-free. */
+static struct {
+    struct dbg_condition* condition;
+    struct dbg_condition* log_value;
+} g_BreakpointExpressions[BREAKPOINTS_MAX_NUMBER];
+static SDL_mutex *expressions_lock;
+
+/* Code range to discard for changed execution breakpoints. The front-end
+ * changes breakpoints while the emulation runs, so the discard is left to
+ * the emulation thread (apply_breakpoint_changes). */
+static int discard_pending;
+static uint32_t discard_begin, discard_end;
+static SDL_mutex *discard_lock;
+
+/* Logpoint hits waiting for the front-end; the oldest are overwritten */
+static m64p_dbg_log_entry g_BreakpointLog[BREAKPOINT_LOG_SIZE];
+static unsigned int log_start, log_count;
+static SDL_mutex *log_lock;
+
+void init_breakpoints(void)
+{
+    log_start = log_count = 0;
+    log_lock = SDL_CreateMutex();
+    expressions_lock = SDL_CreateMutex();
+    discard_pending = 0;
+    discard_lock = SDL_CreateMutex();
+}
+
+void destroy_breakpoints(void)
+{
+    SDL_DestroyMutex(log_lock);
+    log_lock = NULL;
+    SDL_DestroyMutex(expressions_lock);
+    expressions_lock = NULL;
+    SDL_DestroyMutex(discard_lock);
+    discard_lock = NULL;
+}
+
 int add_breakpoint(struct memory* mem, uint32_t address)
 {
     if (g_NumBreakpoints == BREAKPOINTS_MAX_NUMBER) {
@@ -65,6 +110,56 @@ int add_breakpoint_struct(struct memory* mem, m64p_breakpoint *newbp)
     return g_NumBreakpoints++;
 }
 
+/* The recompilers compile a check into code with an execution breakpoint,
+ * so whatever was compiled for the range has to go when one changes. */
+static void discard_breakpoint_code(const m64p_breakpoint* bpt)
+{
+    uint32_t begin = bpt->address;
+    uint32_t end = bpt->endaddr;
+
+    if (!BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_EXEC))
+        return;
+
+    /* wrapping ranges discard everything */
+    if (end < begin) {
+        begin = 0;
+        end = 0xFFFFFFFF;
+    }
+
+    SDL_LockMutex(discard_lock);
+    if (!discard_pending) {
+        discard_begin = begin;
+        discard_end = end;
+        discard_pending = 1;
+    }
+    else {
+        if (begin < discard_begin)
+            discard_begin = begin;
+        if (end > discard_end)
+            discard_end = end;
+    }
+    SDL_UnlockMutex(discard_lock);
+}
+
+void apply_breakpoint_changes(void)
+{
+    uint32_t begin, end;
+
+    if (!discard_pending)
+        return;
+
+    SDL_LockMutex(discard_lock);
+    begin = discard_begin;
+    end = discard_end;
+    discard_pending = 0;
+    SDL_UnlockMutex(discard_lock);
+
+    if (end >= 0xFFFFFFFC)
+        discard_r4300_cached_code(&g_dev.r4300, 0, 0);
+    else
+        discard_r4300_cached_code(&g_dev.r4300, begin, (size_t)(end - begin) + 4);
+}
+
 void enable_breakpoint(struct memory* mem, int bpt)
 {
     m64p_breakpoint *curBpt = g_Breakpoints + bpt;
@@ -83,6 +178,7 @@ void enable_breakpoint(struct memory* mem, int bpt)
     }
 
     BPT_SET_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
+    discard_breakpoint_code(curBpt);
 }
 
 void disable_breakpoint(struct memory* mem, int bpt)
@@ -105,6 +201,41 @@ void disable_breakpoint(struct memory* mem, int bpt)
     }
 
     BPT_CLEAR_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
+    discard_breakpoint_code(curBpt);
+}
+
+int set_breakpoint_condition(int bpt, const char *condition, const char *log_value)
+{
+    struct dbg_condition *new_condition = NULL;
+    struct dbg_condition *new_log_value = NULL;
+    struct dbg_condition *old_condition, *old_log_value;
+
+    if (bpt < 0 || bpt >= g_NumBreakpoints)
+        return -1;
+
+    if (condition != NULL && condition[0] != '\0') {
+        new_condition = dbg_condition_compile(condition);
+        if (new_condition == NULL)
+            return -1;
+    }
+    if (log_value != NULL && log_value[0] != '\0') {
+        new_log_value = dbg_condition_compile(log_value);
+        if (new_log_value == NULL) {
+            dbg_condition_free(new_condition);
+            return -1;
+        }
+    }
+
+    SDL_LockMutex(expressions_lock);
+    old_condition = g_BreakpointExpressions[bpt].condition;
+    old_log_value = g_BreakpointExpressions[bpt].log_value;
+    g_BreakpointExpressions[bpt].condition = new_condition;
+    g_BreakpointExpressions[bpt].log_value = new_log_value;
+    SDL_UnlockMutex(expressions_lock);
+
+    dbg_condition_free(old_condition);
+    dbg_condition_free(old_log_value);
+    return 0;
 }
 
 void remove_breakpoint_by_num(struct memory* mem, int bpt)
@@ -114,10 +245,19 @@ void remove_breakpoint_by_num(struct memory* mem, int bpt)
     if (BPT_CHECK_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED))
         disable_breakpoint(mem, bpt);
 
-    for (curBpt=bpt+1; curBpt<g_NumBreakpoints; curBpt++)
+    SDL_LockMutex(expressions_lock);
+    dbg_condition_free(g_BreakpointExpressions[bpt].condition);
+    dbg_condition_free(g_BreakpointExpressions[bpt].log_value);
+
+    for (curBpt=bpt+1; curBpt<g_NumBreakpoints; curBpt++) {
         g_Breakpoints[curBpt-1]=g_Breakpoints[curBpt];
+        g_BreakpointExpressions[curBpt-1]=g_BreakpointExpressions[curBpt];
+    }
 
     g_NumBreakpoints--;
+    g_BreakpointExpressions[g_NumBreakpoints].condition = NULL;
+    g_BreakpointExpressions[g_NumBreakpoints].log_value = NULL;
+    SDL_UnlockMutex(expressions_lock);
 }
 
 void remove_breakpoint_by_address(struct memory* mem, uint32_t address)
@@ -136,6 +276,9 @@ void replace_breakpoint_num(struct memory* mem, int bpt, m64p_breakpoint *copyof
     if (BPT_CHECK_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED))
         disable_breakpoint(mem, bpt);
 
+    /* the replacement starts without the old one's expressions */
+    set_breakpoint_condition(bpt, NULL, NULL);
+
     memcpy(&g_Breakpoints[bpt], copyofnew, sizeof(m64p_breakpoint));
 
     if (BPT_CHECK_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED)) {
@@ -144,32 +287,104 @@ void replace_breakpoint_num(struct memory* mem, int bpt, m64p_breakpoint *copyof
     }
 }
 
+static int breakpoint_matches(const m64p_breakpoint *bpt, uint32_t address, uint32_t size, uint32_t flags)
+{
+    uint64_t endaddr = ((uint64_t)address) + ((uint64_t)size) - 1;
+
+    if((bpt->flags & flags) != flags)
+        return 0;
+
+    if(bpt->endaddr < bpt->address)
+        return (endaddr >= bpt->address) || (address <= bpt->endaddr);
+    else // endaddr >= address
+        return (endaddr >= bpt->address) && (address <= bpt->endaddr);
+}
+
 int lookup_breakpoint(uint32_t address, uint32_t size, uint32_t flags)
 {
     int i;
-    uint64_t endaddr = ((uint64_t)address) + ((uint64_t)size) - 1;
 
     for( i=0; i < g_NumBreakpoints; i++)
     {
-        if((g_Breakpoints[i].flags & flags) == flags)
-        {
-            if(g_Breakpoints[i].endaddr < g_Breakpoints[i].address)
-            {
-                if((endaddr >= g_Breakpoints[i].address) ||
-                        (address <= g_Breakpoints[i].endaddr))
-                    return i;
-            }
-            else // endaddr >= address
-            {
-                if((endaddr >= g_Breakpoints[i].address) &&
-                        (address <= g_Breakpoints[i].endaddr))
-                    return i;
-            }
-        }
+        if (breakpoint_matches(&g_Breakpoints[i], address, size, flags))
+            return i;
     }
     return -1;
 }
 
+static void record_logpoint(int bpt, uint32_t pc, uint32_t address, uint32_t flags, int64_t value)
+{
+    m64p_dbg_log_entry *entry;
+
+    SDL_LockMutex(log_lock);
+    if (log_count == BREAKPOINT_LOG_SIZE) {
+        log_start = (log_start + 1) % BREAKPOINT_LOG_SIZE;
+        log_count--;
+    }
+    entry = &g_BreakpointLog[(log_start + log_count++) % BREAKPOINT_LOG_SIZE];
+    entry->pc = pc;
+    entry->accessed = address;
+    entry->flags = flags;
+    entry->breakpoint = bpt;
+    entry->value = value;
+    SDL_UnlockMutex(log_lock);
+}
+
+/* Whether breakpoint 'bpt', which matches the access, stops execution: its
+ * condition holds and it isn't a logpoint, which only records the hit */
+static int breakpoint_hit(int bpt, uint32_t pc, uint32_t address, uint32_t flags)
+{
+    int logpoint = BPT_CHECK_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_LOGPOINT);
+    int hit = 1;
+    int64_t value = 0;
+
+    if (g_BreakpointExpressions[bpt].condition != NULL
+     || g_BreakpointExpressions[bpt].log_value != NULL) {
+        SDL_LockMutex(expressions_lock);
+        if (g_BreakpointExpressions[bpt].condition != NULL)
+            hit = dbg_condition_eval(g_BreakpointExpressions[bpt].condition, pc, address) != 0;
+        if (hit && logpoint && g_BreakpointExpressions[bpt].log_value != NULL)
+            value = dbg_condition_eval(g_BreakpointExpressions[bpt].log_value, pc, address);
+        SDL_UnlockMutex(expressions_lock);
+    }
+
+    if (hit && logpoint) {
+        record_logpoint(bpt, pc, address, flags & ~M64P_BKP_FLAG_ENABLED, value);
+        hit = 0;
+    }
+    return hit;
+}
+
+int lookup_breakpoint_hit(uint32_t pc, uint32_t address, uint32_t size, uint32_t flags)
+{
+    int i;
+
+    for (i = 0; i < g_NumBreakpoints; i++)
+    {
+        if (breakpoint_matches(&g_Breakpoints[i], address, size, flags)
+         && breakpoint_hit(i, pc, address, flags))
+            return i;
+    }
+    return -1;
+}
+
+int read_breakpoint_log(m64p_dbg_log_entry *entries, int max)
+{
+    int n = 0;
+
+    if (log_lock == NULL)
+        return 0;
+
+    SDL_LockMutex(log_lock);
+    while (n < max && log_count > 0) {
+        entries[n++] = g_BreakpointLog[log_start];
+        log_start = (log_start + 1) % BREAKPOINT_LOG_SIZE;
+        log_count--;
+    }
+    SDL_UnlockMutex(log_lock);
+    return n;
+}
+
 int check_breakpoints(uint32_t address)
 {
     return lookup_breakpoint(address, 1, M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_EXEC);
@@ -184,7 +399,7 @@ int check_breakpoints_on_mem_access(uint32_t pc, uint32_t address, uint32_t size
     //functions only need to call it and can discard the result.
     int bpt;
     if (g_dbg_runstate == M64P_DBG_RUNSTATE_RUNNING) {
-        bpt = lookup_breakpoint(address, size, flags);
+        bpt = lookup_breakpoint_hit(pc, address, size, flags);
         if (bpt != -1) {
             breakpointAccessed = address;
             breakpointFlag = flags;
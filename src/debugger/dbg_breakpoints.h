@@ -37,7 +37,19 @@ void remove_breakpoint_by_address(struct memory* mem, uint32_t address);
 void remove_breakpoint_by_num(struct memory* mem, int bpt);
 void enable_breakpoint(struct memory* mem, int breakpoint);
 void disable_breakpoint(struct memory* mem, int breakpoint);
+void init_breakpoints(void);
+void destroy_breakpoints(void);
+/* Discard the code compiled for execution breakpoints changed since the
+ * last call. Emulation thread only. */
+void apply_breakpoint_changes(void);
 int check_breakpoints(uint32_t address);
+/* Breakpoint to stop at for the access, if any. Conditions are evaluated
+ * and logpoints recorded on the way. */
+int lookup_breakpoint_hit(uint32_t pc, uint32_t address, uint32_t size, uint32_t flags);
+/* Compile condition and log_value for breakpoint bpt; NULL or "" clears */
+int set_breakpoint_condition(int bpt, const char *condition, const char *log_value);
+/* Take up to max of the oldest logpoint hits; returns how many */
+int read_breakpoint_log(m64p_dbg_log_entry *entries, int max);
 int check_breakpoints_on_mem_access(uint32_t pc, uint32_t address, uint32_t size, uint32_t flags);
 int lookup_breakpoint(uint32_t address, uint32_t size, uint32_t flags);
 int log_breakpoint(uint32_t PC, uint32_t Flag, uint32_t Access);
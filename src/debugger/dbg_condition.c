@@ -0,0 +1,515 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - dbg_condition.c                                          *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "dbg_condition.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "device/device.h"
+#include "device/r4300/r4300_core.h"
+#include "main/main.h"
+
+#define CONDITION_MAX_CODE  256
+#define CONDITION_MAX_STACK 16
+
+enum
+{
+    OP_END,
+    OP_IMM,     /* 8-byte immediate follows */
+    OP_GPR,     /* register number follows */
+    OP_PC,
+    OP_HI,
+    OP_LO,
+    OP_ADDR,
+    OP_LOAD8,
+    OP_LOAD16,
+    OP_LOAD32,
+    OP_LOAD64,
+    OP_NEG,
+    OP_NOT,
+    OP_LNOT,
+    OP_BOOL,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_ADD,
+    OP_SUB,
+    OP_SHL,
+    OP_SHR,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_XOR,
+    OP_OR,
+    OP_ANDTHEN, /* 2-byte skip follows: taken with 0 on the stack */
+    OP_ORELSE   /* 2-byte skip follows: taken with 1 on the stack */
+};
+
+struct dbg_condition
+{
+    size_t length;
+    uint8_t code[1];
+};
+
+static const char* const gpr_names[32] =
+{
+    "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+    "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+    "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
+
+/* Longer tokens ahead of their prefixes */
+static const struct
+{
+    const char* token;
+    int level;
+    uint8_t op;
+} binary_ops[] =
+{
+    { "||", 1, OP_ORELSE },
+    { "&&", 2, OP_ANDTHEN },
+    { "|",  3, OP_OR },
+    { "^",  4, OP_XOR },
+    { "&",  5, OP_AND },
+    { "==", 6, OP_EQ },
+    { "!=", 6, OP_NE },
+    { "<<", 8, OP_SHL },
+    { ">>", 8, OP_SHR },
+    { "<=", 7, OP_LE },
+    { ">=", 7, OP_GE },
+    { "<",  7, OP_LT },
+    { ">",  7, OP_GT },
+    { "+",  9, OP_ADD },
+    { "-",  9, OP_SUB },
+    { "*", 10, OP_MUL },
+    { "/", 10, OP_DIV },
+    { "%", 10, OP_MOD },
+};
+
+struct compiler
+{
+    const char* text;
+    const char* pos;
+    const char* error;
+    uint8_t code[CONDITION_MAX_CODE];
+    size_t length;
+    int depth;
+    int nesting;
+};
+
+static int parse_binary(struct compiler* c, int min_level);
+static int parse_unary(struct compiler* c);
+
+static int fail(struct compiler* c, const char* error)
+{
+    if (c->error == NULL)
+        c->error = error;
+    return 0;
+}
+
+static void skip_spaces(struct compiler* c)
+{
+    while (isspace((unsigned char)*c->pos))
+        ++c->pos;
+}
+
+static int emit(struct compiler* c, const void* bytes, size_t size)
+{
+    if (c->length + size > CONDITION_MAX_CODE)
+        return fail(c, "expression too long");
+
+    memcpy(c->code + c->length, bytes, size);
+    c->length += size;
+    return 1;
+}
+
+static int emit_op(struct compiler* c, uint8_t op)
+{
+    return emit(c, &op, 1);
+}
+
+/* Operand pushes grow the stack, binary operators shrink it */
+static int push(struct compiler* c)
+{
+    return ++c->depth <= CONDITION_MAX_STACK || fail(c, "expression nested too deeply");
+}
+
+static int emit_push(struct compiler* c, uint8_t op, const void* operand, size_t size)
+{
+    return push(c) && emit_op(c, op) && emit(c, operand, size);
+}
+
+static int parse_number(struct compiler* c)
+{
+    char* end;
+    uint64_t value;
+    int64_t imm;
+
+    if (c->pos[0] == '0' && (c->pos[1] == 'x' || c->pos[1] == 'X'))
+    {
+        value = strtoull(c->pos + 2, &end, 16);
+        if (end == c->pos + 2)
+            return fail(c, "bad number");
+        if (end - (c->pos + 2) <= 8)
+            value = (uint64_t)(int64_t)(int32_t)value;
+    }
+    else
+    {
+        value = strtoull(c->pos, &end, 10);
+    }
+
+    c->pos = end;
+    imm = (int64_t)value;
+    return emit_push(c, OP_IMM, &imm, sizeof(imm));
+}
+
+static int parse_load(struct compiler* c, uint8_t op)
+{
+    ++c->pos; /* [ */
+    if (!parse_binary(c, 1))
+        return 0;
+
+    skip_spaces(c);
+    if (*c->pos != ']')
+        return fail(c, "missing ]");
+    ++c->pos;
+
+    return emit_op(c, op);
+}
+
+static int parse_name(struct compiler* c)
+{
+    const char* start = c->pos;
+    size_t length;
+    uint8_t reg;
+
+    while (isalnum((unsigned char)*c->pos) || *c->pos == '_')
+        ++c->pos;
+    length = c->pos - start;
+
+    /* sized memory reads: b[x], h[x], w[x], d[x] */
+    if (length == 1 && *c->pos == '[')
+    {
+        switch (*start)
+        {
+        case 'b': return parse_load(c, OP_LOAD8);
+        case 'h': return parse_load(c, OP_LOAD16);
+        case 'w': return parse_load(c, OP_LOAD32);
+        case 'd': return parse_load(c, OP_LOAD64);
+        }
+    }
+
+#define IS_NAME(name) (length == sizeof(name) - 1 && strncmp(start, name, length) == 0)
+    if (IS_NAME("pc"))   return push(c) && emit_op(c, OP_PC);
+    if (IS_NAME("hi"))   return push(c) && emit_op(c, OP_HI);
+    if (IS_NAME("lo"))   return push(c) && emit_op(c, OP_LO);
+    if (IS_NAME("addr")) return push(c) && emit_op(c, OP_ADDR);
+    if (IS_NAME("s8"))   { reg = 30; return emit_push(c, OP_GPR, &reg, 1); }
+#undef IS_NAME
+
+    if (*start == 'r' && length >= 2 && length <= 3 && isdigit((unsigned char)start[1])
+     && (length == 2 || isdigit((unsigned char)start[2])))
+    {
+        int n = atoi(start + 1);
+        if (n < 32)
+        {
+            reg = (uint8_t)n;
+            return emit_push(c, OP_GPR, &reg, 1);
+        }
+    }
+
+    for (reg = 0; reg < 32; ++reg)
+    {
+        if (strlen(gpr_names[reg]) == length && strncmp(start, gpr_names[reg], length) == 0)
+            return emit_push(c, OP_GPR, &reg, 1);
+    }
+
+    c->pos = start;
+    return fail(c, "unknown name");
+}
+
+static int parse_operand(struct compiler* c)
+{
+    skip_spaces(c);
+
+    switch (*c->pos)
+    {
+    case '-':
+        ++c->pos;
+        return parse_unary(c) && emit_op(c, OP_NEG);
+    case '~':
+        ++c->pos;
+        return parse_unary(c) && emit_op(c, OP_NOT);
+    case '!':
+        ++c->pos;
+        return parse_unary(c) && emit_op(c, OP_LNOT);
+    case '(':
+        ++c->pos;
+        if (!parse_binary(c, 1))
+            return 0;
+        skip_spaces(c);
+        if (*c->pos != ')')
+            return fail(c, "missing )");
+        ++c->pos;
+        return 1;
+    case '[':
+        return parse_load(c, OP_LOAD32);
+    }
+
+    if (isdigit((unsigned char)*c->pos))
+        return parse_number(c);
+    if (isalpha((unsigned char)*c->pos))
+        return parse_name(c);
+
+    return fail(c, (*c->pos == '\0') ? "unexpected end" : "unexpected character");
+}
+
+/* Bounds the recursion on inputs like "((((..." that emit no code */
+static int parse_unary(struct compiler* c)
+{
+    int ok;
+
+    if (++c->nesting > 4 * CONDITION_MAX_STACK)
+        return fail(c, "expression nested too deeply");
+    ok = parse_operand(c);
+    --c->nesting;
+    return ok;
+}
+
+/* Precedence climbing over binary_ops */
+static int parse_binary(struct compiler* c, int min_level)
+{
+    size_t i, skip_at;
+    uint16_t skip;
+
+    if (!parse_unary(c))
+        return 0;
+
+    for (;;)
+    {
+        skip_spaces(c);
+        for (i = 0; i < sizeof(binary_ops) / sizeof(binary_ops[0]); ++i)
+        {
+            if (strncmp(c->pos, binary_ops[i].token, strlen(binary_ops[i].token)) == 0)
+                break;
+        }
+        if (i == sizeof(binary_ops) / sizeof(binary_ops[0]) || binary_ops[i].level < min_level)
+            return 1;
+
+        c->pos += strlen(binary_ops[i].token);
+
+        if (binary_ops[i].op == OP_ANDTHEN || binary_ops[i].op == OP_ORELSE)
+        {
+            /* the left operand is dropped when the right one is needed */
+            skip = 0;
+            if (!emit_op(c, binary_ops[i].op))
+                return 0;
+            skip_at = c->length;
+            if (!emit(c, &skip, sizeof(skip)))
+                return 0;
+            --c->depth;
+            if (!parse_binary(c, binary_ops[i].level + 1) || !emit_op(c, OP_BOOL))
+                return 0;
+            skip = (uint16_t)(c->length - skip_at - sizeof(skip));
+            memcpy(c->code + skip_at, &skip, sizeof(skip));
+        }
+        else
+        {
+            if (!parse_binary(c, binary_ops[i].level + 1) || !emit_op(c, binary_ops[i].op))
+                return 0;
+            --c->depth;
+        }
+    }
+}
+
+struct dbg_condition* dbg_condition_compile(const char* text)
+{
+    struct compiler c;
+    struct dbg_condition* condition;
+
+    memset(&c, 0, sizeof(c));
+    c.text = c.pos = text;
+
+    if (parse_binary(&c, 1))
+    {
+        skip_spaces(&c);
+        if (*c.pos != '\0')
+            fail(&c, "unexpected character");
+    }
+    if (c.error == NULL)
+        emit_op(&c, OP_END);
+
+    if (c.error != NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Breakpoint condition \"%s\": %s at column %d",
+                     text, c.error, (int)(c.pos - c.text) + 1);
+        return NULL;
+    }
+
+    condition = malloc(sizeof(*condition) + c.length);
+    if (condition == NULL)
+        return NULL;
+
+    condition->length = c.length;
+    memcpy(condition->code, c.code, c.length);
+    return condition;
+}
+
+void dbg_condition_free(struct dbg_condition* condition)
+{
+    free(condition);
+}
+
+/* Memory reads bypass the memory map: going through it could hit read
+ * breakpoints (evaluating conditions again) or raise TLB exceptions. Only
+ * RDRAM and cart ROM are read, anything else reads as 0. Addresses below
+ * kseg0 that the TLB doesn't map are physical, which is what addr holds
+ * for memory breakpoints. */
+static uint8_t peek_8(uint32_t address)
+{
+    uint32_t phys, word;
+    uint32_t entry;
+
+    if ((address & UINT32_C(0xc0000000)) == UINT32_C(0x80000000)) {
+        phys = address & UINT32_C(0x1fffffff);
+    }
+    else {
+        entry = g_dev.r4300.cp0.tlb.LUT_r[address >> 12];
+        if (entry != 0) {
+            phys = ((entry & UINT32_C(0xfffff000)) | (address & UINT32_C(0xfff))) & UINT32_C(0x1fffffff);
+        }
+        else if (address < UINT32_C(0x20000000)) {
+            phys = address;
+        }
+        else {
+            return 0;
+        }
+    }
+
+    if (phys < g_dev.rdram.dram_size) {
+        word = g_dev.rdram.dram[phys / 4];
+    }
+    else if (phys >= MM_CART_ROM && phys - MM_CART_ROM < g_dev.cart.cart_rom.rom_size) {
+        memcpy(&word, g_dev.cart.cart_rom.rom + ((phys - MM_CART_ROM) & ~UINT32_C(3)), sizeof(word));
+    }
+    else {
+        return 0;
+    }
+
+    return (uint8_t)(word >> (8 * (3 - (phys & 3))));
+}
+
+static uint64_t peek(uint32_t address, unsigned int size)
+{
+    uint64_t value = 0;
+
+    while (size-- > 0) {
+        value = (value << 8) | peek_8(address++);
+    }
+
+    return value;
+}
+
+int64_t dbg_condition_eval(const struct dbg_condition* condition, uint32_t pc, uint32_t address)
+{
+    int64_t stack[CONDITION_MAX_STACK + 1];
+    int64_t* top = stack;
+    const uint8_t* ip = condition->code;
+    int64_t* regs = r4300_regs(&g_dev.r4300);
+    int64_t a, b;
+    uint16_t skip;
+    uint8_t op;
+
+#define UNARY(expr)  a = *top; *top = (expr); break
+#define BINARY(expr) b = *top--; a = *top; *top = (expr); break
+
+    for (;;)
+    {
+        switch (*ip++)
+        {
+        case OP_END:
+            return *top;
+        case OP_IMM:
+            memcpy(++top, ip, sizeof(*top));
+            ip += sizeof(*top);
+            break;
+        case OP_GPR:    *++top = regs[*ip++]; break;
+        case OP_PC:     *++top = (int64_t)(int32_t)pc; break;
+        case OP_HI:     *++top = *r4300_mult_hi(&g_dev.r4300); break;
+        case OP_LO:     *++top = *r4300_mult_lo(&g_dev.r4300); break;
+        case OP_ADDR:   *++top = address; break;
+        case OP_LOAD8:  UNARY(peek((uint32_t)a, 1));
+        case OP_LOAD16: UNARY(peek((uint32_t)a & ~UINT32_C(1), 2));
+        case OP_LOAD32: UNARY((int32_t)peek((uint32_t)a, 4));
+        case OP_LOAD64: UNARY((int64_t)peek((uint32_t)a, 8));
+        case OP_NEG:    UNARY((int64_t)(0 - (uint64_t)a));
+        case OP_NOT:    UNARY(~a);
+        case OP_LNOT:   UNARY(!a);
+        case OP_BOOL:   UNARY(a != 0);
+        case OP_MUL:    BINARY((int64_t)((uint64_t)a * (uint64_t)b));
+        case OP_DIV:    BINARY(b == 0 ? 0 : b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b);
+        case OP_MOD:    BINARY((b == 0 || b == -1) ? 0 : a % b);
+        case OP_ADD:    BINARY((int64_t)((uint64_t)a + (uint64_t)b));
+        case OP_SUB:    BINARY((int64_t)((uint64_t)a - (uint64_t)b));
+        case OP_SHL:    BINARY((int64_t)((uint64_t)a << (b & 63)));
+        case OP_SHR:    BINARY(a >> (b & 63));
+        case OP_LT:     BINARY(a < b);
+        case OP_LE:     BINARY(a <= b);
+        case OP_GT:     BINARY(a > b);
+        case OP_GE:     BINARY(a >= b);
+        case OP_EQ:     BINARY(a == b);
+        case OP_NE:     BINARY(a != b);
+        case OP_AND:    BINARY(a & b);
+        case OP_XOR:    BINARY(a ^ b);
+        case OP_OR:     BINARY(a | b);
+        case OP_ANDTHEN:
+        case OP_ORELSE:
+            op = ip[-1];
+            memcpy(&skip, ip, sizeof(skip));
+            ip += sizeof(skip);
+            /* the result is known from the left operand alone */
+            if ((op == OP_ANDTHEN) ? (*top == 0) : (*top != 0))
+            {
+                *top = (*top != 0);
+                ip += skip;
+            }
+            else
+            {
+                --top;
+            }
+            break;
+        default:
+            return 0;
+        }
+    }
+
+#undef UNARY
+#undef BINARY
+}
@@ -0,0 +1,50 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - dbg_condition.h                                          *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __DBG_CONDITION_H__
+#define __DBG_CONDITION_H__
+
+#include <stdint.h>
+
+/* Expression over the guest registers and memory, compiled to a small
+ * stack bytecode so breakpoints can evaluate it on every hit.
+ *
+ * Operands: decimal or 0x literals (8-digit hex ones are sign extended
+ * like the 32-bit addresses the CPU computes), GPR names (a0, sp, r31...),
+ * pc, hi, lo, addr (the physical address accessed by a memory breakpoint,
+ * pc for execution breakpoints) and memory reads [x] / w[x] (signed word),
+ * b[x], h[x] (unsigned), d[x].
+ * Memory reads only see RDRAM and cart ROM and never fault; anything
+ * else reads as 0. Addresses below 0x20000000 that the TLB doesn't map
+ * are read as physical addresses, so [addr] reads the accessed memory
+ * unless the TLB maps that page.
+ * Operators are C's, with C precedence; && and || short-circuit.
+ */
+struct dbg_condition;
+
+/* NULL after reporting the error */
+struct dbg_condition* dbg_condition_compile(const char* text);
+
+void dbg_condition_free(struct dbg_condition* condition);
+
+int64_t dbg_condition_eval(const struct dbg_condition* condition, uint32_t pc, uint32_t address);
+
+#endif /* __DBG_CONDITION_H__ */
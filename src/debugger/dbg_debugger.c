@@ -27,6 +27,9 @@
 #include "dbg_breakpoints.h"
 #include "dbg_debugger.h"
 #include "dbg_memory.h"
+#include "device/device.h"
+#include "device/r4300/lockstep.h"
+#include "main/main.h"
 
 #ifdef DBG
 
@@ -58,6 +61,7 @@ void init_debugger()
     DebuggerCallback(DEBUG_UI_INIT, 0); /* call front-end to initialize user interface */
 
     init_host_disassembler();
+    init_breakpoints();
 
     sem_pending_steps = SDL_CreateSemaphore(0);
 }
@@ -66,6 +70,7 @@ void destroy_debugger()
 {
     SDL_DestroySemaphore(sem_pending_steps);
     sem_pending_steps = NULL;
+    destroy_breakpoints();
     g_DebuggerActive = 0;
 }
 
@@ -78,8 +83,10 @@ void update_debugger(uint32_t pc)
 {
     int bpt;
 
+    apply_breakpoint_changes();
+
     if (g_dbg_runstate != M64P_DBG_RUNSTATE_PAUSED) {
-        bpt = check_breakpoints(pc);
+        bpt = lookup_breakpoint_hit(pc, pc, 1, M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_EXEC);
         if (bpt != -1) {
             g_dbg_runstate = M64P_DBG_RUNSTATE_PAUSED;
 
@@ -96,6 +103,9 @@ void update_debugger(uint32_t pc)
     if (g_dbg_runstate == M64P_DBG_RUNSTATE_PAUSED) {
         // The emulation thread is blocked until a step call via the API.
         SDL_SemWait(sem_pending_steps);
+        /* the guest state and breakpoints may have been edited while paused */
+        lockstep_reset(&g_dev.r4300);
+        apply_breakpoint_changes();
     }
 
     previousPC = pc;
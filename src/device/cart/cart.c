@@ -149,6 +149,12 @@ void poweron_cart(struct cart* cart)
     poweron_flashram(&cart->flashram);
 }
 
+void flush_cart(struct cart* cart)
+{
+    flush_sram(&cart->sram);
+    flush_flashram(&cart->flashram);
+}
+
 void read_cart_dom2(void* opaque, uint32_t address, uint32_t* value)
 {
     struct cart* cart = (struct cart*)opaque;
@@ -69,6 +69,9 @@ void init_cart(struct cart* cart,
 
 void poweron_cart(struct cart* cart);
 
+/* Notify storage backends of save data modified since last flush */
+void flush_cart(struct cart* cart);
+
 void read_cart_dom2(void* opaque, uint32_t address, uint32_t* value);
 void write_cart_dom2(void* opaque, uint32_t address, uint32_t value, uint32_t mask);
 
@@ -78,6 +78,8 @@ void write_cart_rom(void* opaque, uint32_t address, uint32_t value, uint32_t mas
 
     /* Mark IO as busy */
     cart_rom->pi->regs[PI_STATUS_REG] |= PI_STATUS_IO_BUSY;
+    /* reads now return last_write, drop code which assumed ROM contents */
+    invalidate_r4300_cached_code(cart_rom->r4300, R4300_KSEG1 + address, 4);
     cp0_update_count(cart_rom->r4300);
     add_interrupt_event(&cart_rom->r4300->cp0, PI_INT, 0x1000);
 }
@@ -120,8 +122,7 @@ unsigned int cart_rom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
     }
 
     /* invalidate cached code */
-    invalidate_r4300_cached_code(cart_rom->r4300, 0x80000000 + dram_addr, length);
-    invalidate_r4300_cached_code(cart_rom->r4300, 0xa0000000 + dram_addr, length);
+    invalidate_r4300_cached_code_dma(cart_rom->r4300, dram_addr, length);
 
     return (length / 8) + add_random_interrupt_time(cart_rom->r4300);
 }
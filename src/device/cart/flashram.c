@@ -33,9 +33,24 @@
 #include <inttypes.h>
 
 
+static void mark_flashram_dirty(struct flashram* flashram, uint32_t offset, uint32_t length)
+{
+    if (flashram->dirty_begin >= flashram->dirty_end) {
+        flashram->dirty_begin = offset;
+        flashram->dirty_end = offset + length;
+    }
+    else {
+        if (offset < flashram->dirty_begin) {
+            flashram->dirty_begin = offset;
+        }
+        if (offset + length > flashram->dirty_end) {
+            flashram->dirty_end = offset + length;
+        }
+    }
+}
+
 static void flashram_command(struct flashram* flashram, uint32_t command)
 {
-    unsigned int i;
     unsigned int offset;
     uint8_t* mem = flashram->istorage->data(flashram->storage);
 
@@ -60,11 +75,11 @@ static void flashram_command(struct flashram* flashram, uint32_t command)
         if (flashram->mode == FLASHRAM_MODE_SECTOR_ERASE) {
             offset = (flashram->erase_page & 0xff80) * 128;
             memset(mem + offset, 0xff, 128*128);
-            flashram->istorage->save(flashram->storage, offset, 128*128);
+            mark_flashram_dirty(flashram, offset, 128*128);
         }
         else if (flashram->mode == FLASHRAM_MODE_CHIP_ERASE){
             memset(mem, 0xff, FLASHRAM_SIZE);
-            flashram->istorage->save(flashram->storage, 0, FLASHRAM_SIZE);
+            mark_flashram_dirty(flashram, 0, FLASHRAM_SIZE);
         }
         else {
             DebugMessage(M64MSG_WARNING, "Unexpected erase command (mode=%x)", flashram->mode);
@@ -82,10 +97,8 @@ static void flashram_command(struct flashram* flashram, uint32_t command)
 
         /* program selected page */
         offset = (command & 0xffff) * 128;
-        for (i = 0; i < 128; ++i) {
-            mem[(offset+i)^S8] = flashram->page_buf[i];
-        }
-        flashram->istorage->save(flashram->storage, offset, 128);
+        memcpy_to_s8(mem, offset, flashram->page_buf, 128);
+        mark_flashram_dirty(flashram, offset, 128);
 
         /* clear program busy flag, set program success flag, transition to status mode */
         flashram->status &= ~UINT32_C(0x01);
@@ -128,6 +141,8 @@ void init_flashram(struct flashram* flashram,
     flashram->silicon_id[1] = flashram_id;
     flashram->storage = storage;
     flashram->istorage = istorage;
+    flashram->dirty_begin = 0;
+    flashram->dirty_end = 0;
 }
 
 void poweron_flashram(struct flashram* flashram)
@@ -143,6 +158,18 @@ void format_flashram(uint8_t* flash)
     memset(flash, 0xff, FLASHRAM_SIZE);
 }
 
+void flush_flashram(struct flashram* flashram)
+{
+    if (flashram->dirty_begin >= flashram->dirty_end) {
+        return;
+    }
+
+    flashram->istorage->save(flashram->storage, flashram->dirty_begin, flashram->dirty_end - flashram->dirty_begin);
+
+    flashram->dirty_begin = 0;
+    flashram->dirty_end = 0;
+}
+
 void read_flashram(void* opaque, uint32_t address, uint32_t* value)
 {
     struct flashram* flashram = (struct flashram*)opaque;
@@ -183,7 +210,6 @@ void write_flashram(void* opaque, uint32_t address, uint32_t value, uint32_t mas
 
 unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
     struct flashram* flashram = (struct flashram*)opaque;
     const uint8_t* mem = flashram->istorage->data(flashram->storage);
 
@@ -207,9 +233,7 @@ unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
         }
 
         /* do actual DMA */
-        for(i = 0; i < length; ++i) {
-            dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-        }
+        memcpy_s8(dram, dram_addr, mem, cart_addr, length);
     }
     else {
         /* other accesses are not implemented */
@@ -223,13 +247,10 @@ unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
 unsigned int flashram_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
     struct flashram* flashram = (struct flashram*)opaque;
-    unsigned int i;
 
     if ((cart_addr & 0x1ffff) == 0x00000 && length == 128 && flashram->mode == FLASHRAM_MODE_PAGE_PROGRAM) {
         /* load page buf using DMA */
-        for(i = 0; i < length; ++i) {
-            flashram->page_buf[i] = dram[(dram_addr+i)^S8];
-        }
+        memcpy_from_s8(flashram->page_buf, dram, dram_addr, length);
     }
     else {
         /* other accesses are not implemented */
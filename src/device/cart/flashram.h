@@ -61,6 +61,10 @@ struct flashram
 
     void* storage;
     const struct storage_backend_interface* istorage;
+
+    /* range of modified bytes not yet notified to storage [dirty_begin, dirty_end) */
+    uint32_t dirty_begin;
+    uint32_t dirty_end;
 };
 
 void init_flashram(struct flashram* flashram,
@@ -72,6 +76,8 @@ void poweron_flashram(struct flashram* flashram);
 
 void format_flashram(uint8_t* flash);
 
+void flush_flashram(struct flashram* flashram);
+
 void read_flashram(void* opaque, uint32_t address, uint32_t* value);
 void write_flashram(void* opaque, uint32_t address, uint32_t value, uint32_t mask);
 
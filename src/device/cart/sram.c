@@ -35,41 +35,65 @@ void format_sram(uint8_t* mem)
     memset(mem, 0xff, SRAM_SIZE);
 }
 
+static void mark_sram_dirty(struct sram* sram, uint32_t address, uint32_t length)
+{
+    if (sram->dirty_begin >= sram->dirty_end) {
+        sram->dirty_begin = address;
+        sram->dirty_end = address + length;
+    }
+    else {
+        if (address < sram->dirty_begin) {
+            sram->dirty_begin = address;
+        }
+        if (address + length > sram->dirty_end) {
+            sram->dirty_end = address + length;
+        }
+    }
+}
+
 void init_sram(struct sram* sram,
                void* storage, const struct storage_backend_interface* istorage)
 {
     sram->storage = storage;
     sram->istorage = istorage;
+    sram->dirty_begin = 0;
+    sram->dirty_end = 0;
+}
+
+void flush_sram(struct sram* sram)
+{
+    if (sram->dirty_begin >= sram->dirty_end) {
+        return;
+    }
+
+    sram->istorage->save(sram->storage, sram->dirty_begin, sram->dirty_end - sram->dirty_begin);
+
+    sram->dirty_begin = 0;
+    sram->dirty_end = 0;
 }
 
 unsigned int sram_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
     struct sram* sram = (struct sram*)opaque;
     uint8_t* mem = sram->istorage->data(sram->storage);
 
     cart_addr &= SRAM_ADDR_MASK;
 
-    for (i = 0; i < length; ++i) {
-        mem[(cart_addr+i)^S8] = dram[(dram_addr+i)^S8];
-    }
+    memcpy_s8(mem, cart_addr, dram, dram_addr, length);
 
-    sram->istorage->save(sram->storage, cart_addr, length);
+    mark_sram_dirty(sram, cart_addr, length);
 
     return /* length / 8 */0x1000;
 }
 
 unsigned int sram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
     struct sram* sram = (struct sram*)opaque;
     const uint8_t* mem = sram->istorage->data(sram->storage);
 
     cart_addr &= SRAM_ADDR_MASK;
 
-    for (i = 0; i < length; ++i) {
-        dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-    }
+    memcpy_s8(dram, dram_addr, mem, cart_addr, length);
 
     return /* length / 8 */0x1000;
 }
@@ -93,5 +117,5 @@ void write_sram(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
 
     masked_write((uint32_t*)(mem + address), value, mask);
 
-    sram->istorage->save(sram->storage, address, sizeof(value));
+    mark_sram_dirty(sram, address, sizeof(value));
 }
@@ -32,6 +32,10 @@ struct sram
 {
     void* storage;
     const struct storage_backend_interface* istorage;
+
+    /* range of modified bytes not yet notified to storage [dirty_begin, dirty_end) */
+    uint32_t dirty_begin;
+    uint32_t dirty_end;
 };
 
 void format_sram(uint8_t* sram);
@@ -39,6 +43,8 @@ void format_sram(uint8_t* sram);
 void init_sram(struct sram* sram,
                void* storage, const struct storage_backend_interface* istorage);
 
+void flush_sram(struct sram* sram);
+
 unsigned int sram_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
 unsigned int sram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length);
 void read_sram(void* opaque, uint32_t address, uint32_t* value);
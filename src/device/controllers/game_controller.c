@@ -20,6 +20,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "game_controller.h"
+#include "joybus_crc.h"
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
@@ -89,25 +90,6 @@ void change_pak(struct game_controller* cont,
     cont->ipak = ipak;
 }
 
-static uint8_t pak_data_crc(const uint8_t* data, size_t size)
-{
-    size_t i;
-    uint8_t crc = 0;
-
-    for(i = 0; i <= size; ++i)
-    {
-        int mask;
-        for (mask = 0x80; mask >= 1; mask >>= 1)
-        {
-            uint8_t xor_tap = (crc & 0x80) ? 0x85 : 0x00;
-            crc <<= 1;
-            if (i != size && (data[i] & mask)) crc |= 1;
-            crc ^= xor_tap;
-        }
-    }
-    return crc;
-}
-
 static void pak_read_block(struct game_controller* cont,
     const uint8_t* addr_acrc, uint8_t* data, uint8_t* dcrc)
 {
@@ -118,10 +100,10 @@ static void pak_read_block(struct game_controller* cont,
 
     if (cont->ipak != NULL) {
         cont->ipak->read(cont->pak, address, data, PAK_CHUNK_SIZE);
-        *dcrc = pak_data_crc(data, PAK_CHUNK_SIZE);
+        *dcrc = joybus_data_crc(data, PAK_CHUNK_SIZE);
     } else {
         //NOT the CRC value when pak is not present
-        *dcrc = ~pak_data_crc(data, PAK_CHUNK_SIZE);
+        *dcrc = ~joybus_data_crc(data, PAK_CHUNK_SIZE);
     }
 }
 
@@ -135,9 +117,9 @@ static void pak_write_block(struct game_controller* cont,
 
     if (cont->ipak != NULL) {
         cont->ipak->write(cont->pak, address, data, PAK_CHUNK_SIZE);
-        *dcrc = pak_data_crc(data, PAK_CHUNK_SIZE);
+        *dcrc = joybus_data_crc(data, PAK_CHUNK_SIZE);
     } else {
-        *dcrc = ~pak_data_crc(data, PAK_CHUNK_SIZE);
+        *dcrc = ~joybus_data_crc(data, PAK_CHUNK_SIZE);
     }
 }
 
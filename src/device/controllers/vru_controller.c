@@ -20,6 +20,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "game_controller.h"
+#include "joybus_crc.h"
 #include "vru_controller.h"
 
 #include "api/callbacks.h"
@@ -45,25 +46,6 @@ enum voice_status
     VOICE_STATUS_END    = 0x07
 };
 
-static uint8_t vru_data_crc(const uint8_t* data, size_t size)
-{
-    size_t i;
-    uint8_t crc = 0;
-
-    for(i = 0; i <= size; ++i)
-    {
-        int mask;
-        for (mask = 0x80; mask >= 1; mask >>= 1)
-        {
-            uint8_t xor_tap = (crc & 0x80) ? 0x85 : 0x00;
-            crc <<= 1;
-            if (i != size && (data[i] & mask)) crc |= 1;
-            crc ^= xor_tap;
-        }
-    }
-    return crc;
-}
-
 /* VRU controller */
 static void vru_controller_reset(struct game_controller* cont)
 {
@@ -148,7 +130,7 @@ static void process_vru_command(void* jbd,
         JOYBUS_CHECK_COMMAND_FORMAT(3, 3)
         rx_buf[0] = cont->voice_init ? cont->voice_state : 0;
         rx_buf[1] = 0;
-        rx_buf[2] = vru_data_crc(&rx_buf[0], 2);
+        rx_buf[2] = joybus_data_crc(&rx_buf[0], 2);
         if (cont->load_offset > 0)
         {
             uint8_t offset = 0;
@@ -194,7 +176,7 @@ static void process_vru_command(void* jbd,
 
     case JCMD_VRU_WRITE_CONFIG: {
         JOYBUS_CHECK_COMMAND_FORMAT(7, 1)
-        rx_buf[0] = vru_data_crc(&tx_buf[3], 4);
+        rx_buf[0] = joybus_data_crc(&tx_buf[3], 4);
         if (rx_buf[0] == 0x4E)
         {
             input.setMicState(1);
@@ -226,13 +208,13 @@ static void process_vru_command(void* jbd,
         *((uint16_t*)(&rx_buf[34])) = 0x0040; /* as per zoinkity https://pastebin.com/6UiErk5h */
         input.readVRUResults((uint16_t*)&rx_buf[4] /*error flags*/, (uint16_t*)&rx_buf[6] /*number of results*/, (uint16_t*)&rx_buf[8] /*mic level*/, \
             (uint16_t*)&rx_buf[10] /*voice level*/, (uint16_t*)&rx_buf[12] /*voice length*/, (uint16_t*)&rx_buf[14] /*matches*/);
-        rx_buf[36] = vru_data_crc(&rx_buf[0], 36);
+        rx_buf[36] = joybus_data_crc(&rx_buf[0], 36);
         cont->voice_state = VOICE_STATUS_START;
     } break;
 
     case JCMD_VRU_WRITE: {
         JOYBUS_CHECK_COMMAND_FORMAT(23, 1)
-        rx_buf[0] = vru_data_crc(&tx_buf[3], 20);
+        rx_buf[0] = joybus_data_crc(&tx_buf[3], 20);
         if (cont->load_offset == 0)
             memset(cont->word, 0, 80);
         memcpy(&cont->word[cont->load_offset], &tx_buf[3], 20);
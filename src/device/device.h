@@ -125,7 +125,10 @@ void init_device(struct device* dev,
     unsigned int count_per_op_denom_pot,
     int no_compiled_jump,
     int randomize_interrupt,
+    int libultra_hle,
     uint32_t start_address,
+    /* rsp */
+    int async_gfx,
     /* ai */
     void* aout, const struct audio_out_backend_interface* iaout, float dma_modifier,
     /* si */
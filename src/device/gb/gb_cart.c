@@ -54,55 +54,58 @@ enum gbcart_extra_devices
 /* various helper functions for ram, rom, or MBC uses */
 
 
-static void read_rom(const void* rom_storage, const struct storage_backend_interface* irom_storage, uint16_t address, uint8_t* data, size_t size)
+static int read_rom(const struct gb_cart* gb_cart, size_t address, uint8_t* data, size_t size)
 {
     assert(size > 0);
 
-    if (address + size > irom_storage->size(rom_storage))
+    if (address + size > gb_cart->rom_size)
     {
-        DebugMessage(M64MSG_WARNING, "Out of bound read from GB ROM %04x", address);
-        return;
+        DebugMessage(M64MSG_WARNING, "Out of bound read from GB ROM %04x", (uint32_t)address);
+        return -1;
     }
 
-    memcpy(data, irom_storage->data(rom_storage) + address, size);
+    memcpy(data, gb_cart->rom_data + address, size);
+    return 0;
 }
 
 
-static void read_ram(const void* ram_storage, const struct storage_backend_interface* iram_storage, unsigned int enabled, uint16_t address, uint8_t* data, size_t size, uint8_t mask)
+static int read_ram(const struct gb_cart* gb_cart, unsigned int enabled, size_t address, uint8_t* data, size_t size, uint8_t mask)
 {
     size_t i;
     assert(size > 0);
 
     /* RAM has to be enabled before use */
     if (!enabled) {
-        DebugMessage(M64MSG_WARNING, "Trying to read from non enabled GB RAM %04x", address);
+        DebugMessage(M64MSG_WARNING, "Trying to read from non enabled GB RAM %04x", (uint32_t)address);
         memset(data, 0xff, size);
-        return;
+        return 0;
     }
 
     /* RAM must be present */
-    if (iram_storage->data(ram_storage) == NULL) {
-        DebugMessage(M64MSG_WARNING, "Trying to read from absent GB RAM %04x", address);
+    if (gb_cart->ram_data == NULL) {
+        DebugMessage(M64MSG_WARNING, "Trying to read from absent GB RAM %04x", (uint32_t)address);
         memset(data, 0xff, size);
-        return;
+        return 0;
     }
 
-    if (address + size > iram_storage->size(ram_storage))
+    if (address + size > gb_cart->ram_size)
     {
-        DebugMessage(M64MSG_WARNING, "Out of bound read from GB RAM %04x", address);
-        return;
+        DebugMessage(M64MSG_WARNING, "Out of bound read from GB RAM %04x", (uint32_t)address);
+        return -1;
     }
 
-    memcpy(data, iram_storage->data(ram_storage) + address, size);
+    memcpy(data, gb_cart->ram_data + address, size);
 
     if (mask != UINT8_C(0xff)) {
         for (i = 0; i < size; ++i) {
             data[i] &= mask;
         }
     }
+
+    return 0;
 }
 
-static void write_ram(void* ram_storage, const struct storage_backend_interface* iram_storage, unsigned int enabled, uint16_t address, const uint8_t* data, size_t size, uint8_t mask)
+static int write_ram(struct gb_cart* gb_cart, unsigned int enabled, size_t address, const uint8_t* data, size_t size, uint8_t mask)
 {
     size_t i;
     uint8_t* dst;
@@ -111,23 +114,23 @@ static void write_ram(void* ram_storage, const struct storage_backend_interface*
 
     /* RAM has to be enabled before use */
     if (!enabled) {
-        DebugMessage(M64MSG_WARNING, "Trying to write to non enabled GB RAM %04x", address);
-        return;
+        DebugMessage(M64MSG_WARNING, "Trying to write to non enabled GB RAM %04x", (uint32_t)address);
+        return 0;
     }
 
     /* RAM must be present */
-    if (iram_storage->data(ram_storage) == NULL) {
-        DebugMessage(M64MSG_WARNING, "Trying to write to absent GB RAM %04x", address);
-        return;
+    if (gb_cart->ram_data == NULL) {
+        DebugMessage(M64MSG_WARNING, "Trying to write to absent GB RAM %04x", (uint32_t)address);
+        return 0;
     }
 
-    if (address + size > iram_storage->size(ram_storage))
+    if (address + size > gb_cart->ram_size)
     {
-        DebugMessage(M64MSG_WARNING, "Out of bound write to GB RAM %04x", address);
-        return;
+        DebugMessage(M64MSG_WARNING, "Out of bound write to GB RAM %04x", (uint32_t)address);
+        return -1;
     }
 
-    dst = iram_storage->data(ram_storage) + address;
+    dst = gb_cart->ram_data + address;
     memcpy(dst, data, size);
 
     if (mask != UINT8_C(0xff)) {
@@ -135,7 +138,8 @@ static void write_ram(void* ram_storage, const struct storage_backend_interface*
             dst[i] &= mask;
         }
     }
-    iram_storage->save(ram_storage, address, size);
+    gb_cart->iram_storage->save(gb_cart->ram_storage, address, size);
+    return 0;
 }
 
 
@@ -150,6 +154,7 @@ static void set_ram_enable(struct gb_cart* gb_cart, uint8_t value)
 
 static int read_gb_cart_nombc(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
 {
+    int err = 0;
     switch(address >> 13)
     {
     /* 0x0000-0x7fff: ROM */
@@ -157,23 +162,24 @@ static int read_gb_cart_nombc(struct gb_cart* gb_cart, uint16_t address, uint8_t
     case (0x2000 >> 13):
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        err = read_rom(gb_cart, address, data, size);
         break;
 
     /* 0xa000-0xbfff: RAM */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, 1, address - 0xa000, data, size, UINT8_C(0xff));
+        err = read_ram(gb_cart, 1, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart read (nombc): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int write_gb_cart_nombc(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
 {
+    int err = 0;
     switch(address >> 13)
     {
     /* 0x0000-0x7fff: ROM */
@@ -186,47 +192,49 @@ static int write_gb_cart_nombc(struct gb_cart* gb_cart, uint16_t address, const
 
     /* 0xa000-0xbfff: RAM */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, 1, address - 0xa000, data, size, UINT8_C(0xff));
+        err = write_ram(gb_cart, 1, address - 0xa000, data, size, UINT8_C(0xff));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart write (nombc): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 
 static int read_gb_cart_mbc1(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
 {
+    int err = 0;
     switch(address >> 13)
     {
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        err = read_rom(gb_cart, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 01-7f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        err = read_rom(gb_cart, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-03 */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+        err = read_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart read (MBC1): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int write_gb_cart_mbc1(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
 {
+    int err = 0;
     uint8_t bank;
     uint8_t value = data[size-1];
 
@@ -272,46 +280,48 @@ static int write_gb_cart_mbc1(struct gb_cart* gb_cart, uint16_t address, const u
 
     /* 0xa000-0xbfff: RAM bank 00-03 */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+        err = write_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart write (MBC1): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int read_gb_cart_mbc2(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
 {
+    int err = 0;
     switch (address >> 13)
     {
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        err = read_rom(gb_cart, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 01-0f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        err = read_rom(gb_cart, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
         break;
 
     /* 0xa000-0xa1ff: internal 512x4bit RAM */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000), data, size, UINT8_C(0x0f));
+        err = read_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000), data, size, UINT8_C(0x0f));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart read (MBC2): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int write_gb_cart_mbc2(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
 {
+    int err = 0;
     uint8_t bank;
     uint8_t value = data[size-1];
 
@@ -335,31 +345,32 @@ static int write_gb_cart_mbc2(struct gb_cart* gb_cart, uint16_t address, const u
 
     /* 0xa000-0xa1ff: internal 512x4bit RAM */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000), data, size, UINT8_C(0x0f));
+        err = write_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000), data, size, UINT8_C(0x0f));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart write (MBC2): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 
 static int read_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
 {
+    int err = 0;
     switch(address >> 13)
     {
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        err = read_rom(gb_cart, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 01-7f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        err = read_rom(gb_cart, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-07 or RTC register 08-0c */
@@ -375,7 +386,7 @@ static int read_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, uint8_t*
         case 0x05:
         case 0x06:
         case 0x07:
-            read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            err = read_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
             break;
 
         /* RTC registers */
@@ -409,11 +420,12 @@ static int read_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, uint8_t*
         DebugMessage(M64MSG_WARNING, "Invalid cart read (MBC3): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int write_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
 {
+    int err = 0;
     uint8_t bank;
     uint8_t value = data[size-1];
 
@@ -460,7 +472,7 @@ static int write_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, const u
         case 0x05:
         case 0x06:
         case 0x07:
-            write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            err = write_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
             break;
 
         /* RTC registers */
@@ -492,39 +504,41 @@ static int write_gb_cart_mbc3(struct gb_cart* gb_cart, uint16_t address, const u
         DebugMessage(M64MSG_WARNING, "Invalid cart write (MBC3): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int read_gb_cart_mbc5(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
 {
+    int err = 0;
     switch(address >> 13)
     {
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        err = read_rom(gb_cart, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 00-ff (???) */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        err = read_rom(gb_cart, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-07 */
     case (0xa000 >> 13):
-        read_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + ((gb_cart->ram_bank & 0x7) * 0x2000), data, size, UINT8_C(0xff));
+        err = read_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000) + ((gb_cart->ram_bank & 0x7) * 0x2000), data, size, UINT8_C(0xff));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart read (MBC5): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int write_gb_cart_mbc5(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
 {
+    int err = 0;
     uint8_t value = data[size-1];
 
     switch(address >> 13)
@@ -560,14 +574,14 @@ static int write_gb_cart_mbc5(struct gb_cart* gb_cart, uint16_t address, const u
 
     /* 0xa000-0xbfff: RAM bank 00-0f */
     case (0xa000 >> 13):
-        write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + ((gb_cart->ram_bank & 0x07)* 0x2000), data, size, UINT8_C(0xff));
+        err = write_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000) + ((gb_cart->ram_bank & 0x07)* 0x2000), data, size, UINT8_C(0xff));
         break;
 
     default:
         DebugMessage(M64MSG_WARNING, "Invalid cart write (MBC5): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int read_gb_cart_mbc6(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
@@ -755,18 +769,19 @@ static void write_pocket_cam_regs(struct pocket_cam* cam, unsigned int reg, uint
 
 static int read_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
 {
+    int err = 0;
     switch(address >> 13)
     {
     /* 0x0000-0x3fff: ROM bank 00 */
     case (0x0000 >> 13):
     case (0x2000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, address, data, size);
+        err = read_rom(gb_cart, address, data, size);
         break;
 
     /* 0x4000-0x7fff: ROM bank 00-3f */
     case (0x4000 >> 13):
     case (0x6000 >> 13):
-        read_rom(gb_cart->rom_storage, gb_cart->irom_storage, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
+        err = read_rom(gb_cart, (address - 0x4000) + (gb_cart->rom_bank * 0x4000), data, size);
         break;
 
     /* 0xa000-0xbfff: RAM bank 00-0f, Camera registers & 0x10 */
@@ -778,7 +793,7 @@ static int read_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, ui
             }
         }
         else {
-            read_ram(gb_cart->ram_storage, gb_cart->iram_storage, 1, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            err = read_ram(gb_cart, 1, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
         }
         break;
 
@@ -786,11 +801,12 @@ static int read_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, ui
         DebugMessage(M64MSG_WARNING, "Invalid cart read (cam): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int write_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
 {
+    int err = 0;
     uint8_t value = data[size-1];
 
     switch(address >> 13)
@@ -827,7 +843,7 @@ static int write_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, c
             }
         }
         else {
-            write_ram(gb_cart->ram_storage, gb_cart->iram_storage, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
+            err = write_ram(gb_cart, gb_cart->ram_enable, (address - 0xa000) + (gb_cart->ram_bank * 0x2000), data, size, UINT8_C(0xff));
         }
         break;
 
@@ -835,7 +851,7 @@ static int write_gb_cart_pocket_cam(struct gb_cart* gb_cart, uint16_t address, c
         DebugMessage(M64MSG_WARNING, "Invalid cart write (cam): %04x", address);
     }
 
-    return 0;
+    return err;
 }
 
 static int read_gb_cart_bandai_tama5(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
@@ -1069,6 +1085,10 @@ void init_gb_cart(struct gb_cart* gb_cart,
     gb_cart->irom_storage = irom_storage;
     gb_cart->ram_storage = ram_storage;
     gb_cart->iram_storage = iram_storage;
+    gb_cart->rom_data = rom_data;
+    gb_cart->rom_size = irom_storage->size(rom_storage);
+    gb_cart->ram_data = (iram_storage != NULL) ? iram_storage->data(ram_storage) : NULL;
+    gb_cart->ram_size = (iram_storage != NULL) ? iram_storage->size(ram_storage) : 0;
     gb_cart->extra_devices = type->extra_devices;
     gb_cart->rtc = rtc;
     gb_cart->cam = cam;
@@ -1107,13 +1127,94 @@ void poweron_gb_cart(struct gb_cart* gb_cart)
     }
 }
 
+/* A run the mapper can't take as a whole (e.g. crossing the end of ROM)
+ * is retried byte by byte, so the bytes it can map are still accessed */
+static int read_gb_cart_run(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
+{
+    size_t i;
+    int err = 0;
+
+    if (gb_cart->read_gb_cart(gb_cart, address, data, size) == 0) {
+        return 0;
+    }
+    if (size == 1) {
+        return -1;
+    }
+
+    for (i = 0; i < size; ++i) {
+        if (gb_cart->read_gb_cart(gb_cart, (uint16_t)(address + i), data + i, 1) != 0) {
+            err = -1;
+        }
+    }
+
+    return err;
+}
+
+static int write_gb_cart_run(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
+{
+    size_t i;
+    int err = 0;
+
+    if (gb_cart->write_gb_cart(gb_cart, address, data, size) == 0) {
+        return 0;
+    }
+    if (size == 1) {
+        return -1;
+    }
+
+    for (i = 0; i < size; ++i) {
+        if (gb_cart->write_gb_cart(gb_cart, (uint16_t)(address + i), data + i, 1) != 0) {
+            err = -1;
+        }
+    }
+
+    return err;
+}
+
 int read_gb_cart(struct gb_cart* gb_cart, uint16_t address, uint8_t* data, size_t size)
 {
-    return gb_cart->read_gb_cart(gb_cart, address, data, size);
+    int err = 0;
+
+    /* split access into runs which stay inside a 8KiB region. Joybus
+     * blocks are 32 bytes and never cross one, so they take a single run */
+    while (size > 0) {
+        size_t run = 0x2000 - (address & 0x1fff);
+        if (run > size) {
+            run = size;
+        }
+
+        if (read_gb_cart_run(gb_cart, address, data, run) != 0) {
+            err = -1;
+        }
+
+        address += (uint16_t)run;
+        data += run;
+        size -= run;
+    }
+
+    return err;
 }
 
 int write_gb_cart(struct gb_cart* gb_cart, uint16_t address, const uint8_t* data, size_t size)
 {
-    return gb_cart->write_gb_cart(gb_cart, address, data, size);
-}
+    int err = 0;
+
+    /* split access into runs which stay inside a 8KiB region. Joybus
+     * blocks are 32 bytes and never cross one, so they take a single run */
+    while (size > 0) {
+        size_t run = 0x2000 - (address & 0x1fff);
+        if (run > size) {
+            run = size;
+        }
+
+        if (write_gb_cart_run(gb_cart, address, data, run) != 0) {
+            err = -1;
+        }
 
+        address += (uint16_t)run;
+        data += run;
+        size -= run;
+    }
+
+    return err;
+}
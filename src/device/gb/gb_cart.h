@@ -56,6 +56,12 @@ struct gb_cart
     void* ram_storage;
     const struct storage_backend_interface* iram_storage;
 
+    /* storage data resolved once at init, to avoid backend indirections on each access */
+    const uint8_t* rom_data;
+    size_t rom_size;
+    uint8_t* ram_data;
+    size_t ram_size;
+
     unsigned int rom_bank;
     unsigned int ram_bank;
 
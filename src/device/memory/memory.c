@@ -29,8 +29,6 @@
 #include "device/pif/pif.h"
 
 #ifdef DBG
-#include <string.h>
-
 #include "device/r4300/r4300_core.h"
 
 #include "debugger/dbg_breakpoints.h"
@@ -41,6 +39,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
 #include <malloc.h>
@@ -217,6 +216,132 @@ void apply_mem_mapping(struct memory* mem, const struct mem_mapping* mapping)
     }
 }
 
+void memcpy_s8(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+    /* when both addresses share the same word alignment,
+     * swizzling is identical on both sides and words can be copied as is */
+    if (((dst_addr ^ src_addr) & 3) == 0) {
+        size_t body;
+
+        for (; length > 0 && (dst_addr & 3) != 0; --length) {
+            dst[(dst_addr++)^S8] = src[(src_addr++)^S8];
+        }
+
+        body = length & ~(size_t)3;
+        memcpy(dst + dst_addr, src + src_addr, body);
+        dst_addr += (uint32_t)body;
+        src_addr += (uint32_t)body;
+        length -= body;
+    }
+
+    for (; length > 0; --length) {
+        dst[(dst_addr++)^S8] = src[(src_addr++)^S8];
+    }
+}
+
+void memcpy_to_s8(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, size_t length)
+{
+    for (; length > 0 && (dst_addr & 3) != 0; --length) {
+        dst[(dst_addr++)^S8] = *(src++);
+    }
+
+    for (; length >= 4; length -= 4) {
+        uint32_t w;
+        memcpy(&w, src, 4);
+        w = tohl(w);
+        memcpy(dst + dst_addr, &w, 4);
+        dst_addr += 4;
+        src += 4;
+    }
+
+    for (; length > 0; --length) {
+        dst[(dst_addr++)^S8] = *(src++);
+    }
+}
+
+void memcpy_from_s8(uint8_t* dst, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+    for (; length > 0 && (src_addr & 3) != 0; --length) {
+        *(dst++) = src[(src_addr++)^S8];
+    }
+
+    for (; length >= 4; length -= 4) {
+        uint32_t w;
+        memcpy(&w, src + src_addr, 4);
+        w = fromhl(w);
+        memcpy(dst, &w, 4);
+        src_addr += 4;
+        dst += 4;
+    }
+
+    for (; length > 0; --length) {
+        *(dst++) = src[(src_addr++)^S8];
+    }
+}
+
+void memmove_s8(uint8_t* mem, uint32_t dst_addr, uint32_t src_addr, size_t length)
+{
+    size_t body;
+
+    /* copy forward unless dst overlaps the end of src */
+    if (dst_addr <= src_addr || dst_addr - src_addr >= length) {
+        if (((dst_addr ^ src_addr) & 3) == 0) {
+            for (; length > 0 && (dst_addr & 3) != 0; --length) {
+                mem[(dst_addr++)^S8] = mem[(src_addr++)^S8];
+            }
+
+            body = length & ~(size_t)3;
+            memmove(mem + dst_addr, mem + src_addr, body);
+            dst_addr += (uint32_t)body;
+            src_addr += (uint32_t)body;
+            length -= body;
+        }
+
+        for (; length > 0; --length) {
+            mem[(dst_addr++)^S8] = mem[(src_addr++)^S8];
+        }
+        return;
+    }
+
+    dst_addr += (uint32_t)length;
+    src_addr += (uint32_t)length;
+
+    if (((dst_addr ^ src_addr) & 3) == 0) {
+        for (; length > 0 && (dst_addr & 3) != 0; --length) {
+            mem[(--dst_addr)^S8] = mem[(--src_addr)^S8];
+        }
+
+        body = length & ~(size_t)3;
+        dst_addr -= (uint32_t)body;
+        src_addr -= (uint32_t)body;
+        memmove(mem + dst_addr, mem + src_addr, body);
+        length -= body;
+    }
+
+    for (; length > 0; --length) {
+        mem[(--dst_addr)^S8] = mem[(--src_addr)^S8];
+    }
+}
+
+void memset_s8(uint8_t* mem, uint32_t dst_addr, uint8_t value, size_t length)
+{
+    size_t body;
+
+    for (; length > 0 && (dst_addr & 3) != 0; --length) {
+        mem[(dst_addr++)^S8] = value;
+    }
+
+    /* a repeated byte reads the same in any byte order */
+    body = length & ~(size_t)3;
+    memset(mem + dst_addr, value, body);
+    dst_addr += (uint32_t)body;
+    length -= body;
+
+    for (; length > 0; --length) {
+        mem[(dst_addr++)^S8] = value;
+    }
+}
+
 int init_mem_base(MemoryBase* mem_base) {
 #ifdef _WIN32
     mem_base->rdram = _aligned_malloc(RDRAM_MEMORY_SIZE, MB_RDRAM_DRAM_ALIGNMENT_REQUIREMENT);
@@ -86,6 +86,16 @@ static osal_inline void mem_write32(const struct mem_handler* handler, uint32_t
 
 void apply_mem_mapping(struct memory* mem, const struct mem_mapping* mapping);
 
+/* Copy helpers for byte-swizzled (^S8) memories, such as RDRAM or cart storages.
+ * Aligned words are copied in bulk, only unaligned head and tail go byte by byte.
+ */
+void memcpy_s8(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length);
+void memcpy_to_s8(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, size_t length);
+void memcpy_from_s8(uint8_t* dst, const uint8_t* src, uint32_t src_addr, size_t length);
+/* Same as memmove/memset within one byte-swizzled memory */
+void memmove_s8(uint8_t* mem, uint32_t dst_addr, uint32_t src_addr, size_t length);
+void memset_s8(uint8_t* mem, uint32_t dst_addr, uint8_t value, size_t length);
+
 int init_mem_base(MemoryBase* mem_base);
 void release_mem_base(MemoryBase* mem_base);
 uint32_t* mem_base_u32(MemoryBase* mem_base, uint32_t address);
@@ -258,6 +258,34 @@ void cached_interp_NOTCOMPILED2(void)
     cached_interp_NOTCOMPILED();
 }
 
+void cached_interp_NATIVE_CALL(void)
+{
+    DECLARE_R4300
+    struct precomp_instr* inst = *r4300_pc_struct(r4300);
+    const uint32_t* iw;
+
+    if (!r4300->delay_slot && r4300_do_native_call(r4300, inst->addr)) {
+        return;
+    }
+
+    /* Entered as a delay slot, or the native version is gone:
+     * run the guest instruction instead */
+    iw = fast_mem_access(r4300, inst->addr);
+    if (iw == NULL) {
+        DebugMessage(M64MSG_ERROR, "native call fallback at %08x: no code", inst->addr);
+        return;
+    }
+    r4300_decode(inst, r4300, r4300_get_idec(iw[0]), iw[0], iw[1], r4300->cached_interp.actual);
+    if (r4300_has_native_call(r4300, inst->addr)) {
+        void (*ops)(void) = inst->ops;
+        inst->ops = cached_interp_NATIVE_CALL;
+        ops();
+    }
+    else {
+        inst->ops();
+    }
+}
+
 /* TODO: implement them properly */
 #define cached_interp_BC0F        cached_interp_NI
 #define cached_interp_BC0F_IDLE   cached_interp_NI
@@ -860,6 +888,9 @@ void cached_interp_recompile_block(struct r4300_core* r4300, const uint32_t* iw,
 
         /* decode instruction */
         opcode = r4300_decode(inst, r4300, r4300_get_idec(iw[i]), iw[i], iw[i+1], block);
+        if (r4300_has_native_call(r4300, inst->addr)) {
+            inst->ops = cached_interp_NATIVE_CALL;
+        }
 
         /* decode ending conditions */
         if (i >= length2) { finished = 2; }
@@ -984,19 +1015,55 @@ void invalidate_cached_code_hacktarux(struct r4300_core* r4300, uint32_t address
     }
 }
 
-void run_cached_interpreter(struct r4300_core* r4300)
+static osal_inline void run_hooks(struct r4300_core* r4300, unsigned int hooks)
 {
-    while (!*r4300_stop(r4300))
-    {
 #ifdef COMPARE_CORE
+    if (hooks & R4300_HOOK_COMPARE_CORE)
+    {
         if ((*r4300_pc_struct(r4300))->ops == cached_interp_FIN_BLOCK && ((*r4300_pc_struct(r4300))->addr < 0x80000000 || (*r4300_pc_struct(r4300))->addr >= 0xc0000000))
             virtual_to_physical_address(r4300, (*r4300_pc_struct(r4300))->addr, 2);
         CoreCompareCallback();
+    }
 #endif
 #ifdef DBG
-        if (g_DebuggerActive) update_debugger((*r4300_pc_struct(r4300))->addr);
+    if (hooks & R4300_HOOK_DEBUGGER) update_debugger((*r4300_pc_struct(r4300))->addr);
 #endif
-        (*r4300_pc_struct(r4300))->ops();
-        r4300_ml64_do_code_callbacks(r4300);
+}
+
+/* Native calls are compiled into the blocks, so the loops ignore that hook */
+#define CACHED_INTERP_HOOKS (R4300_HOOK_COMPARE_CORE | R4300_HOOK_DEBUGGER | R4300_HOOK_CODE_CALLBACKS)
+
+/* One loop per hook combination; returns when the active set changes */
+#define CACHED_INTERP_LOOP(HOOKS) \
+    static void cached_interp_loop_##HOOKS(struct r4300_core* r4300) \
+    { \
+        while (!*r4300_stop(r4300) && (r4300->hooks & CACHED_INTERP_HOOKS) == HOOKS) \
+        { \
+            run_hooks(r4300, HOOKS); \
+            (*r4300_pc_struct(r4300))->ops(); \
+            if (HOOKS & R4300_HOOK_CODE_CALLBACKS) r4300_ml64_do_code_callbacks(r4300); \
+        } \
+    }
+
+CACHED_INTERP_LOOP(0)
+CACHED_INTERP_LOOP(1)
+CACHED_INTERP_LOOP(2)
+CACHED_INTERP_LOOP(3)
+CACHED_INTERP_LOOP(4)
+CACHED_INTERP_LOOP(5)
+CACHED_INTERP_LOOP(6)
+CACHED_INTERP_LOOP(7)
+
+static void (*const cached_interp_loops[CACHED_INTERP_HOOKS + 1])(struct r4300_core* r4300) =
+{
+    cached_interp_loop_0, cached_interp_loop_1, cached_interp_loop_2, cached_interp_loop_3,
+    cached_interp_loop_4, cached_interp_loop_5, cached_interp_loop_6, cached_interp_loop_7
+};
+
+void run_cached_interpreter(struct r4300_core* r4300)
+{
+    while (!*r4300_stop(r4300))
+    {
+        cached_interp_loops[r4300->hooks & CACHED_INTERP_HOOKS](r4300);
     }
 }
@@ -56,6 +56,7 @@ void cached_interpreter_jump_to(struct r4300_core* r4300, uint32_t address);
 void cached_interp_FIN_BLOCK(void);
 void cached_interp_NOTCOMPILED(void);
 void cached_interp_NOTCOMPILED2(void);
+void cached_interp_NATIVE_CALL(void);
 void cached_interp_NI(void);
 void cached_interp_RESERVED(void);
 void cached_interp_LB(void);
@@ -0,0 +1,283 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - libultra_hle.c                                          *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "libultra_hle.h"
+
+#include <stddef.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "device/memory/memory.h"
+#include "device/r4300/r4300_core.h"
+#include "device/rdram/rdram.h"
+
+/* Entry sequences of the libultra routines as {word, mask}, in the order
+ * they are assembled (branch delay slots indented); masks drop the branch
+ * offsets, and for "move" whether it was assembled as or/addu. */
+static const uint32_t bzero_signature[][2] =
+{
+    { UINT32_C(0x00041823), UINT32_C(0xffffffff) }, /* negu  v1,a0 */
+    { UINT32_C(0x28a1000c), UINT32_C(0xffffffff) }, /* slti  at,a1,12 */
+    { UINT32_C(0x14200000), UINT32_C(0xffff0000) }, /* bnez  at,bytezero */
+    { UINT32_C(0x30630003), UINT32_C(0xffffffff) }, /*  andi v1,v1,3 */
+    { UINT32_C(0x10600000), UINT32_C(0xffff0000) }, /* beqz  v1,blkzero */
+    { UINT32_C(0x00a32823), UINT32_C(0xffffffff) }, /*  subu a1,a1,v1 */
+    { UINT32_C(0xa8800000), UINT32_C(0xffffffff) }, /* swl   zero,0(a0) */
+    { UINT32_C(0x00832021), UINT32_C(0xffffffff) }, /* addu  a0,a0,v1 */
+};
+
+static const uint32_t bcopy_signature[][2] =
+{
+    { UINT32_C(0x10c00000), UINT32_C(0xffff0000) }, /* beqz  a2,ret */
+    { UINT32_C(0x00a03821), UINT32_C(0xfffffffb) }, /*  move a3,a1 */
+    { UINT32_C(0x10850000), UINT32_C(0xffff0000) }, /* beq   a0,a1,ret */
+    { UINT32_C(0x00a4082a), UINT32_C(0xffffffff) }, /*  slt  at,a1,a0 */
+    { UINT32_C(0x54200000), UINT32_C(0xffff0000) }, /* bnezl at,forwards */
+    { UINT32_C(0x28c10010), UINT32_C(0xffffffff) }, /*  slti at,a2,16 */
+    { UINT32_C(0x00861020), UINT32_C(0xffffffff) }, /* add   v0,a0,a2 */
+    { UINT32_C(0x00a2082a), UINT32_C(0xffffffff) }, /* slt   at,a1,v0 */
+    { UINT32_C(0x50200000), UINT32_C(0xffff0000) }, /* beql  at,zero,forwards */
+    { UINT32_C(0x28c10010), UINT32_C(0xffffffff) }, /*  slti at,a2,16 */
+};
+
+#define SIGNATURE(routine, words) { routine, sizeof(words) / sizeof(words[0]), words }
+
+static const struct
+{
+    enum libultra_hle_routine routine;
+    size_t length;
+    const uint32_t (*words)[2];
+} signatures[] =
+{
+    SIGNATURE(LIBULTRA_HLE_BZERO, bzero_signature),
+    SIGNATURE(LIBULTRA_HLE_BCOPY, bcopy_signature),
+};
+
+#define MAX_SIGNATURE_LENGTH 10
+
+enum libultra_hle_routine libultra_hle_match(struct r4300_core* r4300, uint32_t address)
+{
+    const uint32_t* code;
+    uint32_t offset;
+    size_t i, k;
+
+    if ((address & UINT32_C(0xc0000003)) != UINT32_C(0x80000000)) {
+        return LIBULTRA_HLE_NONE;
+    }
+
+    offset = address & UINT32_C(0x1fffffff);
+    if (offset + 4 * MAX_SIGNATURE_LENGTH > r4300->rdram->dram_size) {
+        return LIBULTRA_HLE_NONE;
+    }
+    code = r4300->rdram->dram + offset / 4;
+
+    for (i = 0; i < sizeof(signatures) / sizeof(signatures[0]); ++i) {
+        for (k = 0; k < signatures[i].length; ++k) {
+            if ((code[k] & signatures[i].words[k][1]) != signatures[i].words[k][0]) {
+                break;
+            }
+        }
+        if (k == signatures[i].length) {
+            return signatures[i].routine;
+        }
+    }
+
+    return LIBULTRA_HLE_NONE;
+}
+
+
+/* Offset in RDRAM of a kseg0/kseg1 range lying entirely in it */
+static int rdram_range(const struct r4300_core* r4300, uint32_t address, uint32_t length, uint32_t* offset)
+{
+    if ((address & UINT32_C(0xc0000000)) != UINT32_C(0x80000000)) {
+        return 0;
+    }
+
+    *offset = address & UINT32_C(0x1fffffff);
+    return *offset < r4300->rdram->dram_size
+        && length <= r4300->rdram->dram_size - *offset;
+}
+
+/* Byte accesses through the memory map, for TLB-mapped or non-RDRAM ranges */
+static int read_byte(struct r4300_core* r4300, uint32_t address, uint8_t* value)
+{
+    uint32_t w;
+
+    if (!r4300_read_aligned_word(r4300, address, &w)) {
+        return 0;
+    }
+
+    *value = (uint8_t)(w >> (8 * (3 - (address & 3))));
+    return 1;
+}
+
+static int write_byte(struct r4300_core* r4300, uint32_t address, uint8_t value)
+{
+    unsigned int shift = 8 * (3 - (address & 3));
+
+    return r4300_write_aligned_word(r4300, address, (uint32_t)value << shift, UINT32_C(0xff) << shift);
+}
+
+static void charge_instructions(struct r4300_core* r4300, uint32_t ops)
+{
+    struct cp0* cp0 = &r4300->cp0;
+    uint32_t count = ops * cp0->count_per_op;
+
+    if (cp0->count_per_op_denom_pot) {
+        count += (1 << cp0->count_per_op_denom_pot) - 1;
+        count >>= cp0->count_per_op_denom_pot;
+    }
+
+    r4300_cp0_regs(cp0)[CP0_COUNT_REG] += count;
+    *r4300_cp0_cycle_count(cp0) += count;
+}
+
+/* Instructions bzero executes: alignment store, 32-byte block loop,
+ * word loop and byte loop, as laid out in the libultra code. */
+static uint32_t bzero_instructions(uint32_t dst, uint32_t length)
+{
+    uint32_t ops = 3;
+
+    if (length >= 12) {
+        uint32_t align = (0 - dst) & 3;
+
+        ops += 3 + (align ? 2 : 0);
+        length -= align;
+        ops += 4 + 10 * (length >> 5);
+        length &= 31;
+        ops += 4 + 3 * (length >> 2);
+        length &= 3;
+    }
+
+    ops += 2;
+    if (length > 0) {
+        ops += 1 + 3 * length;
+    }
+
+    return ops + 2;
+}
+
+/* Same for bcopy, whose loops use lw/sw pairs when src and dst share the
+ * word alignment and lwl/lwr otherwise. */
+static uint32_t bcopy_instructions(uint32_t src, uint32_t dst, uint32_t length)
+{
+    uint32_t ops = 12;
+
+    if (length >= 16 && ((src ^ dst) & 3) == 0) {
+        uint32_t align = (0 - dst) & 3;
+
+        ops += 4 + 4 * align;
+        length -= align;
+        ops += 4 + 20 * (length >> 5);
+        length &= 31;
+        ops += 4 + 5 * (length >> 2);
+        length &= 3;
+    }
+    else if (length >= 16) {
+        ops += 4 + 7 * (length >> 2);
+        length &= 3;
+    }
+
+    return ops + 3 + 5 * length + 2;
+}
+
+static void hle_bzero(struct r4300_core* r4300)
+{
+    int64_t* regs = r4300_regs(r4300);
+    uint32_t dst = (uint32_t)regs[4];
+    int32_t length = (int32_t)regs[5];
+    uint32_t offset;
+    uint32_t i;
+
+    if (length <= 0) {
+        charge_instructions(r4300, bzero_instructions(dst, 0));
+        return;
+    }
+
+    if (rdram_range(r4300, dst, (uint32_t)length, &offset)) {
+        memset_s8((uint8_t*)r4300->rdram->dram, offset, 0, (size_t)length);
+        invalidate_r4300_cached_code_dma(r4300, offset, (size_t)length);
+    }
+    else {
+        for (i = 0; i < (uint32_t)length; ++i) {
+            if (!write_byte(r4300, dst + i, 0)) {
+                DebugMessage(M64MSG_WARNING, "bzero HLE: cannot write %08x", dst + i);
+                break;
+            }
+        }
+    }
+
+    charge_instructions(r4300, bzero_instructions(dst, (uint32_t)length));
+}
+
+static void hle_bcopy(struct r4300_core* r4300)
+{
+    int64_t* regs = r4300_regs(r4300);
+    uint32_t src = (uint32_t)regs[4];
+    uint32_t dst = (uint32_t)regs[5];
+    int32_t length = (int32_t)regs[6];
+    uint32_t src_offset;
+    uint32_t dst_offset;
+    uint32_t i;
+    uint8_t byte;
+
+    /* bcopy returns its destination */
+    regs[2] = (int64_t)(int32_t)dst;
+
+    if (length <= 0 || src == dst) {
+        charge_instructions(r4300, 5);
+        return;
+    }
+
+    if (rdram_range(r4300, src, (uint32_t)length, &src_offset)
+     && rdram_range(r4300, dst, (uint32_t)length, &dst_offset)) {
+        memmove_s8((uint8_t*)r4300->rdram->dram, dst_offset, src_offset, (size_t)length);
+        invalidate_r4300_cached_code_dma(r4300, dst_offset, (size_t)length);
+    }
+    else if (dst - src >= (uint32_t)length) {
+        for (i = 0; i < (uint32_t)length; ++i) {
+            if (!read_byte(r4300, src + i, &byte) || !write_byte(r4300, dst + i, byte)) {
+                DebugMessage(M64MSG_WARNING, "bcopy HLE: cannot copy %08x to %08x", src + i, dst + i);
+                break;
+            }
+        }
+    }
+    else {
+        for (i = (uint32_t)length; i-- > 0;) {
+            if (!read_byte(r4300, src + i, &byte) || !write_byte(r4300, dst + i, byte)) {
+                DebugMessage(M64MSG_WARNING, "bcopy HLE: cannot copy %08x to %08x", src + i, dst + i);
+                break;
+            }
+        }
+    }
+
+    charge_instructions(r4300, bcopy_instructions(src, dst, (uint32_t)length));
+}
+
+void libultra_hle_run(struct r4300_core* r4300, enum libultra_hle_routine routine)
+{
+    switch (routine)
+    {
+    case LIBULTRA_HLE_BZERO: hle_bzero(r4300); break;
+    case LIBULTRA_HLE_BCOPY: hle_bcopy(r4300); break;
+    default: break;
+    }
+}
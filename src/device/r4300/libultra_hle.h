@@ -0,0 +1,45 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - libultra_hle.h                                          *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_DEVICE_R4300_LIBULTRA_HLE_H
+#define M64P_DEVICE_R4300_LIBULTRA_HLE_H
+
+#include <stdint.h>
+
+struct r4300_core;
+
+/* libultra routines the recompilers can run natively */
+enum libultra_hle_routine
+{
+    LIBULTRA_HLE_NONE,
+    LIBULTRA_HLE_BZERO,
+    LIBULTRA_HLE_BCOPY
+};
+
+/* Identify the libultra routine whose code starts at address.
+ * Only code in directly mapped RDRAM is considered. */
+enum libultra_hle_routine libultra_hle_match(struct r4300_core* r4300, uint32_t address);
+
+/* Perform routine on the guest arguments in a0-a2 and charge the cycles
+ * the guest code would have taken. The caller returns to $ra. */
+void libultra_hle_run(struct r4300_core* r4300, enum libultra_hle_routine routine);
+
+#endif /* M64P_DEVICE_R4300_LIBULTRA_HLE_H */
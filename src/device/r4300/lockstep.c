@@ -0,0 +1,542 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - lockstep.c                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "lockstep.h"
+
+#include <fenv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "device/memory/memory.h"
+#include "device/r4300/pure_interp.h"
+#include "device/r4300/r4300_core.h"
+#include "device/r4300/tlb.h"
+#include "device/rdram/rdram.h"
+
+#define LOCKSTEP_MAX_STEPS  256
+#define LOCKSTEP_MAX_STORES 256
+#define LOCKSTEP_LISTED_STEPS 32
+
+/* How the shadow's last run ended */
+enum lockstep_end
+{
+    LOCKSTEP_END_NONE,      /* no run to compare with */
+    LOCKSTEP_END_BRANCH,    /* took a branch or an exception */
+    LOCKSTEP_END_STOPPED    /* reached something it can't run, or its limits */
+};
+
+/* Shadow state at an instruction boundary of the run */
+struct lockstep_step
+{
+    uint32_t pc;
+    uint32_t op;            /* instruction run from here, 0 for the last step */
+    unsigned int stores;    /* stores the shadow made before reaching it */
+    unsigned int llbit;
+    uint32_t status;
+    uint32_t epc;
+    uint32_t fcr31;
+    int64_t regs[32];
+    int64_t hi;
+    int64_t lo;
+    cp1_reg fpr[32];
+};
+
+struct lockstep_store
+{
+    uint32_t address;
+    uint32_t value;
+};
+
+struct lockstep
+{
+    struct r4300_core* primary;
+    struct r4300_core* shadow;
+    void* shadow_alloc;
+    struct memory mem;
+
+    enum lockstep_end end;
+    int blocked;
+    int diverged;
+
+    unsigned int step_count;
+    struct lockstep_step steps[LOCKSTEP_MAX_STEPS];
+    unsigned int store_count;
+    struct lockstep_store stores[LOCKSTEP_MAX_STORES];
+
+    uint64_t compared;
+    uint64_t skipped;
+};
+
+static const char* const gpr_names[32] =
+{
+    "r0", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+    "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+    "t8", "t9", "k0", "k1", "gp", "sp", "s8", "ra"
+};
+
+
+/* Shadow memory: RDRAM reads see the shadow's own stores over the real
+ * contents, anything else stops the run */
+static int find_store(const struct lockstep* ls, uint32_t address)
+{
+    int i;
+
+    for (i = (int)ls->store_count - 1; i >= 0; --i) {
+        if (ls->stores[i].address == address) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int direct_rdram(const struct lockstep* ls, uint32_t address)
+{
+    const struct mem_handler* handler = mem_get_handler(ls->primary->mem, address);
+
+    return address < ls->primary->rdram->dram_size
+        && (handler->read32 == read_rdram_dram || handler->read32 == read_with_bp_checks);
+}
+
+static void read_shadow_rdram(void* opaque, uint32_t address, uint32_t* value)
+{
+    struct lockstep* ls = (struct lockstep*)opaque;
+    int i;
+
+    if (!direct_rdram(ls, address)) {
+        ls->blocked = 1;
+        *value = 0;
+        return;
+    }
+
+    i = find_store(ls, address);
+    *value = (i >= 0)
+        ? ls->stores[i].value
+        : ls->primary->rdram->dram[rdram_dram_address(address)];
+}
+
+static void write_shadow_rdram(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
+{
+    struct lockstep* ls = (struct lockstep*)opaque;
+    uint32_t word;
+
+    read_shadow_rdram(opaque, address, &word);
+    if (ls->blocked || ls->store_count == LOCKSTEP_MAX_STORES) {
+        ls->blocked = 1;
+        return;
+    }
+
+    masked_write(&word, value, mask);
+    ls->stores[ls->store_count].address = address;
+    ls->stores[ls->store_count].value = word;
+    ++ls->store_count;
+}
+
+static void read_shadow_io(void* opaque, uint32_t address, uint32_t* value)
+{
+    ((struct lockstep*)opaque)->blocked = 1;
+    *value = 0;
+}
+
+static void write_shadow_io(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
+{
+    ((struct lockstep*)opaque)->blocked = 1;
+}
+
+
+int lockstep_init(struct r4300_core* r4300)
+{
+#ifdef NEW_DYNAREC
+    struct lockstep* ls;
+    struct r4300_core* shadow;
+    size_t i;
+
+    if (r4300->emumode < EMUMODE_DYNAREC) {
+        DebugMessage(M64MSG_WARNING, "Lockstep checking needs the dynamic recompiler");
+        return 0;
+    }
+
+    ls = calloc(1, sizeof(*ls));
+    if (ls == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate lockstep state");
+        return 0;
+    }
+
+    /* struct r4300_core has page-aligned members */
+    ls->shadow_alloc = calloc(1, sizeof(*shadow) + 4096);
+    if (ls->shadow_alloc == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate lockstep state");
+        free(ls);
+        return 0;
+    }
+    shadow = (struct r4300_core*)(((uintptr_t)ls->shadow_alloc + 4095) & ~(uintptr_t)4095);
+
+    ls->mem.base = r4300->mem->base;
+    for (i = 0; i < 0x10000; ++i) {
+        ls->mem.handlers[i].opaque = ls;
+        if ((i << 16) < r4300->rdram->dram_size) {
+            ls->mem.handlers[i].read32 = read_shadow_rdram;
+            ls->mem.handlers[i].write32 = write_shadow_rdram;
+        }
+        else {
+            ls->mem.handlers[i].read32 = read_shadow_io;
+            ls->mem.handlers[i].write32 = write_shadow_io;
+        }
+    }
+
+    init_r4300(shadow, &ls->mem, r4300->mi, r4300->rdram, r4300->cp0.interrupt_handlers,
+        EMUMODE_PURE_INTERPRETER, r4300->cp0.count_per_op, r4300->cp0.count_per_op_denom_pot,
+        0, 0, 0, r4300->start_address);
+    poweron_r4300(shadow);
+    *r4300_pc_struct(shadow) = &shadow->interp_PC;
+    /* the shadow never services interrupts, savestates or resets */
+    shadow->cp0.interrupt_unsafe_state = 1;
+
+    ls->primary = r4300;
+    ls->shadow = shadow;
+    r4300->lockstep = ls;
+
+    DebugMessage(M64MSG_INFO, "Checking the dynamic recompiler against the pure interpreter");
+    return 1;
+#else
+    DebugMessage(M64MSG_WARNING, "Lockstep checking needs the new dynamic recompiler");
+    return 0;
+#endif
+}
+
+void lockstep_release(struct r4300_core* r4300)
+{
+    struct lockstep* ls = r4300->lockstep;
+
+    if (ls == NULL) {
+        return;
+    }
+
+    DebugMessage(M64MSG_INFO, "Lockstep: %llu checks compared, %llu skipped",
+        (unsigned long long)ls->compared, (unsigned long long)ls->skipped);
+
+    r4300->lockstep = NULL;
+    free(ls->shadow_alloc);
+    free(ls);
+}
+
+void lockstep_reset(struct r4300_core* r4300)
+{
+    if (r4300->lockstep != NULL) {
+        r4300->lockstep->end = LOCKSTEP_END_NONE;
+    }
+}
+
+
+static void record_step(struct lockstep* ls)
+{
+    struct r4300_core* shadow = ls->shadow;
+    struct lockstep_step* step = &ls->steps[ls->step_count++];
+
+    step->pc = *r4300_pc(shadow);
+    step->op = 0;
+    step->stores = ls->store_count;
+    step->llbit = *r4300_llbit(shadow);
+    step->status = r4300_cp0_regs(&shadow->cp0)[CP0_STATUS_REG];
+    step->epc = r4300_cp0_regs(&shadow->cp0)[CP0_EPC_REG];
+    step->fcr31 = *r4300_cp1_fcr31(&shadow->cp1);
+    memcpy(step->regs, r4300_regs(shadow), sizeof(step->regs));
+    step->hi = *r4300_mult_hi(shadow);
+    step->lo = *r4300_mult_lo(shadow);
+    memcpy(step->fpr, r4300_cp1_regs(&shadow->cp1), sizeof(step->fpr));
+}
+
+static void sync_tlb(struct tlb* dst, const struct tlb* src)
+{
+    size_t i;
+
+    for (i = 0; i < 32; ++i) {
+        if (memcmp(&dst->entries[i], &src->entries[i], sizeof(src->entries[i])) != 0) {
+            tlb_unmap(dst, i);
+            dst->entries[i] = src->entries[i];
+            tlb_map(dst, i);
+        }
+    }
+}
+
+/* Load the shadow with the primary's state */
+static void resync(struct lockstep* ls)
+{
+    struct r4300_core* r4300 = ls->primary;
+    struct r4300_core* shadow = ls->shadow;
+    uint32_t* cp0_regs = r4300_cp0_regs(&shadow->cp0);
+
+    memcpy(r4300_regs(shadow), r4300_regs(r4300), 32 * sizeof(int64_t));
+    *r4300_mult_hi(shadow) = *r4300_mult_hi(r4300);
+    *r4300_mult_lo(shadow) = *r4300_mult_lo(r4300);
+    *r4300_llbit(shadow) = *r4300_llbit(r4300);
+
+    memcpy(cp0_regs, r4300_cp0_regs(&r4300->cp0), CP0_REGS_COUNT * sizeof(uint32_t));
+    *r4300_cp0_latch(&shadow->cp0) = *r4300_cp0_latch(&r4300->cp0);
+    sync_tlb(&shadow->cp0.tlb, &r4300->cp0.tlb);
+
+    memcpy(r4300_cp1_regs(&shadow->cp1), r4300_cp1_regs(&r4300->cp1), 32 * sizeof(cp1_reg));
+    *r4300_cp1_fcr0(&shadow->cp1) = *r4300_cp1_fcr0(&r4300->cp1);
+    *r4300_cp1_fcr31(&shadow->cp1) = *r4300_cp1_fcr31(&r4300->cp1);
+    set_fpr_pointers(&shadow->cp1, cp0_regs[CP0_STATUS_REG]);
+    shadow->cp1.rounding_mode = r4300->cp1.rounding_mode;
+#ifdef OSAL_SSE
+    shadow->cp1.flush_mode = r4300->cp1.flush_mode;
+#endif
+
+    shadow->delay_slot = 0;
+    shadow->skip_jump = 0;
+    *r4300_stop(shadow) = 0;
+    *r4300_pc(shadow) = *r4300_pc(r4300);
+    shadow->cp0.last_addr = *r4300_pc(r4300);
+    /* far enough from an interrupt for any run */
+    *r4300_cp0_cycle_count(&shadow->cp0) = -0x40000000;
+}
+
+/* Instructions the shadow can't run on its own: COP0 writes and TLB
+ * operations, which reach the interrupt queue, and idle loops, which
+ * skip to the next interrupt */
+static int shadow_can_run(uint32_t pc, uint32_t op)
+{
+    uint32_t opcode = op >> 26;
+    uint32_t rs = (op >> 21) & 0x1f;
+
+    switch (opcode)
+    {
+    case 2: case 3:         /* J, JAL */
+        return ((((pc + 4) & UINT32_C(0xf0000000)) | ((op & UINT32_C(0x3ffffff)) << 2)) != pc);
+    case 1: case 4: case 5: case 6: case 7:
+    case 20: case 21: case 22: case 23:
+        return (int16_t)op != -1;
+    case 16:                /* COP0 */
+        return rs == 0;
+    case 17:                /* COP1 */
+        return rs != 8 || (int16_t)op != -1;
+    default:
+        return 1;
+    }
+}
+
+/* Run the shadow up to the next taken branch or exception */
+static void run_shadow_steps(struct lockstep* ls)
+{
+    struct r4300_core* shadow = ls->shadow;
+    uint32_t pc;
+    uint32_t next_pc;
+    uint32_t address;
+    uint32_t op;
+
+    ls->step_count = 0;
+    ls->store_count = 0;
+    ls->blocked = 0;
+    ls->end = LOCKSTEP_END_STOPPED;
+    record_step(ls);
+
+    if (r4300_has_native_call(ls->primary, *r4300_pc(shadow))) {
+        return;
+    }
+
+    while (ls->step_count < LOCKSTEP_MAX_STEPS)
+    {
+        pc = *r4300_pc(shadow);
+
+        /* only code in RDRAM, fetched without raising TLB exceptions */
+        address = pc;
+        if ((address & UINT32_C(0xc0000000)) != UINT32_C(0x80000000)) {
+            if (shadow->cp0.tlb.LUT_r[address >> 12] == 0) {
+                return;
+            }
+            address = (shadow->cp0.tlb.LUT_r[address >> 12] & UINT32_C(0xfffff000)) | (address & UINT32_C(0xfff));
+        }
+        address &= UINT32_C(0x1ffffffc);
+        if (!direct_rdram(ls, address)) {
+            return;
+        }
+        op = ls->primary->rdram->dram[rdram_dram_address(address)];
+
+        if (!shadow_can_run(pc, op)) {
+            return;
+        }
+
+        ls->steps[ls->step_count - 1].op = op;
+        pure_interp_step(shadow);
+        if (ls->blocked || *r4300_stop(shadow)) {
+            return;
+        }
+        record_step(ls);
+
+        next_pc = *r4300_pc(shadow);
+        if (*r4300_cp0_cycle_count(&shadow->cp0) >= 0
+         || (next_pc - pc != 4 && next_pc - pc != 8)) {
+            ls->end = LOCKSTEP_END_BRANCH;
+            return;
+        }
+    }
+}
+
+/* The shadow's CTC1 and conversions set the host rounding and flush modes,
+ * which the recompiled code shares, so give the primary its own back */
+static void run_shadow(struct lockstep* ls)
+{
+    fenv_t fenv;
+#ifdef OSAL_SSE
+    unsigned int ftz = _MM_GET_FLUSH_ZERO_MODE();
+#endif
+
+    fegetenv(&fenv);
+    run_shadow_steps(ls);
+    fesetenv(&fenv);
+#ifdef OSAL_SSE
+    _MM_SET_FLUSH_ZERO_MODE(ftz);
+#endif
+}
+
+
+static void report_code(const struct lockstep* ls, unsigned int count)
+{
+    unsigned int i = (count > LOCKSTEP_LISTED_STEPS) ? count - LOCKSTEP_LISTED_STEPS : 0;
+
+    DebugMessage(M64MSG_ERROR, "Lockstep: code run from %08x (%u instructions):", ls->steps[0].pc, count);
+    for (; i < count; ++i) {
+        DebugMessage(M64MSG_ERROR, "  %08x: %08x", ls->steps[i].pc, ls->steps[i].op);
+    }
+}
+
+static int compare_reg(const char* name, int64_t recompiler, int64_t interpreter, int upper_stale)
+{
+    if (upper_stale) {
+        recompiler = (int32_t)recompiler;
+        interpreter = (int32_t)interpreter;
+    }
+
+    if (recompiler == interpreter) {
+        return 0;
+    }
+
+    DebugMessage(M64MSG_ERROR, "  %s: recompiler %016llx, interpreter %016llx",
+        name, (unsigned long long)recompiler, (unsigned long long)interpreter);
+    return 1;
+}
+
+static int compare_word(const char* name, uint32_t recompiler, uint32_t interpreter)
+{
+    if (recompiler == interpreter) {
+        return 0;
+    }
+
+    DebugMessage(M64MSG_ERROR, "  %s: recompiler %08x, interpreter %08x", name, recompiler, interpreter);
+    return 1;
+}
+
+/* Compare the primary with step j of the shadow's run, reporting the
+ * differences. Returns the number found. */
+static int compare_step(struct lockstep* ls, unsigned int j, uint32_t stale, uint32_t stale_upper)
+{
+    struct r4300_core* r4300 = ls->primary;
+    const struct lockstep_step* step = &ls->steps[j];
+    const int64_t* regs = r4300_regs(r4300);
+    const uint32_t* cp0_regs = r4300_cp0_regs(&r4300->cp0);
+    const cp1_reg* fpr = r4300_cp1_regs(&r4300->cp1);
+    char name[16];
+    int diffs = 0;
+    unsigned int i, k;
+
+    for (i = 1; i < 32; ++i) {
+        if (!(stale & (UINT32_C(1) << i))) {
+            diffs += compare_reg(gpr_names[i], regs[i], step->regs[i], (stale_upper >> i) & 1);
+        }
+    }
+    if (!(stale & 1)) {
+        diffs += compare_reg("hi", *r4300_mult_hi(r4300), step->hi, stale_upper & 1);
+        diffs += compare_reg("lo", *r4300_mult_lo(r4300), step->lo, stale_upper & 1);
+    }
+    for (i = 0; i < 32; ++i) {
+        sprintf(name, "f%u", i);
+        diffs += compare_reg(name, fpr[i].dword, step->fpr[i].dword, 0);
+    }
+    diffs += compare_word("fcr31", *r4300_cp1_fcr31(&r4300->cp1), step->fcr31);
+    diffs += compare_word("llbit", *r4300_llbit(r4300), step->llbit);
+    diffs += compare_word("status", cp0_regs[CP0_STATUS_REG], step->status);
+    diffs += compare_word("epc", cp0_regs[CP0_EPC_REG], step->epc);
+
+    /* the last store to each word */
+    for (i = 0; i < step->stores; ++i) {
+        for (k = i + 1; k < step->stores; ++k) {
+            if (ls->stores[k].address == ls->stores[i].address) {
+                break;
+            }
+        }
+        if (k == step->stores) {
+            sprintf(name, "[%08x]", ls->stores[i].address);
+            diffs += compare_word(name,
+                r4300->rdram->dram[rdram_dram_address(ls->stores[i].address)],
+                ls->stores[i].value);
+        }
+    }
+
+    return diffs;
+}
+
+void lockstep_check(struct r4300_core* r4300, uint32_t stale, uint32_t stale_upper)
+{
+    struct lockstep* ls = r4300->lockstep;
+    uint32_t pc = *r4300_pc(r4300);
+    uint32_t status = r4300_cp0_regs(&r4300->cp0)[CP0_STATUS_REG];
+    unsigned int j;
+
+    if (ls == NULL || ls->diverged) {
+        return;
+    }
+
+    if (ls->end != LOCKSTEP_END_NONE)
+    {
+        for (j = 1; j < ls->step_count && ls->steps[j].pc != pc; ++j);
+
+        if (j < ls->step_count) {
+            if (compare_step(ls, j, stale, stale_upper) != 0) {
+                DebugMessage(M64MSG_ERROR, "Lockstep: divergence at %08x", pc);
+                report_code(ls, j);
+                ls->diverged = 1;
+                return;
+            }
+            ++ls->compared;
+        }
+        /* interrupts are taken at branches, where the shadow stops */
+        else if (ls->end == LOCKSTEP_END_BRANCH
+              && !((status & ~ls->steps[0].status) & (CP0_STATUS_EXL | CP0_STATUS_ERL))) {
+            DebugMessage(M64MSG_ERROR, "Lockstep: recompiler went to %08x, interpreter to %08x",
+                pc, ls->steps[ls->step_count - 1].pc);
+            report_code(ls, ls->step_count - 1);
+            ls->diverged = 1;
+            return;
+        }
+        else {
+            ++ls->skipped;
+        }
+    }
+
+    resync(ls);
+    run_shadow(ls);
+}
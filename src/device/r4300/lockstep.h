@@ -0,0 +1,59 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - lockstep.h                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_DEVICE_R4300_LOCKSTEP_H
+#define M64P_DEVICE_R4300_LOCKSTEP_H
+
+#include <stdint.h>
+
+struct r4300_core;
+
+/* Checks the dynamic recompiler against a pure interpreter running on a
+ * shadow copy of the CPU, in the same process.
+ *
+ * At each check the shadow is loaded with the recompiler's state and runs
+ * ahead up to the next taken branch or exception, reading RDRAM but keeping
+ * its stores to itself. The next check finds the shadow's state at the same
+ * pc and compares the registers, and the words the shadow stored with RDRAM.
+ * The first divergence is reported with the code that led to it, and stops
+ * the checks.
+ *
+ * The shadow does not run through I/O accesses, COP0 writes, idle loops or
+ * native calls, and interrupts are not replayed: the check after those is
+ * skipped. RDRAM written concurrently by the RSP thread can be reported.
+ */
+
+/* Start checking r4300, which must run the new dynarec. Returns 0 if
+ * lockstep checking is not available. */
+int lockstep_init(struct r4300_core* r4300);
+void lockstep_release(struct r4300_core* r4300);
+
+/* Compare with the shadow and start its next run from the current state.
+ * Called by the recompiler with the guest registers in memory. GPRs with a
+ * bit set in stale may be out of date there (dead in the compiled code),
+ * those in stale_upper only in their upper halves. Bit 0 stands for hi/lo. */
+void lockstep_check(struct r4300_core* r4300, uint32_t stale, uint32_t stale_upper);
+
+/* Drop the shadow's run, when the guest state changed outside of the CPU
+ * (savestate, reset, debugger) */
+void lockstep_reset(struct r4300_core* r4300);
+
+#endif /* M64P_DEVICE_R4300_LOCKSTEP_H */
@@ -122,6 +122,10 @@ static u_int jump_table_symbols[] = {
   (int)TLBWR_new,
   (int)MFC0_new,
   (int)MTC0_new,
+#ifdef DBG
+  (int)BREAKPOINT_new,
+#endif
+  (int)LOCKSTEP_new,
   (int)jump_vaddr_r0,
   (int)jump_vaddr_r1,
   (int)jump_vaddr_r2,
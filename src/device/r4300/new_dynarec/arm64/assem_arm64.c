@@ -141,6 +141,10 @@ static uintptr_t jump_table_symbols[] = {
   (intptr_t)TLBWR_new,
   (intptr_t)MFC0_new,
   (intptr_t)MTC0_new,
+#ifdef DBG
+  (intptr_t)BREAKPOINT_new,
+#endif
+  (intptr_t)LOCKSTEP_new,
   (intptr_t)jump_vaddr_x0,
   (intptr_t)jump_vaddr_x1,
   (intptr_t)jump_vaddr_x2,
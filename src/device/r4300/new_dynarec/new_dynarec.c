@@ -32,6 +32,7 @@
 #include "new_dynarec.h"
 #include "api/m64p_types.h"
 #include "api/callbacks.h"
+#include "api/memoryexport.h"
 #include "main/main.h"
 #include "main/rom.h"
 #include "device/memory/memory.h"
@@ -41,13 +42,27 @@
 #include "device/r4300/interrupt.h"
 #include "device/r4300/tlb.h"
 #include "device/r4300/fpu.h"
+#include "device/r4300/lockstep.h"
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/rsp/rsp_core.h"
+#ifdef DBG
+#include "debugger/dbg_debugger.h"
+#endif
+#include "osal/preproc.h"
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
 
 #if !defined(WIN32)
 #include <sys/mman.h>
 #endif
 
+#if defined(WIN32) && !defined(__MINGW32__)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 #if defined(RECOMPILER_DEBUG) && !defined(RECOMP_DBG)
 void recomp_dbg_init(void);
 void recomp_dbg_cleanup(void);
@@ -212,6 +227,56 @@ struct ll_entry
   u_int reg32;
   u_int start;
   u_int length;
+  uint64_t page_sum; // Dirty entries: checksum of the page when compiled, 0 if none
+};
+
+// Block metadata (ll_entry) and source copies are carved out of chunks
+// tagged with the code cache region they describe.  Everything in a region
+// expires together, so chunks empty out as a whole and are recycled
+// without going back to malloc.
+#define ARENA_REGIONS 8 // Same split as the expiry pass in new_recompile_block
+#define ARENA_CHUNK_SIZE 65536
+
+// Dispatch lookup table: vaddr -> compiled code.  Each set is one bucket
+// of HT_WAYS slots sized to a cache line on 64-bit hosts, so a lookup
+// touches a single line.  Slot 0 is the most recently inserted.
+// The jump_in/jump_dirty lists remain the authoritative record and are
+// only walked on a miss.
+#define HT_WAYS 4
+#define HT_SETS 32768
+
+// Compile log: per-block counters, kept only while the log is open.
+// Open addressing on the block start; once the table is 3/4 full new
+// blocks are logged without counters.
+#define COMPILE_STATS_SIZE 65536
+
+struct ht_slot
+{
+  void *addr;
+  u_int vaddr;
+  u_int clean; // addr is a jump_in entry (not a dirty-check stub)
+};
+
+struct ht_bucket
+{
+  struct ht_slot slot[HT_WAYS];
+};
+
+struct compile_stats
+{
+  u_int start; // 0 = unused (no block starts at address 0)
+  u_int compiles;
+  u_int invalidations;
+};
+
+struct arena_chunk
+{
+  struct arena_chunk *next_free;
+  struct arena_chunk *next_all;
+  u_int used;
+  u_int live;
+  int region;
+  u_int pad;
 };
 
 /* linkage */
@@ -260,6 +325,7 @@ static int imm[MAXBLOCK];
 static u_int ba[MAXBLOCK];
 static char likely[MAXBLOCK];
 static char is_ds[MAXBLOCK];
+static char hooked[MAXBLOCK]; // Breakpoint hook ahead of the instruction
 static char ooo[MAXBLOCK];
 static uint64_t unneeded_reg[MAXBLOCK];
 static uint64_t unneeded_reg_upper[MAXBLOCK];
@@ -290,11 +356,27 @@ static char *copy;
 static int expirep;
 static u_int dirty_entry_count;
 static u_int copy_size;
-static struct ll_entry* hash_table[65536][2];
+ALIGN(64, static struct ht_bucket hash_table[HT_SETS]);
+static struct new_dynarec_dispatch_stats dispatch_stats;
 static struct ll_entry *jump_in[4096];
 static struct ll_entry *jump_dirty[4096];
 static struct ll_entry *jump_out[4096];
+static struct ll_entry *jump_span[4096];
+static struct arena_chunk *arena_cur[ARENA_REGIONS];
+static struct arena_chunk *arena_pool;
+static struct arena_chunk *arena_all;
 static unsigned char restore_candidate[512];
+// Loads from a constant address in cart ROM are folded into the generated
+// code.  RDRAM is not: the RSP, the plugins and exported memory write it
+// without going through the invalidation paths.  rom_deps lists the blocks
+// which folded a ROM value, so that a ROM write can discard them.
+static struct ll_entry *rom_deps;
+static int const_folded;
+static int const_fold_ok;
+static uint64_t block_page_sum;
+static FILE *compile_log;
+static struct compile_stats *compile_stats;
+static u_int compile_stats_count;
 
 #if COUNT_NOTCOMPILEDS
 static int notcompiledCount = 0;
@@ -1672,7 +1754,7 @@ static int get_final_value(int hr, int i, int *value)
   while(i<slen-1) {
     if(regs[i+1].regmap[hr]!=reg) break;
     if(!((regs[i+1].isconst>>hr)&1)) break;
-    if(bt[i+1]) break;
+    if(bt[i+1]||hooked[i+1]) break;
     i++;
   }
   if(i<slen-1) {
@@ -1821,17 +1903,164 @@ static void add_stub(int type,intptr_t addr,intptr_t retaddr,int a,intptr_t b,in
   stubcount++;
 }
 
+static struct ht_bucket *ht_bucket(u_int vaddr)
+{
+  return &hash_table[((vaddr>>17)^(vaddr>>2)^vaddr)&(HT_SETS-1)];
+}
+
+static void *ht_lookup(u_int vaddr)
+{
+  struct ht_slot *slot=ht_bucket(vaddr)->slot;
+  int n;
+  for(n=0;n<HT_WAYS;n++)
+    if(slot[n].vaddr==vaddr&&slot[n].addr) return slot[n].addr;
+  return NULL;
+}
+
+// Slot already mapping vaddr, else the first free slot, else HT_WAYS
+static int ht_way(const struct ht_slot *slot,u_int vaddr)
+{
+  int n,empty=HT_WAYS;
+  for(n=0;n<HT_WAYS;n++) {
+    if(slot[n].addr==NULL) {
+      if(empty==HT_WAYS) empty=n;
+    }
+    else if(slot[n].vaddr==vaddr) return n;
+  }
+  return empty;
+}
+
+// Insert as most recently used, evicting the oldest slot if needed
+static void ht_insert(u_int vaddr,struct ll_entry *head)
+{
+  struct ht_slot *slot=ht_bucket(vaddr)->slot;
+  int n=ht_way(slot,vaddr);
+  if(n==HT_WAYS) n=HT_WAYS-1;
+  for(;n>0;n--) slot[n]=slot[n-1];
+  slot[0].addr=head->addr;
+  slot[0].vaddr=vaddr;
+  slot[0].clean=head->addr==head->clean_addr;
+}
+
+// Update an existing mapping, or fill an empty slot.  Never evicts,
+// as the existing entries are probably being accessed frequently.
+static void ht_insert_low(u_int vaddr,struct ll_entry *head)
+{
+  struct ht_slot *slot=ht_bucket(vaddr)->slot;
+  int n=ht_way(slot,vaddr);
+  if(n==HT_WAYS) return;
+  slot[n].addr=head->addr;
+  slot[n].vaddr=vaddr;
+  slot[n].clean=head->addr==head->clean_addr;
+}
+
+// Point an existing mapping at a new block, without adding new entries
+static void ht_replace(u_int vaddr,struct ll_entry *head)
+{
+  struct ht_slot *slot=ht_bucket(vaddr)->slot;
+  int n;
+  for(n=0;n<HT_WAYS;n++) {
+    if(slot[n].addr&&slot[n].vaddr==vaddr) {
+      slot[n].addr=head->addr;
+      slot[n].clean=head->addr==head->clean_addr;
+    }
+  }
+}
+
 static void remove_hash(u_int vaddr)
 {
   //DebugMessage(M64MSG_VERBOSE, "remove hash: %x",vaddr);
-  struct ll_entry **ht_bin=hash_table[(((vaddr)>>16)^vaddr)&0xFFFF];
-  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) {
-    ht_bin[1]=NULL;
+  struct ht_slot *slot=ht_bucket(vaddr)->slot;
+  int n;
+  for(n=0;n<HT_WAYS;n++)
+    if(slot[n].vaddr==vaddr) slot[n].addr=NULL;
+}
+
+static void ht_clear(void)
+{
+  memset(hash_table,0,sizeof(hash_table));
+}
+
+void new_dynarec_get_dispatch_stats(struct new_dynarec_dispatch_stats* stats)
+{
+  *stats=dispatch_stats;
+}
+
+void new_dynarec_reset_dispatch_stats(void)
+{
+  memset(&dispatch_stats,0,sizeof(dispatch_stats));
+}
+
+#if defined(WIN32) && !defined(__MINGW32__)
+static uint64_t compile_clock_ns(void)
+{
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER counter;
+  if(freq.QuadPart==0) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)(counter.QuadPart/freq.QuadPart)*1000000000+
+         (uint64_t)(counter.QuadPart%freq.QuadPart)*1000000000/freq.QuadPart;
+}
+#else
+static uint64_t compile_clock_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec*1000000000+ts.tv_nsec;
+}
+#endif
+
+// Counters for the block starting at 'start', NULL if the table is full
+static struct compile_stats *compile_stats_get(u_int start)
+{
+  u_int n=((start>>2)*2654435761u)>>16;
+  for(;;n=(n+1)&(COMPILE_STATS_SIZE-1)) {
+    if(compile_stats[n].start==start) return &compile_stats[n];
+    if(compile_stats[n].start==0) break;
+  }
+  if(compile_stats_count>=COMPILE_STATS_SIZE/4*3) return NULL;
+  compile_stats_count++;
+  compile_stats[n].start=start;
+  return &compile_stats[n];
+}
+
+static void compile_stats_invalidated(u_int start)
+{
+  struct compile_stats *stats=compile_stats_get(start);
+  if(stats) stats->invalidations++;
+}
+
+static void compile_log_block(u_int start,u_int length,u_int host_size,uint64_t ns)
+{
+  struct compile_stats *stats=compile_stats_get(start);
+  if(stats) stats->compiles++;
+  fprintf(compile_log,"%08x-%08x host=%u ns=%llu compiles=%u invalidations=%u\n",
+          start,start+length-1,host_size,(unsigned long long)ns,
+          stats?stats->compiles:0,stats?stats->invalidations:0);
+}
+
+int new_dynarec_set_compile_log(const char* path)
+{
+  if(compile_log) {
+    fclose(compile_log);
+    compile_log=NULL;
   }
-  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-    ht_bin[0]=ht_bin[1];
-    ht_bin[1]=NULL;
+  free(compile_stats);
+  compile_stats=NULL;
+  compile_stats_count=0;
+  if(path==NULL) return 0;
+
+  compile_stats=calloc(COMPILE_STATS_SIZE,sizeof(*compile_stats));
+  if(compile_stats==NULL) return -1;
+  compile_log=fopen(path,"w");
+  if(compile_log==NULL) {
+    DebugMessage(M64MSG_ERROR, "Couldn't open compile log %s", path);
+    free(compile_stats);
+    compile_stats=NULL;
+    return -1;
   }
+  fprintf(compile_log,"# guest range, host code bytes, compile time, times compiled, times invalidated\n");
+  return 0;
 }
 
 /**** Interpreted opcodes ****/
@@ -1849,7 +2078,8 @@ void* SYSCALL_new(void)
     struct r4300_core* r4300 = &g_dev.r4300;
     struct new_dynarec_hot_state* state = &r4300->new_dynarec_hot_state;
     r4300->delay_slot = 0;
-    cached_interp_SYSCALL();
+    if (!r4300_do_native_call(r4300, state->pcaddr))
+        cached_interp_SYSCALL();
     return get_addr_ht(state->pcaddr);
 }
 
@@ -2065,6 +2295,30 @@ static void MTC0_new(int copr, int count, int pcaddr)
   UPDATE_COUNT_OUT
 }
 
+#ifdef DBG
+static void BREAKPOINT_new(int pcaddr, int count)
+{
+  UPDATE_COUNT_IN
+  state->pcaddr = pcaddr;
+  r4300->delay_slot = 0;
+  cp0_update_count(r4300);
+  update_debugger(pcaddr);
+  // Leave the block if emulation was stopped while paused
+  if(state->stop) state->pending_exception = 1;
+  UPDATE_COUNT_OUT
+}
+#endif
+
+static void LOCKSTEP_new(int pcaddr, int count, u_int stale, u_int stale_upper)
+{
+  UPDATE_COUNT_IN
+  state->pcaddr = pcaddr;
+  r4300->delay_slot = 0;
+  cp0_update_count(r4300);
+  lockstep_check(r4300, stale, stale_upper);
+  UPDATE_COUNT_OUT
+}
+
 #define BITS_BELOW_MASK32(x) ((UINT32_C(1) << (x)) - 1)
 #define BITS_ABOVE_MASK32(x) (~(BITS_BELOW_MASK32((x))))
 
@@ -2365,11 +2619,76 @@ u_int verify_dirty(struct ll_entry * head)
     return 0;
 }
 
+static uint64_t rdram_page_sum(u_int page)
+{
+  return XXH3_64bits((char *)g_dev.rdram.dram+(page<<12),4096);
+}
+
+static int arena_region(const void *code)
+{
+  return (int)((((uintptr_t)code-(uintptr_t)base_addr)>>(TARGET_SIZE_2-3))&(ARENA_REGIONS-1));
+}
+
+// Allocate from the chunk belonging to the cache region holding 'code'
+static void *arena_alloc(const void *code,u_int size)
+{
+  int region=arena_region(code);
+  struct arena_chunk *chunk=arena_cur[region];
+  size=(size+sizeof(void *)+7)&~7;
+  assert(size<=ARENA_CHUNK_SIZE-sizeof(struct arena_chunk));
+  if(chunk!=NULL&&chunk->live==0)
+    chunk->used=sizeof(struct arena_chunk); // Everything in it has expired
+  if(chunk==NULL||chunk->used+size>ARENA_CHUNK_SIZE) {
+    if(arena_pool) {
+      chunk=arena_pool;
+      arena_pool=chunk->next_free;
+    }
+    else {
+      chunk=(struct arena_chunk *)malloc(ARENA_CHUNK_SIZE);
+      assert(chunk!=NULL);
+      chunk->next_all=arena_all;
+      arena_all=chunk;
+    }
+    chunk->next_free=NULL;
+    chunk->used=sizeof(struct arena_chunk);
+    chunk->live=0;
+    chunk->region=region;
+    arena_cur[region]=chunk;
+  }
+  void **ptr=(void **)((u_char *)chunk+chunk->used);
+  chunk->used+=size;
+  chunk->live++;
+  ptr[0]=chunk;
+  return ptr+1;
+}
+
+// Drop one allocation; the chunk is recycled once nothing in it is live
+static void arena_free(void *ptr)
+{
+  struct arena_chunk *chunk=(struct arena_chunk *)((void **)ptr)[-1];
+  assert(chunk->live>0);
+  if(--chunk->live==0&&arena_cur[chunk->region]!=chunk) {
+    chunk->next_free=arena_pool;
+    arena_pool=chunk;
+  }
+}
+
+static void arena_cleanup(void)
+{
+  while(arena_all) {
+    struct arena_chunk *next=arena_all->next_all;
+    free(arena_all);
+    arena_all=next;
+  }
+  memset(arena_cur,0,sizeof(arena_cur));
+  arena_pool=NULL;
+}
+
 // Add virtual address mapping for 32-bit compiled block
 static struct ll_entry *ll_add_32(struct ll_entry **head,int vaddr,u_int reg32,void *addr,void *clean_addr,u_int start,void *copy,u_int length)
 {
   struct ll_entry *new_entry;
-  new_entry=(struct ll_entry *)malloc(sizeof(struct ll_entry));
+  new_entry=(struct ll_entry *)arena_alloc(addr,sizeof(struct ll_entry));
   assert(new_entry!=NULL);
   new_entry->vaddr=vaddr;
   new_entry->reg32=reg32;
@@ -2378,6 +2697,7 @@ static struct ll_entry *ll_add_32(struct ll_entry **head,int vaddr,u_int reg32,v
   new_entry->start=start;
   new_entry->copy=copy;
   new_entry->length=length;
+  new_entry->page_sum=0;
   new_entry->next=*head;
   *head=new_entry;
   return new_entry;
@@ -2403,14 +2723,14 @@ static void ll_remove_matching_addrs(struct ll_entry **head,intptr_t addr,int sh
         u_int* ptr=(u_int*)(*cur)->copy;
         ptr[length>>2]--;
         if(ptr[length>>2]==0){
-          free(ptr);
+          arena_free(ptr);
           copy_size-=length+4;
         }
       }
       inv_debug("EXP: Remove pointer to %x (%x)\n",(intptr_t)(*cur)->addr,(*cur)->vaddr);
       remove_hash((*cur)->vaddr);
       next=(*cur)->next;
-      free(*cur);
+      arena_free(*cur);
       *cur=next;
     }
     else
@@ -2434,17 +2754,43 @@ static void ll_clear(struct ll_entry **head)
         u_int* ptr=(u_int*)cur->copy;
         ptr[length>>2]--;
         if(ptr[length>>2]==0){
-          free(ptr);
+          arena_free(ptr);
           copy_size-=length+4;
         }
       }
       next=cur->next;
-      free(cur);
+      arena_free(cur);
       cur=next;
     }
   }
 }
 
+// Remove the dirty entries of the block starting at 'start'
+static void ll_remove_matching_start(struct ll_entry **head,u_int start)
+{
+  struct ll_entry **cur=head;
+  struct ll_entry *next;
+  while(*cur) {
+    if((*cur)->start==start) {
+      u_int length=(*cur)->length;
+      u_int* ptr=(u_int*)(*cur)->copy;
+      ptr[length>>2]--;
+      if(ptr[length>>2]==0){
+        arena_free(ptr);
+        copy_size-=length+4;
+      }
+      remove_hash((*cur)->vaddr);
+      next=(*cur)->next;
+      arena_free(*cur);
+      *cur=next;
+    }
+    else
+    {
+      cur=&((*cur)->next);
+    }
+  }
+}
+
 // Dereference the pointers and remove if it matches
 static void ll_kill_pointers(struct ll_entry *head,intptr_t addr,int shift)
 {
@@ -2552,32 +2898,27 @@ void *dynamic_linker(void * src, u_int vaddr)
   }
 #endif
 
-  struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[0]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
-  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[1]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  void *ht_addr=ht_lookup(vaddr);
+  dispatch_stats.lookups++;
+  if(ht_addr) return (void *)(((intptr_t)ht_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  dispatch_stats.ht_misses++;
 
 #ifdef DISABLE_BLOCK_LINKING
   head=get_clean(r4300,vaddr,~0);
   if(head!=NULL){
-    ht_bin[1]=ht_bin[0];
-    ht_bin[0]=head;
+    ht_insert(vaddr,head);
     return (void*)(((intptr_t)head->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 #endif
 
   head=get_dirty(r4300,vaddr,~0);
   if(head!=NULL){
-    if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-      ht_bin[0]=head; // Replace existing entry
-    }
-    else
-    {
-      ht_bin[1]=ht_bin[0];
-      ht_bin[0]=head;
-    }
+    ht_insert(vaddr,head);
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  dispatch_stats.compiles++;
+
   int r=new_recompile_block(vaddr);
   if(r==0) return dynamic_linker(src,vaddr);
   // Execute in unmapped page, generate pagefault execption
@@ -2610,32 +2951,27 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
   }
 #endif
 
-  struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[0]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
-  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[1]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  void *ht_addr=ht_lookup(vaddr);
+  dispatch_stats.lookups++;
+  if(ht_addr) return (void *)(((intptr_t)ht_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  dispatch_stats.ht_misses++;
 
 #ifdef DISABLE_BLOCK_LINKING
   head=get_clean(r4300,vaddr,~0);
   if(head!=NULL){
-    ht_bin[1]=ht_bin[0];
-    ht_bin[0]=head;
+    ht_insert(vaddr,head);
     return (void*)(((intptr_t)head->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 #endif
 
   head=get_dirty(r4300,vaddr,~0);
   if(head!=NULL){
-    if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-      ht_bin[0]=head; // Replace existing entry
-    }
-    else
-    {
-      ht_bin[1]=ht_bin[0];
-      ht_bin[0]=head;
-    }
+    ht_insert(vaddr,head);
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  dispatch_stats.compiles++;
+
   int r=new_recompile_block((vaddr&0xFFFFFFF8)+1);
   if(r==0) return dynamic_linker_ds(src,vaddr);
   // Execute in unmapped page, generate pagefault execption
@@ -2652,28 +2988,20 @@ void *get_addr(u_int vaddr)
 {
   struct r4300_core* r4300 = &g_dev.r4300;
   struct ll_entry *head;
-  struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
 
   head=get_clean(r4300,vaddr,~0);
   if(head!=NULL){
-    ht_bin[1]=ht_bin[0];
-    ht_bin[0]=head;
+    ht_insert(vaddr,head);
     return (void*)(((intptr_t)head->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
   head=get_dirty(r4300,vaddr,~0);
   if(head!=NULL){
-    if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-      ht_bin[0]=head; // Replace existing entry
-    }
-    else
-    {
-      ht_bin[1]=ht_bin[0];
-      ht_bin[0]=head;
-    }
+    ht_insert(vaddr,head);
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  dispatch_stats.compiles++;
   int r=new_recompile_block(vaddr);
   if(r==0) return get_addr(vaddr);
   // Execute in unmapped page, generate pagefault execption
@@ -2687,44 +3015,35 @@ void *get_addr(u_int vaddr)
 // Look up address in hash table first
 void *get_addr_ht(u_int vaddr)
 {
-  struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[0]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
-  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[1]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  void *ht_addr=ht_lookup(vaddr);
+  dispatch_stats.lookups++;
+  if(ht_addr) return (void *)(((intptr_t)ht_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  dispatch_stats.ht_misses++;
   return get_addr(vaddr);
 }
 
 void *get_addr_32(u_int vaddr,u_int flags)
 {
-  struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[0]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
-  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[1]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  void *ht_addr=ht_lookup(vaddr);
+  dispatch_stats.lookups++;
+  if(ht_addr) return (void *)(((intptr_t)ht_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  dispatch_stats.ht_misses++;
 
   struct r4300_core* r4300 = &g_dev.r4300;
   struct ll_entry *head;
   head=get_clean(r4300,vaddr,flags);
   if(head!=NULL){
-    if(head->reg32==0) {
-      if(ht_bin[0]==NULL) {
-        ht_bin[0]=head;
-      }else if(ht_bin[1]==NULL) {
-        ht_bin[1]=head;
-      }
-    }
+    if(head->reg32==0) ht_insert_low(vaddr,head);
     return (void*)(((intptr_t)head->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
   head=get_dirty(r4300,vaddr,flags);
   if(head!=NULL){
-     if(head->reg32==0) {
-      if(ht_bin[0]==NULL) {
-        ht_bin[0]=head;
-      }else if(ht_bin[1]==NULL) {
-        ht_bin[1]=head;
-      }
-     }
+    if(head->reg32==0) ht_insert_low(vaddr,head);
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  dispatch_stats.compiles++;
   int r=new_recompile_block(vaddr);
   if(r==0) return get_addr(vaddr);
   // Execute in unmapped page, generate pagefault execption
@@ -2739,15 +3058,14 @@ void *get_addr_32(u_int vaddr,u_int flags)
 // but don't return addresses which are about to expire from the cache
 static void *check_addr(u_int vaddr)
 {
-  struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  struct ht_slot *slot=ht_bucket(vaddr)->slot;
+  int n;
 
-  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-    if((((uintptr_t)ht_bin[0]->addr-MAX_OUTPUT_BLOCK_SIZE-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
-      if(ht_bin[0]->addr==ht_bin[0]->clean_addr) return ht_bin[0]->addr; //jump_in
-  }
-  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) {
-    if((((uintptr_t)ht_bin[1]->addr-MAX_OUTPUT_BLOCK_SIZE-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
-      if(ht_bin[1]->addr==ht_bin[1]->clean_addr) return ht_bin[1]->addr; //jump_in
+  for(n=0;n<HT_WAYS;n++) {
+    if(slot[n].addr&&slot[n].vaddr==vaddr) {
+      if((((uintptr_t)slot[n].addr-MAX_OUTPUT_BLOCK_SIZE-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+        if(slot[n].clean) return slot[n].addr; //jump_in
+    }
   }
 
   struct r4300_core* r4300 = &g_dev.r4300;
@@ -2755,23 +3073,9 @@ static void *check_addr(u_int vaddr)
   head=get_clean(r4300,vaddr,~0);
   if(head!=NULL){
     if((((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
-      // Update existing entry with current address
-      if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-        ht_bin[0]=head;
-        return head->addr;
-      }
-      if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) {
-        ht_bin[1]=head;
-        return head->addr;
-      }
-      // Insert into hash table with low priority.
-      // Don't evict existing entries, as they are probably
-      // addresses that are being accessed frequently.
-      if(ht_bin[0]==NULL) {
-        ht_bin[0]=head;
-      }else if(ht_bin[1]==NULL) {
-        ht_bin[1]=head;
-      }
+      // Update existing entry with current address, or insert
+      // into hash table with low priority.
+      ht_insert_low(vaddr,head);
       return head->addr;
     }
   }
@@ -2787,9 +3091,10 @@ static void invalidate_page(u_int page)
   jump_in[page]=0;
   while(head!=NULL) {
     inv_debug("INVALIDATE: %x\n",head->vaddr);
+    if(compile_stats&&head->vaddr==head->start) compile_stats_invalidated(head->start);
     remove_hash(head->vaddr);
     next=head->next;
-    free(head);
+    arena_free(head);
     head=next;
   }
   head=jump_out[page];
@@ -2804,11 +3109,44 @@ static void invalidate_page(u_int page)
       (void)host_addr;
     #endif
     next=head->next;
-    free(head);
+    arena_free(head);
     head=next;
   }
 }
 
+// Discard the blocks which folded a load from ROM.  verify_dirty only
+// compares the code, so their dirty entries have to go as well.
+static void invalidate_rom_deps(void)
+{
+  struct ll_entry *head;
+  struct ll_entry *next;
+  u_int first,last,p;
+  if(!rom_deps) return;
+  head=rom_deps;
+  rom_deps=0;
+  while(head!=NULL) {
+    inv_debug("INVALIDATE: const fold %x\n",head->start);
+    first=(head->start^0x80000000)>>12;
+    last=((head->start+head->length-1)^0x80000000)>>12;
+    for(p=first;p<=last;p++) {
+      invalidate_page(p);
+      ll_remove_matching_start(jump_dirty+p,head->start);
+    }
+    next=head->next;
+    arena_free(head);
+    head=next;
+  }
+  #ifdef USE_MINI_HT
+  memset(g_dev.r4300.new_dynarec_hot_state.mini_ht,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.mini_ht));
+  #endif
+  #ifdef USE_RETURN_STACK
+  memset(g_dev.r4300.new_dynarec_hot_state.ras,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.ras));
+  #endif
+  #if NEW_DYNAREC >= NEW_DYNAREC_ARM
+    do_clear_cache();
+  #endif
+}
+
 void invalidate_block(u_int block)
 {
   u_int page;
@@ -2819,38 +3157,47 @@ void invalidate_block(u_int block)
   u_int first,last;
   first=last=page;
   struct ll_entry *head;
-  head=jump_in[page];
   u_int start,end;
+  int n;
 
-  while(head!=NULL) {
-    if((signed int)head->vaddr>=0x80000000&&(signed int)head->vaddr<VADDR_MAX) {
-      assert(page<MAX_PAGE);
-      start=(head->start^0x80000000)>>12;
-      end=((head->start+head->length-1)^0x80000000)>>12;
-      assert(start<MAX_PAGE&&end<MAX_PAGE);
-    }
-    if((signed int)head->vaddr>=(signed int)0xC0000000) {
-      assert(page<MAX_PAGE);
-      assert(g_dev.r4300.new_dynarec_hot_state.memory_map[head->vaddr>>12]!=(uintptr_t)-1);
-      u_int paddr=head->vaddr+(g_dev.r4300.new_dynarec_hot_state.memory_map[head->vaddr>>12]<<2)-(uintptr_t)g_dev.rdram.dram;
-      start=(paddr-(head->vaddr-head->start))>>12;
-      end=(paddr+((head->start+head->length)-head->vaddr)-1)>>12;
-      assert(start<MAX_PAGE&&end<MAX_PAGE);
-    }
-    else if((signed int)head->vaddr>=(signed int)0x80800000) {
-      assert(page>=MAX_PAGE);
-      start=(head->start^0x80000000)>>12;
-      end=((head->start+head->length-1)^0x80000000)>>12;
-      assert(start>=MAX_PAGE&&end>=MAX_PAGE);
-      start=MAX_PAGE+(start&(MAX_PAGE-1));
-      end=MAX_PAGE+(end&(MAX_PAGE-1));
-    }
-
-    if((start<=page)&&(end>=page)) {
-      if(start<first) first=start;
-      if(end>last) last=end;
+  // jump_span holds the blocks which run into this page without
+  // having an entry point in it
+  for(n=0;n<2;n++) {
+    head=n?jump_span[page]:jump_in[page];
+    while(head!=NULL) {
+      if((signed int)head->vaddr>=0x80000000&&(signed int)head->vaddr<VADDR_MAX) {
+        assert(page<MAX_PAGE);
+        start=(head->start^0x80000000)>>12;
+        end=((head->start+head->length-1)^0x80000000)>>12;
+        assert(start<MAX_PAGE&&end<MAX_PAGE);
+      }
+      if((signed int)head->vaddr>=(signed int)0xC0000000) {
+        assert(page<MAX_PAGE);
+        if(n&&(intptr_t)g_dev.r4300.new_dynarec_hot_state.memory_map[head->vaddr>>12]<0) {
+          head=head->next; // Unmapped since, the block is gone
+          continue;
+        }
+        assert(g_dev.r4300.new_dynarec_hot_state.memory_map[head->vaddr>>12]!=(uintptr_t)-1);
+        u_int paddr=head->vaddr+(g_dev.r4300.new_dynarec_hot_state.memory_map[head->vaddr>>12]<<2)-(uintptr_t)g_dev.rdram.dram;
+        start=(paddr-(head->vaddr-head->start))>>12;
+        end=(paddr+((head->start+head->length)-head->vaddr)-1)>>12;
+        assert(start<MAX_PAGE&&end<MAX_PAGE);
+      }
+      else if((signed int)head->vaddr>=(signed int)0x80800000) {
+        assert(page>=MAX_PAGE);
+        start=(head->start^0x80000000)>>12;
+        end=((head->start+head->length-1)^0x80000000)>>12;
+        assert(start>=MAX_PAGE&&end>=MAX_PAGE);
+        start=MAX_PAGE+(start&(MAX_PAGE-1));
+        end=MAX_PAGE+(end&(MAX_PAGE-1));
+      }
+
+      if((start<=page)&&(end>=page)) {
+        if(start<first) first=start;
+        if(end>last) last=end;
+      }
+      head=head->next;
     }
-    head=head->next;
   }
 
   invalidate_page(page);
@@ -2861,7 +3208,7 @@ void invalidate_block(u_int block)
     invalidate_page(first);
     first++;
   }
-  for(first=page+1;first<last;first++) {
+  for(first=page+1;first<=last;first++) {
     invalidate_page(first);
   }
   #if NEW_DYNAREC >= NEW_DYNAREC_ARM
@@ -2882,6 +3229,9 @@ void invalidate_block(u_int block)
   #ifdef USE_MINI_HT
   memset(g_dev.r4300.new_dynarec_hot_state.mini_ht,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.mini_ht));
   #endif
+  #ifdef USE_RETURN_STACK
+  memset(g_dev.r4300.new_dynarec_hot_state.ras,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.ras));
+  #endif
 }
 
 // This is called when loading a save state.
@@ -2891,6 +3241,7 @@ static void invalidate_all_pages(void)
   u_int page;
   for(page=0;page<4096;page++)
     invalidate_page(page);
+  invalidate_rom_deps();
   for(page=0;page<1048576;page++)
   {
     if(!g_dev.r4300.cached_interp.invalid_code[page]) {
@@ -2904,6 +3255,9 @@ static void invalidate_all_pages(void)
   #ifdef USE_MINI_HT
   memset(g_dev.r4300.new_dynarec_hot_state.mini_ht,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.mini_ht));
   #endif
+  #ifdef USE_RETURN_STACK
+  memset(g_dev.r4300.new_dynarec_hot_state.ras,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.ras));
+  #endif
   // TLB
   for(page=0;page<0x100000;page++) {
     if(g_dev.r4300.cp0.tlb.LUT_r[page]) {
@@ -2929,6 +3283,10 @@ void invalidate_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t addre
     }
     else
     {
+        // Writes to ROM make reads return the written value for a while
+        if((address&0x1fffffff)>=MM_CART_ROM&&(address&0x1fffffff)<MM_PIF_MEM)
+            invalidate_rom_deps();
+
         begin = address >> 12;
         end = (address+size-1) >> 12;
 
@@ -2940,6 +3298,131 @@ void invalidate_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t addre
     }
 }
 
+// Like invalidate_cached_code_new_dynarec, but the dirty copies of the
+// blocks entered in the range go too so get_dirty can't bring them back.
+void discard_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t address, size_t size)
+{
+  struct ll_entry *head;
+  u_int block,vpage;
+  invalidate_cached_code_new_dynarec(r4300,address,size);
+  if(size==0) {
+    for(vpage=0;vpage<4096;vpage++) ll_clear(jump_dirty+vpage);
+    return;
+  }
+  for(block=address>>12;block<=(address+size-1)>>12;block++) {
+    vpage=block^0x80000;
+    if(vpage>262143&&r4300->cp0.tlb.LUT_r[block]) vpage&=(MAX_PAGE-1);
+    if(vpage>MAX_PAGE) vpage=MAX_PAGE+(vpage&(MAX_PAGE-1));
+    head=jump_dirty[vpage];
+    while(head!=NULL) {
+      if(head->vaddr-address<size) {
+        ll_remove_matching_start(jump_dirty+vpage,head->start);
+        head=jump_dirty[vpage];
+      }
+      else head=head->next;
+    }
+  }
+}
+
+// Move every dirty block of an RDRAM page whose checksum matches the
+// page as it is now back to the clean list, and trap writes again.
+static void restore_page(u_int page)
+{
+  struct ll_entry *head;
+  struct ll_entry *clean;
+  uint64_t sum=0;
+  int restored=0;
+  if(!g_dev.r4300.cached_interp.invalid_code[0x80000+page]) return; // Code is still valid
+  for(head=jump_dirty[page];head!=NULL;head=head->next) {
+    if(!head->page_sum) continue;
+    if(sum==0) sum=rdram_page_sum(page);
+    if(head->page_sum!=sum) continue;
+    // Don't restore blocks which are about to expire from the cache
+    if((((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))<=0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) continue;
+    if((((uintptr_t)head->clean_addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))<=0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) continue;
+    for(clean=jump_in[page];clean!=NULL;clean=clean->next)
+      if(clean->vaddr==head->vaddr&&clean->reg32==head->reg32) break;
+    if(clean!=NULL) continue; // Same code compiled twice
+    inv_debug("INV: Restored page %d %x (%x/%x)\n",page,head->vaddr,(intptr_t)head->addr,(intptr_t)head->clean_addr);
+    clean=ll_add_32(jump_in+page,head->vaddr,head->reg32,head->clean_addr,head->clean_addr,head->start,head->copy,head->length);
+    if(!head->reg32) ht_replace(head->vaddr,clean);
+    restored=1;
+  }
+  if(restored) {
+    g_dev.r4300.cached_interp.invalid_code[0x80000+page]=0;
+    g_dev.r4300.new_dynarec_hot_state.memory_map[0x80000+page]|=WRITE_PROTECT;
+  }
+}
+
+// Called once a DMA has written [address,address+size)
+void restore_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t address, size_t size)
+{
+    u_int page;
+    u_int first;
+    u_int last;
+
+    if (size == 0 || address < 0x80000000 || address >= VADDR_MAX)
+        return;
+
+    first = (address ^ 0x80000000) >> 12;
+    last = ((address + size - 1) ^ 0x80000000) >> 12;
+    if (last >= MAX_PAGE)
+        last = MAX_PAGE - 1;
+
+    for (page = first; page <= last; ++page) {
+        if (jump_dirty[page] != NULL)
+            restore_page(page);
+    }
+}
+
+static void dump_block_list(FILE *f,const char *kind,struct ll_entry **list,int verify)
+{
+  struct ll_entry *head;
+  u_int page;
+  for(page=0;page<4096;page++) {
+    for(head=list[page];head!=NULL;head=head->next) {
+      fprintf(f,"%s page=%u vaddr=%08x start=%08x end=%08x host=+%x",kind,page,
+              head->vaddr,head->start,head->start+head->length-1,
+              (u_int)((uintptr_t)head->addr-(uintptr_t)base_addr));
+      if(verify) fprintf(f," %s",verify_dirty(head)?"modified":"unmodified");
+      fprintf(f,"\n");
+    }
+  }
+}
+
+// Write the block lists to a text file, one entry per line.
+// Called on the emulation thread between blocks (DynarecApplyRequests).
+int new_dynarec_dump_code_cache(const char* path)
+{
+  FILE *f;
+  u_int page,n;
+  f=fopen(path,"w");
+  if(f==NULL) {
+    DebugMessage(M64MSG_ERROR, "Couldn't open %s", path);
+    return -1;
+  }
+  fprintf(f,"# code cache size=%x out=+%x expirep=%x dirty_entries=%u copy_size=%u\n",
+          1<<TARGET_SIZE_2,(u_int)((uintptr_t)out-(uintptr_t)base_addr),expirep,
+          dirty_entry_count,copy_size);
+  dump_block_list(f,"live",jump_in,0);
+  dump_block_list(f,"dirty",jump_dirty,1);
+  for(page=0;page<4096;page++) {
+    if(restore_candidate[page>>3]&(1<<(page&7))) {
+      if(page<MAX_PAGE) fprintf(f,"restore_candidate page=%u vaddr=%08x\n",page,0x80000000+(page<<12));
+      else fprintf(f,"restore_candidate page=%u\n",page);
+    }
+  }
+  if(compile_stats) {
+    for(n=0;n<COMPILE_STATS_SIZE;n++) {
+      if(compile_stats[n].compiles>1||compile_stats[n].invalidations>0)
+        fprintf(f,"recompiled start=%08x compiles=%u invalidations=%u\n",compile_stats[n].start,
+                compile_stats[n].compiles,compile_stats[n].invalidations);
+    }
+  }
+  fclose(f);
+  return 0;
+}
+
 // If a code block was found to be unmodified (bit was set in
 // restore_candidate) and it remains unmodified (bit is clear
 // in invalid_code) then move the entries for that 4K page from
@@ -2947,13 +3430,16 @@ void invalidate_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t addre
 void clean_blocks(u_int page)
 {
   struct ll_entry *head;
+  uint64_t sum=0;
   inv_debug("INV: clean_blocks page=%d\n",page);
   head=jump_dirty[page];
   while(head!=NULL) {
     if(!g_dev.r4300.cached_interp.invalid_code[head->vaddr>>12]) {
       // Don't restore blocks which are about to expire from the cache
       if((((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
-        if(verify_dirty(head)==0) {
+        // One checksum of the page covers every block compiled from it
+        if(head->page_sum&&sum==0) sum=rdram_page_sum(page);
+        if((head->page_sum&&head->page_sum==sum)||verify_dirty(head)==0) {
           //DebugMessage(M64MSG_VERBOSE, "Possibly Restore %x (%x)",head->vaddr, (intptr_t)head->addr);
           u_int i,j;
           u_int inv=0;
@@ -2988,14 +3474,8 @@ void clean_blocks(u_int page)
               //DebugMessage(M64MSG_VERBOSE, "page=%x, addr=%x",page,head->vaddr);
               //assert(head->vaddr>>12==(page|0x80000));
               struct ll_entry *clean_head=ll_add_32(jump_in+ppage,head->vaddr,head->reg32,head->clean_addr,head->clean_addr,head->start,head->copy,head->length);
-              struct ll_entry **ht_bin=hash_table[((head->vaddr>>16)^head->vaddr)&0xFFFF];
               if(!head->reg32) {
-                if(ht_bin[0]&&ht_bin[0]->vaddr==head->vaddr) {
-                  ht_bin[0]=clean_head; // Replace existing entry
-                }
-                if(ht_bin[1]&&ht_bin[1]->vaddr==head->vaddr) {
-                  ht_bin[1]=clean_head; // Replace existing entry
-                }
+                ht_replace(head->vaddr,clean_head); // Replace existing entry
               }
             }
           }
@@ -4071,7 +4551,7 @@ static void load_consts(signed char pre[],signed char regmap[],int is32,int i)
   for(hr=0;hr<HOST_REGS;hr++) {
     if(hr!=EXCLUDE_REG&&regmap[hr]>=0) {
       //if(entry[hr]!=regmap[hr]) {
-      if(i==0||!((regs[i-1].isconst>>hr)&1)||pre[hr]!=regmap[hr]||bt[i]) {
+      if(i==0||!((regs[i-1].isconst>>hr)&1)||pre[hr]!=regmap[hr]||bt[i]||hooked[i]) {
         if(((regs[i].isconst>>hr)&1)&&regmap[hr]<64&&regmap[hr]>0) {
           int value;
           if(get_final_value(hr,i,&value)) {
@@ -4090,7 +4570,7 @@ static void load_consts(signed char pre[],signed char regmap[],int is32,int i)
   for(hr=0;hr<HOST_REGS;hr++) {
     if(hr!=EXCLUDE_REG&&regmap[hr]>=0) {
       //if(entry[hr]!=regmap[hr]) {
-      if(i==0||!((regs[i-1].isconst>>hr)&1)||pre[hr]!=regmap[hr]||bt[i]) {
+      if(i==0||!((regs[i-1].isconst>>hr)&1)||pre[hr]!=regmap[hr]||bt[i]||hooked[i]) {
         if(((regs[i].isconst>>hr)&1)&&regmap[hr]>64) {
           if((is32>>(regmap[hr]&63))&1) {
             int lr=get_reg(regmap,regmap[hr]-64);
@@ -6102,6 +6582,53 @@ void shift_assemble(int i,struct regstat *i_regs)
 }
 #endif
 
+// Whether a load from 'addr' reads a constant the block may embed
+static int const_fold_rom(u_int addr)
+{
+  if(!const_fold_ok) return 0;
+  if((addr>>29)!=4&&(addr>>29)!=5) return 0; // kseg0/kseg1
+  // Cart ROM only changes what reads return while a write is pending
+  if(mem_get_handler(&g_dev.mem,addr&0x1fffffff)->read32!=read_cart_rom) return 0;
+  if(rom_address(addr)+8>g_dev.cart.cart_rom.rom_size) return 0;
+  if(g_dev.pi.regs[PI_STATUS_REG]&PI_STATUS_IO_BUSY) return 0;
+  // Mods patch the ROM without invalidating anything
+  if(ModLoaderHooksActive()) return 0;
+  const_folded=1;
+  return 1;
+}
+
+// Replace a load from a constant address by the value it reads now
+static int const_fold_load(int i,u_int addr,signed char th,signed char tl)
+{
+  const u_char *mem;
+  u_int size=1;
+  if(opcode[i]==0x21||opcode[i]==0x25) size=2; // LH/LHU
+  if(opcode[i]==0x23||opcode[i]==0x27) size=4; // LW/LWU
+  if(opcode[i]==0x37) size=8; // LD
+  if(addr&(size-1)) return 0; // Leave the address error to the normal path
+  if(!const_fold_rom(addr)) return 0;
+  mem=g_dev.cart.cart_rom.rom+(addr&0x03ffffff);
+  mem-=addr&3; // Memory is stored as native words
+  assem_debug("const fold: %x",addr);
+  switch(opcode[i]) {
+    case 0x20: emit_movimm((signed char)mem[(addr&3)^3],tl); break; // LB
+    case 0x24: emit_movimm(mem[(addr&3)^3],tl); break; // LBU
+    case 0x21: emit_movimm(*(const signed short *)(mem+((addr&2)^2)),tl); break; // LH
+    case 0x25: emit_movimm(*(const u_short *)(mem+((addr&2)^2)),tl); break; // LHU
+    case 0x23: emit_movimm(*(const u_int *)mem,tl); break; // LW
+    case 0x27: // LWU
+      assert(th>=0);
+      emit_movimm(*(const u_int *)mem,tl);
+      emit_zeroreg(th);
+      break;
+    case 0x37: // LD
+      if(th>=0) emit_movimm(*(const u_int *)mem,th);
+      emit_movimm(*(const u_int *)(mem+4),tl);
+      break;
+  }
+  return 1;
+}
+
 static void load_assemble(int i,struct regstat *i_regs)
 {
   signed char s,th,tl,addr,map=-1,cache=-1;
@@ -6143,6 +6670,7 @@ static void load_assemble(int i,struct regstat *i_regs)
   }
 
 #ifndef INTERPRET_LOAD
+  if(c&&!dummy&&const_fold_load(i,constmap[i][s]+offset,th,tl)) return;
   if(!using_tlb) {
     if(!c) {
 //#define R29_HACK 1
@@ -6936,6 +7464,48 @@ static void syscall_assemble(int i,struct regstat *i_regs)
   emit_jmp((intptr_t)jump_syscall);
 }
 
+// Call to func(pc,count,arg3,arg4) ahead of instruction i, for breakpoint
+// and lockstep checks.  The callee sees (and the debugger may edit) the
+// guest registers in memory, so everything is written back before the call
+// and reloaded after it.  Hooks only sit at block entries, branch targets
+// and hooked[] instructions, where constant propagation starts over.
+static void hook_assemble(int i,intptr_t func,u_int arg3,u_int arg4)
+{
+  signed char *regmap=regs[i].regmap_entry;
+  int cc=get_reg(regmap,CCREG);
+  load_all_consts(regmap,regs[i].was32,regs[i].wasdirty,regs[i].wasconst,i);
+  wb_dirtys(regmap,regs[i].was32,regs[i].wasdirty);
+  if(cc>=0) emit_storereg(CCREG,cc);
+#if NEW_DYNAREC == NEW_DYNAREC_X86
+  emit_pushimm(arg4);
+  emit_pushimm(arg3);
+  emit_pushimm(CLOCK_DIVIDER*ccadj[i]);
+  emit_pushimm(start+i*4);
+  emit_call(func);
+  emit_addimm(ESP,16,ESP);
+#else
+  emit_movimm(start+i*4,ARG1_REG);
+  emit_movimm(CLOCK_DIVIDER*ccadj[i],ARG2_REG);
+  emit_movimm(arg3,ARG3_REG);
+  emit_movimm(arg4,ARG4_REG);
+  emit_call(func);
+#endif
+  emit_cmpmem_imm((intptr_t)&g_dev.r4300.new_dynarec_hot_state.pending_exception,0);
+  intptr_t jaddr=(intptr_t)out;
+  emit_jeq(0);
+  emit_jmp((intptr_t)&do_interrupt);
+  set_jump_target(jaddr,(intptr_t)out);
+  load_all_regs(regmap);
+  if(cc>=0) emit_loadreg(CCREG,cc);
+}
+
+// GPRs whose values in memory may be stale at an instruction, given its
+// unneeded_reg mask, for lockstep_check.  Bit 0 stands for hi/lo.
+static u_int lockstep_stale(uint64_t unneeded)
+{
+  return ((u_int)unneeded&~1u)|!!(unneeded&((1LL<<HIREG)|(1LL<<LOREG)));
+}
+
 static void ds_assemble(int i,struct regstat *i_regs)
 {
   is_delayslot=1;
@@ -7078,7 +7648,7 @@ static void ujump_assemble(int i,struct regstat *i_regs)
   {
     int return_address=start+i*4+8;
     if(get_reg(branch_regs[i].regmap,31)>0)
-    if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+    if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)ht_bucket(return_address),temp);
   }
   #endif
   ds_assemble(i+1,i_regs);
@@ -7111,12 +7681,12 @@ static void ujump_assemble(int i,struct regstat *i_regs)
         #ifdef REG_PREFETCH
         if(temp>=0)
         {
-          if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+          if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)ht_bucket(return_address),temp);
         }
         #endif
         emit_movimm(return_address,rt); // PC into link register
         #ifdef IMM_PREFETCH
-        emit_prefetch(hash_table[((return_address>>16)^return_address)&0xFFFF]);
+        emit_prefetch(ht_bucket(return_address));
         #endif
       }
     }
@@ -7169,7 +7739,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   {
     if((temp=get_reg(branch_regs[i].regmap,PTEMP))>=0) {
       int return_address=start+i*4+8;
-      if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+      if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)ht_bucket(return_address),temp);
     }
   }
   #endif
@@ -7198,12 +7768,17 @@ static void rjump_assemble(int i,struct regstat *i_regs)
     #ifdef REG_PREFETCH
     if(temp>=0)
     {
-      if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+      if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)ht_bucket(return_address),temp);
     }
     #endif
+    #ifdef USE_RETURN_STACK
+    if(rt1[i]==31&&internal_branch(branch_regs[i].is32,return_address))
+      do_miniht_insert(return_address,rt,HOST_TEMPREG);
+    else
+    #endif
     emit_movimm(return_address,rt); // PC into link register
     #ifdef IMM_PREFETCH
-    emit_prefetch(hash_table[((return_address>>16)^return_address)&0xFFFF]);
+    emit_prefetch(ht_bucket(return_address));
     #endif
   }
   cc=get_reg(branch_regs[i].regmap,CCREG);
@@ -7720,7 +8295,7 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         return_address=start+i*4+8;
         emit_movimm(return_address,rt); // PC into link register
         #ifdef IMM_PREFETCH
-        if(!nevertaken) emit_prefetch(hash_table[((return_address>>16)^return_address)&0xFFFF]);
+        if(!nevertaken) emit_prefetch(ht_bucket(return_address));
         #endif
       }
     }
@@ -8697,6 +9272,11 @@ void new_dynarec_init(void)
 
   assert(((uintptr_t)g_dev.rdram.dram&7)==0); //8 bytes aligned
   out=(u_char *)base_addr;
+  if(compile_stats) {
+    // Block addresses are only meaningful within one session
+    memset(compile_stats,0,COMPILE_STATS_SIZE*sizeof(*compile_stats));
+    compile_stats_count=0;
+  }
 
   g_dev.r4300.new_dynarec_hot_state.pc = &g_dev.r4300.new_dynarec_hot_state.fake_pc;
   g_dev.r4300.new_dynarec_hot_state.fake_pc.f.r.rs = &g_dev.r4300.new_dynarec_hot_state.rs;
@@ -8705,9 +9285,12 @@ void new_dynarec_init(void)
   int n;
   for(n=0x80000;n<0x80800;n++)
     g_dev.r4300.cached_interp.invalid_code[n]=1;
-  for(n=0;n<65536;n++)
-    hash_table[n][0]=hash_table[n][1]=NULL;
+  ht_clear();
   memset(g_dev.r4300.new_dynarec_hot_state.mini_ht,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.mini_ht));
+#ifdef USE_RETURN_STACK
+  memset(g_dev.r4300.new_dynarec_hot_state.ras,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.ras));
+  g_dev.r4300.new_dynarec_hot_state.ras_top=0;
+#endif
   memset(restore_candidate,0,sizeof(restore_candidate));
   copy_size=0;
   expirep=16384; // Expiry pointer, +2 blocks
@@ -8739,7 +9322,11 @@ void new_dynarec_cleanup(void)
   for(n=0;n<4096;n++) ll_clear(jump_in+n);
   for(n=0;n<4096;n++) ll_clear(jump_out+n);
   for(n=0;n<4096;n++) ll_clear(jump_dirty+n);
+  for(n=0;n<4096;n++) ll_clear(jump_span+n);
+  ll_clear(&rom_deps);
   assert(copy_size==0);
+  arena_cleanup();
+  if(compile_log) fflush(compile_log);
 #if !defined(RECOMP_DBG)
   #if defined(WIN32)
     VirtualFree(base_addr, 0, MEM_RELEASE);
@@ -8759,6 +9346,7 @@ int new_recompile_block(int addr)
 #if defined(RECOMPILER_DEBUG) && !defined(RECOMP_DBG)
   recomp_dbg_block(addr);
 #endif
+  uint64_t compile_begin=compile_log?compile_clock_ns():0;
 
   assem_debug("NOTCOMPILED: addr = %x -> %x", (int)addr, (intptr_t)out);
 #if COUNT_NOTCOMPILEDS
@@ -9089,6 +9677,12 @@ int new_recompile_block(int addr)
       case 0x3F: assem_strcpy(insn[i],"SD"); type=STORE; break;
       default: assem_strcpy(insn[i],"???"); type=NI; break;
     }
+    // A function run natively is left like a syscall, SYSCALL_new
+    // runs the replacement (not from a delay slot, that isn't a call)
+    if(r4300_has_native_call(&g_dev.r4300,start+i*4)&&
+       !(i>0&&(itype[i-1]==RJUMP||itype[i-1]==UJUMP||itype[i-1]==CJUMP||itype[i-1]==SJUMP||itype[i-1]==FJUMP))) {
+      assem_strcpy(insn[i],"HLE"); type=SYSCALL;
+    }
     itype[i]=type;
     opcode2[i]=op2;
     /* Get registers/immediates */
@@ -9404,6 +9998,15 @@ int new_recompile_block(int addr)
       }
       current.isconst=0;
     }
+    // The debugger may edit registers at a breakpoint, so nothing stays
+    // folded across the hook
+    hooked[i]=0;
+    #ifdef DBG
+    if(!ds&&r4300_has_exec_breakpoint(&g_dev.r4300,start+i*4)) {
+      hooked[i]=1;
+      current.isconst=0;
+    }
+    #endif
     memcpy(regmap_pre[i],current.regmap,sizeof(current.regmap));
     if(i>1)
     {
@@ -11484,11 +12087,24 @@ int new_recompile_block(int addr)
   #endif
 
   copy=NULL;
-  copy=(char*)malloc((slen*4)+4);
+  copy=(char*)arena_alloc(out,(slen*4)+4);
   assert(copy);
   copy_size+=((slen*4)+4);
   //DebugMessage(M64MSG_VERBOSE, "Currently used memory for copy: %d",copy_size);
 
+  // Folded loads must not be able to observe a write without leaving
+  // the block, so only blocks that never store qualify
+  const_fold_ok=start>=0x80000000&&start<VADDR_MAX;
+  for(i=0;i<slen;i++)
+    if(itype[i]==STORE||itype[i]==STORELR||(itype[i]==C1LS&&(opcode[i]&8))) const_fold_ok=0;
+  const_folded=0;
+
+  // Blocks within one RDRAM page remember what the whole page held, so
+  // they can be restored together when it is reloaded unchanged
+  block_page_sum=0;
+  if(start>=0x80000000&&start<VADDR_MAX&&(start>>12)==((start+slen*4-4)>>12))
+    block_page_sum=rdram_page_sum((start^0x80000000)>>12);
+
   uintptr_t beginning=(uintptr_t)out;
   if((u_int)addr&1) {
     ds=1;
@@ -11530,6 +12146,12 @@ int new_recompile_block(int addr)
       // branch target entry point
       instr_addr[i]=(uintptr_t)out;
       assem_debug("<->");
+      #ifdef DBG
+      if(hooked[i])
+        hook_assemble(i,(intptr_t)BREAKPOINT_new,0,0);
+      #endif
+      if(g_dev.r4300.lockstep!=NULL&&(i==0||bt[i]))
+        hook_assemble(i,(intptr_t)LOCKSTEP_new,lockstep_stale(unneeded_reg[i]),lockstep_stale(unneeded_reg_upper[i]));
       // load regs
       if(regs[i].regmap_entry[HOST_CCREG]==CCREG&&regs[i].regmap[HOST_CCREG]!=CCREG)
         wb_register(CCREG,regs[i].regmap_entry,regs[i].wasdirty,regs[i].was32);
@@ -11753,21 +12375,16 @@ int new_recompile_block(int addr)
           assem_debug("%8x (%d) <- %8x",instr_addr[i],i,start+i*4);
           assem_debug("jump_in: %x",start+i*4);
           struct ll_entry *head=ll_add(jump_dirty+vpage,vaddr,(void *)out,NULL,start,copy,slen*4);
+          head->page_sum=block_page_sum;
           dirty_entry_count++;
           intptr_t entry_point=do_dirty_stub(i,head);
           head->clean_addr=(void*)entry_point;
           head=ll_add(jump_in+page,vaddr,(void *)entry_point,(void *)entry_point,start,copy,slen*4);
           // If there was an existing entry in the hash table,
-          // replace it with the new address.
-          // Don't add new entries.  We'll insert the
-          // ones that actually get used in check_addr().
-          struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-          if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-            ht_bin[0]=head;
-          }
-          if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) {
-            ht_bin[1]=head;
-          }
+          // replace it with the new address, otherwise take a free
+          // slot.  Don't evict anything for entry points that may
+          // never be used.
+          ht_insert_low(vaddr,head);
         }
         else
         {
@@ -11783,6 +12400,7 @@ int new_recompile_block(int addr)
           //  emit_jmp(instr_addr[i]);
           //struct ll_entry *head=ll_add_32(jump_dirty+vpage,vaddr,r,(void *)entry_point,NULL,start,copy,slen*4);
           struct ll_entry *head=ll_add_32(jump_dirty+vpage,vaddr,r,(void *)out,NULL,start,copy,slen*4);
+          head->page_sum=block_page_sum;
           dirty_entry_count++;
           intptr_t entry_point=do_dirty_stub(i,head);
           head->clean_addr=(void*)entry_point;
@@ -11791,6 +12409,16 @@ int new_recompile_block(int addr)
       }
     }
   }
+  // Register the block on every other page it covers, so that a write
+  // there finds it even if it has no entry point in that page
+  for(i=((start+slen*4-4)>>12)-(start>>12);i>0;i--)
+  {
+    u_int vaddr=start+i*4096;
+    u_int page=(0x80000000^vaddr)>>12;
+    if(page>262143&&g_dev.r4300.cp0.tlb.LUT_r[vaddr>>12]) page=(g_dev.r4300.cp0.tlb.LUT_r[vaddr>>12]^0x80000000)>>12;
+    if(page>MAX_PAGE) page=MAX_PAGE+(page&(MAX_PAGE-1));
+    (void)ll_add(jump_span+page,start,(void *)beginning,(void *)beginning,start,NULL,slen*4);
+  }
   // Write out the literal pool if necessary
   literal_pool(0);
   #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
@@ -11798,6 +12426,7 @@ int new_recompile_block(int addr)
   if(((uintptr_t)out)&7) emit_addnop(13);
   #endif
   assert((uintptr_t)out-beginning<MAX_OUTPUT_BLOCK_SIZE);
+  u_int host_size=(u_int)((uintptr_t)out-beginning);
   memcpy(copy,(char*)source,slen*4);
   u_int *ptr=(u_int*)copy;
   ptr[slen]=dirty_entry_count;
@@ -11813,6 +12442,10 @@ int new_recompile_block(int addr)
   if(out > (u_char *)((u_char *)base_addr+(1<<TARGET_SIZE_2)-MAX_OUTPUT_BLOCK_SIZE-JUMP_TABLE_SIZE))
     out=(u_char *)base_addr;
 
+  // Discard this block on writes to the ROM it folded loads from
+  if(const_folded)
+    (void)ll_add(&rom_deps,start,(void *)beginning,(void *)beginning,start,NULL,slen*4);
+
   // Trap writes to any of the pages we compiled
   for(i=start>>12;i<=(int)((start+slen*4-4)>>12);i++) {
     g_dev.r4300.cached_interp.invalid_code[i]=0;
@@ -11835,6 +12468,11 @@ int new_recompile_block(int addr)
     int shift=TARGET_SIZE_2-3; // Divide into 8 blocks
     intptr_t base=(intptr_t)base_addr+((expirep>>13)<<shift); // Base address of this block
     inv_debug("EXP: Phase %d\n",expirep);
+    #ifdef USE_RETURN_STACK
+    // The return stack may point into the region about to be reused
+    if((expirep&8191)==0)
+      memset(g_dev.r4300.new_dynarec_hot_state.ras,-1,sizeof(g_dev.r4300.new_dynarec_hot_state.ras));
+    #endif
     switch((expirep>>11)&3)
     {
       case 0:
@@ -11843,6 +12481,10 @@ int new_recompile_block(int addr)
         ll_remove_matching_addrs(jump_dirty+(expirep&(MAX_PAGE-1)),base,shift);
         ll_remove_matching_addrs(jump_in+MAX_PAGE+(expirep&(MAX_PAGE-1)),base,shift);
         ll_remove_matching_addrs(jump_dirty+MAX_PAGE+(expirep&(MAX_PAGE-1)),base,shift);
+        ll_remove_matching_addrs(jump_span+(expirep&(MAX_PAGE-1)),base,shift);
+        ll_remove_matching_addrs(jump_span+MAX_PAGE+(expirep&(MAX_PAGE-1)),base,shift);
+        if((expirep&(MAX_PAGE-1))==0)
+          ll_remove_matching_addrs(&rom_deps,base,shift);
         break;
       case 1:
         // Clear pointers
@@ -11851,18 +12493,14 @@ int new_recompile_block(int addr)
         break;
       case 2:
         // Clear hash table
-        for(i=0;i<32;i++) {
-          struct ll_entry **ht_bin=hash_table[((expirep&(MAX_PAGE-1))<<5)+i];
-          if(ht_bin[1]&&((((uintptr_t)ht_bin[1]->addr-(uintptr_t)base_addr)>>shift)==((base-(uintptr_t)base_addr)>>shift) ||
-             (((uintptr_t)ht_bin[1]->addr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(uintptr_t)base_addr)>>shift))) {
-            inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[1]->vaddr,ht_bin[1]->addr);
-            ht_bin[1]=NULL;
-          }
-          if(ht_bin[0]&&((((uintptr_t)ht_bin[0]->addr-(uintptr_t)base_addr)>>shift)==((base-(uintptr_t)base_addr)>>shift) ||
-             (((uintptr_t)ht_bin[0]->addr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(uintptr_t)base_addr)>>shift))) {
-            inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[0]->vaddr,ht_bin[0]->addr);
-            ht_bin[0]=ht_bin[1];
-            ht_bin[1]=NULL;
+        for(i=0;i<HT_SETS/MAX_PAGE;i++) {
+          struct ht_slot *slot=hash_table[(expirep&(MAX_PAGE-1))*(HT_SETS/MAX_PAGE)+i].slot;
+          for(j=0;j<HT_WAYS;j++) {
+            if(slot[j].addr&&((((uintptr_t)slot[j].addr-(uintptr_t)base_addr)>>shift)==((base-(uintptr_t)base_addr)>>shift) ||
+               (((uintptr_t)slot[j].addr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(uintptr_t)base_addr)>>shift))) {
+              inv_debug("EXP: Remove hash %x -> %x\n",slot[j].vaddr,slot[j].addr);
+              slot[j].addr=NULL;
+            }
           }
         }
         break;
@@ -11878,5 +12516,7 @@ int new_recompile_block(int addr)
     }
     expirep=(expirep+1)&65535;
   }
+  if(compile_log)
+    compile_log_block(start,slen*4,host_size,compile_clock_ns()-compile_begin);
   return 0;
 }
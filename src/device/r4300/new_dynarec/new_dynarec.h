@@ -80,18 +80,40 @@ struct new_dynarec_hot_state
     int64_t rd;
     intptr_t ram_offset;
     uintptr_t mini_ht[32][2];
+#if NEW_DYNAREC == NEW_DYNAREC_X64
+    /* Return address stack: {guest return address, host address} pairs.
+       ras_top is the byte offset of the top entry. */
+    uintptr_t ras[16][2];
+    uint32_t ras_top;
+#endif
     uintptr_t memory_map[1048576];
 #else
     char dummy;
 #endif
 };
 
+/* Block dispatch counters (JR/JALR targets and unlinked branches) */
+struct new_dynarec_dispatch_stats
+{
+    uint64_t lookups;   /* lookups of a compiled block by vaddr */
+    uint64_t ht_misses; /* not in the lookup table, fell back to the block lists */
+    uint64_t compiles;  /* not compiled at all */
+};
+
 extern unsigned int stop_after_jal;
 extern unsigned int using_tlb;
 
 void invalidate_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t address, size_t size);
+void restore_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t address, size_t size);
+void discard_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t address, size_t size);
 void new_dynarec_init(void);
 void new_dyna_start(void);
 void new_dynarec_cleanup(void);
+void new_dynarec_get_dispatch_stats(struct new_dynarec_dispatch_stats* stats);
+void new_dynarec_reset_dispatch_stats(void);
+/* Log every compiled block to 'path' (NULL stops logging); emulation thread only */
+int new_dynarec_set_compile_log(const char* path);
+/* Write the live/dirty block lists and restore candidates to 'path' */
+int new_dynarec_dump_code_cache(const char* path);
 
 #endif /* M64P_DEVICE_R4300_NEW_DYNAREC_H */
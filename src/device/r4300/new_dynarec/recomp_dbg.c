@@ -57,6 +57,8 @@
 #define invalidate_all_pages                    recomp_dbg_invalidate_all_pages
 #define invalidate_block                        recomp_dbg_invalidate_block
 #define invalidate_cached_code_new_dynarec      recomp_dbg_invalidate_cached_code_new_dynarec
+#define restore_cached_code_new_dynarec         recomp_dbg_restore_cached_code_new_dynarec
+#define discard_cached_code_new_dynarec         recomp_dbg_discard_cached_code_new_dynarec
 #define new_dynarec_cleanup                     recomp_dbg_new_dynarec_cleanup
 #define new_dynarec_init                        recomp_dbg_new_dynarec_init
 #define new_recompile_block                     recomp_dbg_new_recompile_block
@@ -66,6 +68,10 @@
 #define cop1_unusable                           recomp_dbg_cop1_unusable
 #define dynamic_linker                          recomp_dbg_dynamic_linker
 #define dynamic_linker_ds                       recomp_dbg_dynamic_linker_ds
+#define new_dynarec_get_dispatch_stats          recomp_dbg_new_dynarec_get_dispatch_stats
+#define new_dynarec_reset_dispatch_stats        recomp_dbg_new_dynarec_reset_dispatch_stats
+#define new_dynarec_set_compile_log             recomp_dbg_new_dynarec_set_compile_log
+#define new_dynarec_dump_code_cache             recomp_dbg_new_dynarec_dump_code_cache
 
 #if RECOMPILER_DEBUG == 3 //ARM
 static void jump_vaddr_r0(void){}
@@ -821,8 +827,7 @@ void recomp_dbg_init(void)
   /* New dynarec init */
   recomp_dbg_out=(u_char *)recomp_dbg_base_addr;
 
-  for(int n=0;n<65536;n++)
-    hash_table[n][0]=hash_table[n][1]=NULL;
+  ht_clear();
 
   copy_size=0;
   expirep=16384; // Expiry pointer, +2 blocks
@@ -870,6 +875,8 @@ void recomp_dbg_cleanup(void)
   for(int n=0;n<4096;n++) ll_clear(jump_in+n);
   for(int n=0;n<4096;n++) ll_clear(jump_out+n);
   for(int n=0;n<4096;n++) ll_clear(jump_dirty+n);
+  for(int n=0;n<4096;n++) ll_clear(jump_span+n);
+  ll_clear(&rom_deps);
   assert(copy_size==0);
 
   /* Capstone cleanup */
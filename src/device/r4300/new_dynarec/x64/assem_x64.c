@@ -27,6 +27,13 @@ void jump_vaddr_ebx(void);
 void jump_vaddr_ebp(void);
 void jump_vaddr_esi(void);
 void jump_vaddr_edi(void);
+void jump_vaddr_r8(void);
+void jump_vaddr_r9(void);
+void jump_vaddr_r10(void);
+void jump_vaddr_r11(void);
+void jump_vaddr_r12(void);
+void jump_vaddr_r13(void);
+void jump_vaddr_r14(void);
 void invalidate_block_eax(void);
 void invalidate_block_ecx(void);
 void invalidate_block_edx(void);
@@ -34,12 +41,19 @@ void invalidate_block_ebx(void);
 void invalidate_block_ebp(void);
 void invalidate_block_esi(void);
 void invalidate_block_edi(void);
+void invalidate_block_r8(void);
+void invalidate_block_r9(void);
+void invalidate_block_r10(void);
+void invalidate_block_r11(void);
+void invalidate_block_r12(void);
+void invalidate_block_r13(void);
+void invalidate_block_r14(void);
 
 // We need these for cmovcc instructions on x64
 static const u_int const_zero=0;
 static const u_int const_one=1;
 
-static const uintptr_t jump_vaddr_reg[8] = {
+static const uintptr_t jump_vaddr_reg[16] = {
   (uintptr_t)jump_vaddr_eax,
   (uintptr_t)jump_vaddr_ecx,
   (uintptr_t)jump_vaddr_edx,
@@ -55,9 +69,17 @@ static const uintptr_t jump_vaddr_reg[8] = {
 #else
   (uintptr_t)jump_vaddr_esi,
 #endif
-  (uintptr_t)jump_vaddr_edi };
-
-static const uintptr_t invalidate_block_reg[8] = {
+  (uintptr_t)jump_vaddr_edi,
+  (uintptr_t)jump_vaddr_r8,
+  (uintptr_t)jump_vaddr_r9,
+  (uintptr_t)jump_vaddr_r10,
+  (uintptr_t)jump_vaddr_r11,
+  (uintptr_t)jump_vaddr_r12,
+  (uintptr_t)jump_vaddr_r13,
+  (uintptr_t)jump_vaddr_r14,
+  0 };
+
+static const uintptr_t invalidate_block_reg[16] = {
   (uintptr_t)invalidate_block_eax,
   (uintptr_t)invalidate_block_ecx,
   (uintptr_t)invalidate_block_edx,
@@ -65,7 +87,15 @@ static const uintptr_t invalidate_block_reg[8] = {
   0,
   (uintptr_t)invalidate_block_ebp,
   (uintptr_t)invalidate_block_esi,
-  (uintptr_t)invalidate_block_edi };
+  (uintptr_t)invalidate_block_edi,
+  (uintptr_t)invalidate_block_r8,
+  (uintptr_t)invalidate_block_r9,
+  (uintptr_t)invalidate_block_r10,
+  (uintptr_t)invalidate_block_r11,
+  (uintptr_t)invalidate_block_r12,
+  (uintptr_t)invalidate_block_r13,
+  (uintptr_t)invalidate_block_r14,
+  0 };
 
 /* Linker */
 
@@ -714,6 +744,14 @@ static const char regname[16][4] = {
  "r14",
  "r15"};
 
+static const char regname16[16][5] = {
+ "ax","cx","dx","bx","sp","bp","si","di",
+ "r8w","r9w","r10w","r11w","r12w","r13w","r14w","r15w"};
+
+static const char regname8[16][5] = {
+ "al","cl","dl","bl","spl","bpl","sil","dil",
+ "r8b","r9b","r10b","r11b","r12b","r13b","r14b","r15b"};
+
 static void output_byte(u_char byte)
 {
   *(out++)=byte;
@@ -754,10 +792,39 @@ static void output_w64(uint64_t dword)
   out+=8;
 }
 
+// Emit a REX prefix only when one is needed (64-bit operand or r8-r15)
+static void output_rex_opt(u_char w,u_int reg,u_int index,u_int base)
+{
+  if(w||reg>=8||index>=8||base>=8) output_rex(w,reg>>3,index>>3,base>>3);
+}
+// disp(base) addressing; rsp/r12 need a SIB byte, rbp/r13 need a displacement
+static void output_modrm_disp(int disp,u_int base,u_int reg)
+{
+  u_char mod=2;
+  if(disp==0&&(base&7)!=EBP) mod=0;
+  else if(disp<128&&disp>=-128) mod=1;
+  output_modrm(mod,base&7,reg&7);
+  if((base&7)==ESP) output_sib(0,4,4);
+  if(mod==1) output_byte(disp);
+  if(mod==2) output_w32(disp);
+}
+// disp(base,index,1<<scale) addressing
+static void output_modrm_sib(int disp,u_int base,u_int index,u_char scale,u_int reg)
+{
+  u_char mod=2;
+  assert(index!=ESP);
+  if(disp==0&&(base&7)!=EBP) mod=0;
+  else if(disp<128&&disp>=-128) mod=1;
+  output_modrm(mod,4,reg&7);
+  output_sib(scale,index&7,base&7);
+  if(mod==1) output_byte(disp);
+  if(mod==2) output_w32(disp);
+}
+
 static void emit_mov(int rs,int rt)
 {
   assem_debug("mov %%%s,%%%s",regname[rs],regname[rt]);
-  if(rs>=8||rt>=8) output_rex(0,rs>>3,0,rt>>3);
+  output_rex_opt(0,rs,0,rt);
   output_byte(0x89);
   output_modrm(3,rt&7,rs&7);
 }
@@ -765,28 +832,26 @@ static void emit_mov(int rs,int rt)
 static void emit_mov64(int rs,int rt)
 {
   assem_debug("mov %%%s,%%%s",regname[rs],regname[rt]);
-  output_rex(1,0,0,rt>>3); // FIXME
+  output_rex_opt(1,rs,0,rt);
   output_byte(0x89);
-  output_modrm(3,rt&7,rs);
+  output_modrm(3,rt&7,rs&7);
 }
 
 static void emit_add(int rs1,int rs2,int rt)
 {
   if(rs1==rt) {
     assem_debug("add %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rex_opt(0,rs2,0,rs1);
     output_byte(0x01);
-    output_modrm(3,rs1,rs2);
+    output_modrm(3,rs1&7,rs2&7);
   }else if(rs2==rt) {
     assem_debug("add %%%s,%%%s",regname[rs1],regname[rs2]);
+    output_rex_opt(0,rs1,0,rs2);
     output_byte(0x01);
-    output_modrm(3,rs2,rs1);
+    output_modrm(3,rs2&7,rs1&7);
   }else {
-    assem_debug("mov %%%s,%%%s",regname[rs1],regname[rt]);
-    output_byte(0x89);
-    output_modrm(3,rt,rs1);
-    assem_debug("add %%%s,%%%s",regname[rs2],regname[rt]);
-    output_byte(0x01);
-    output_modrm(3,rt,rs2);
+    emit_mov(rs1,rt);
+    emit_add(rt,rs2,rt);
   }
 }
 
@@ -794,19 +859,17 @@ static void emit_adc(int rs1,int rs2,int rt)
 {
   if(rs1==rt) {
     assem_debug("adc %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rex_opt(0,rs2,0,rs1);
     output_byte(0x11);
-    output_modrm(3,rs1,rs2);
+    output_modrm(3,rs1&7,rs2&7);
   }else if(rs2==rt) {
     assem_debug("adc %%%s,%%%s",regname[rs1],regname[rs2]);
+    output_rex_opt(0,rs1,0,rs2);
     output_byte(0x11);
-    output_modrm(3,rs2,rs1);
+    output_modrm(3,rs2&7,rs1&7);
   }else {
-    assem_debug("mov %%%s,%%%s",regname[rs1],regname[rt]);
-    output_byte(0x89);
-    output_modrm(3,rt,rs1);
-    assem_debug("adc %%%s,%%%s",regname[rs2],regname[rt]);
-    output_byte(0x11);
-    output_modrm(3,rt,rs2);
+    emit_mov(rs1,rt);
+    emit_adc(rt,rs2,rt);
   }
 }
 
@@ -818,9 +881,10 @@ static void emit_adds(int rs1,int rs2,int rt)
 static void emit_lea8(int rs1,int rt)
 {
   assem_debug("lea 0(%%%s,8),%%%s",regname[rs1],regname[rt]);
+  output_rex_opt(0,rt,rs1,0);
   output_byte(0x8D);
-  output_modrm(0,4,rt);
-  output_sib(3,rs1,5);
+  output_modrm(0,4,rt&7);
+  output_sib(3,rs1&7,5);
   output_w32(0);
 }
 static void emit_leairrx1(int imm,int rs1,int rs2,int rt)
@@ -828,28 +892,14 @@ static void emit_leairrx1(int imm,int rs1,int rs2,int rt)
   assem_debug("lea %x(%%%s,%%%s,1),%%%s",imm,regname[rs1],regname[rs2],regname[rt]);
   output_rex(1,rt>>3,rs2>>3,rs1>>3);
   output_byte(0x8D);
-  if(imm!=0||rs1==EBP) {
-    output_modrm(2,4,rt&7);
-    output_sib(0,rs2&7,rs1&7);
-    output_w32(imm);
-  }else{
-    output_modrm(0,4,rt&7);
-    output_sib(0,rs2&7,rs1&7);
-  }
+  output_modrm_sib(imm,rs1,rs2,0,rt);
 }
 static void emit_leairrx4(int imm,int rs1,int rs2,int rt)
 {
   assem_debug("lea %x(%%%s,%%%s,4),%%%s",imm,regname[rs1],regname[rs2],regname[rt]);
   output_rex(1,rt>>3,rs2>>3,rs1>>3);
   output_byte(0x8D);
-  if(imm!=0||rs1==EBP) {
-    output_modrm(2,4,rt&7);
-    output_sib(2,rs2&7,rs1&7);
-    output_w32(imm);
-  }else{
-    output_modrm(0,4,rt&7);
-    output_sib(2,rs2&7,rs1&7);
-  }
+  output_modrm_sib(imm,rs1,rs2,2,rt);
 }
 
 static void emit_lea_rip(intptr_t addr, int hr)
@@ -870,8 +920,9 @@ static void emit_neg(int rs, int rt)
 {
   if(rs!=rt) emit_mov(rs,rt);
   assem_debug("neg %%%s",regname[rt]);
+  output_rex_opt(0,0,0,rt);
   output_byte(0xF7);
-  output_modrm(3,rt,3);
+  output_modrm(3,rt&7,3);
 }
 
 static void emit_negs(int rs, int rt)
@@ -883,8 +934,9 @@ static void emit_sub(int rs1,int rs2,int rt)
 {
   if(rs1==rt) {
     assem_debug("sub %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rex_opt(0,rs2,0,rs1);
     output_byte(0x29);
-    output_modrm(3,rs1,rs2);
+    output_modrm(3,rs1&7,rs2&7);
   } else if(rs2==rt) {
     emit_neg(rs2,rs2);
     emit_add(rs2,rs1,rs2);
@@ -901,8 +953,9 @@ static void emit_subs(int rs1,int rs2,int rt)
 
 static void emit_zeroreg(int rt)
 {
+  output_rex_opt(0,rt,0,rt);
   output_byte(0x31);
-  output_modrm(3,rt,rt);
+  output_modrm(3,rt&7,rt&7);
   assem_debug("xor %%%s,%%%s",regname[rt],regname[rt]);
 }
 
@@ -959,17 +1012,17 @@ static void emit_storereg(int r, int hr)
 static void emit_test(int rs, int rt)
 {
   assem_debug("test %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x85);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 
 static void emit_test64(int rs, int rt)
 {
-  assert(rs<8&&rt<8);
   assem_debug("test %%%s,%%%s",regname[rs],regname[rt]);
-  output_rex(1,0,0,0);
+  output_rex_opt(1,rt,0,rs);
   output_byte(0x85);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 
 static void emit_testimm(int rs,int imm)
@@ -982,8 +1035,9 @@ static void emit_testimm(int rs,int imm)
   }
   else
   {
+    output_rex_opt(0,0,0,rs);
     output_byte(0xF7);
-    output_modrm(3,rs,0);
+    output_modrm(3,rs&7,0);
     output_w32(imm);
   }
 }
@@ -992,25 +1046,28 @@ static void emit_not(int rs,int rt)
 {
   if(rs!=rt) emit_mov(rs,rt);
   assem_debug("not %%%s",regname[rt]);
+  output_rex_opt(0,0,0,rt);
   output_byte(0xF7);
-  output_modrm(3,rt,2);
+  output_modrm(3,rt&7,2);
 }
 
 static void emit_and(u_int rs1,u_int rs2,u_int rt)
 {
-  assert(rs1<8);
-  assert(rs2<8);
-  assert(rt<8);
+  assert(rs1<16);
+  assert(rs2<16);
+  assert(rt<16);
   if(rs1==rt) {
     assem_debug("and %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rex_opt(0,rs2,0,rs1);
     output_byte(0x21);
-    output_modrm(3,rs1,rs2);
+    output_modrm(3,rs1&7,rs2&7);
   }
   else
   if(rs2==rt) {
     assem_debug("and %%%s,%%%s",regname[rs1],regname[rt]);
+    output_rex_opt(0,rs1,0,rs2);
     output_byte(0x21);
-    output_modrm(3,rs2,rs1);
+    output_modrm(3,rs2&7,rs1&7);
   }
   else {
     emit_mov(rs1,rt);
@@ -1020,19 +1077,21 @@ static void emit_and(u_int rs1,u_int rs2,u_int rt)
 
 static void emit_or(u_int rs1,u_int rs2,u_int rt)
 {
-  assert(rs1<8);
-  assert(rs2<8);
-  assert(rt<8);
+  assert(rs1<16);
+  assert(rs2<16);
+  assert(rt<16);
   if(rs1==rt) {
     assem_debug("or %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rex_opt(0,rs2,0,rs1);
     output_byte(0x09);
-    output_modrm(3,rs1,rs2);
+    output_modrm(3,rs1&7,rs2&7);
   }
   else
   if(rs2==rt) {
     assem_debug("or %%%s,%%%s",regname[rs1],regname[rt]);
+    output_rex_opt(0,rs1,0,rs2);
     output_byte(0x09);
-    output_modrm(3,rs2,rs1);
+    output_modrm(3,rs2&7,rs1&7);
   }
   else {
     emit_mov(rs1,rt);
@@ -1046,19 +1105,21 @@ static void emit_or_and_set_flags(int rs1,int rs2,int rt)
 
 static void emit_xor(u_int rs1,u_int rs2,u_int rt)
 {
-  assert(rs1<8);
-  assert(rs2<8);
-  assert(rt<8);
+  assert(rs1<16);
+  assert(rs2<16);
+  assert(rt<16);
   if(rs1==rt) {
     assem_debug("xor %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rex_opt(0,rs2,0,rs1);
     output_byte(0x31);
-    output_modrm(3,rs1,rs2);
+    output_modrm(3,rs1&7,rs2&7);
   }
   else
   if(rs2==rt) {
     assem_debug("xor %%%s,%%%s",regname[rs1],regname[rt]);
+    output_rex_opt(0,rs1,0,rs2);
     output_byte(0x31);
-    output_modrm(3,rs2,rs1);
+    output_modrm(3,rs2&7,rs1&7);
   }
   else {
     emit_mov(rs1,rt);
@@ -1089,15 +1150,16 @@ static void emit_addimm(int rs,int imm,int rt)
   if(rs==rt) {
     if(imm!=0) {
       assem_debug("add $%d,%%%s",imm,regname[rt]);
+      output_rex_opt(0,0,0,rt);
       if(imm<128&&imm>=-128) {
         output_byte(0x83);
-        output_modrm(3,rt,0);
+        output_modrm(3,rt&7,0);
         output_byte(imm);
       }
       else
       {
         output_byte(0x81);
-        output_modrm(3,rt,0);
+        output_modrm(3,rt&7,0);
         output_w32(imm);
       }
     }
@@ -1105,14 +1167,9 @@ static void emit_addimm(int rs,int imm,int rt)
   else {
     if(imm!=0) {
       assem_debug("lea %d(%%%s),%%%s",imm,regname[rs],regname[rt]);
+      output_rex_opt(0,rt,0,rs);
       output_byte(0x8D);
-      if(imm<128&&imm>=-128) {
-        output_modrm(1,rs,rt);
-        output_byte(imm);
-      }else{
-        output_modrm(2,rs,rt);
-        output_w32(imm);
-      }
+      output_modrm_disp(imm,rs,rt);
     }else{
       emit_mov(rs,rt);
     }
@@ -1144,15 +1201,9 @@ static void emit_addimm64(int rs,int imm,int rt)
       assem_debug("lea %d(%%%s),%%%s",imm,regname[rs],regname[rt]);
       output_rex(1,rt>>3,0,rs>>3);
       output_byte(0x8D);
-      if(imm<128&&imm>=-128) {
-        output_modrm(1,rs&7,rt&7);
-        output_byte(imm);
-      }else{
-        output_modrm(2,rs&7,rt&7);
-        output_w32(imm);
-      }
+      output_modrm_disp(imm,rs,rt);
     }else{
-      emit_mov(rs,rt);
+      emit_mov64(rs,rt);
     }
   }
 }
@@ -1160,15 +1211,16 @@ static void emit_addimm64(int rs,int imm,int rt)
 static void emit_addimm_and_set_flags(int imm,int rt)
 {
   assem_debug("add $%d,%%%s",imm,regname[rt]);
+  output_rex_opt(0,0,0,rt);
   if(imm<128&&imm>=-128) {
     output_byte(0x83);
-    output_modrm(3,rt,0);
+    output_modrm(3,rt&7,0);
     output_byte(imm);
   }
   else
   {
     output_byte(0x81);
-    output_modrm(3,rt,0);
+    output_modrm(3,rt&7,0);
     output_w32(imm);
   }
 }
@@ -1176,46 +1228,43 @@ static void emit_addimm_no_flags(int imm,int rt)
 {
   if(imm!=0) {
     assem_debug("lea %d(%%%s),%%%s",imm,regname[rt],regname[rt]);
+    output_rex_opt(0,rt,0,rt);
     output_byte(0x8D);
-    if(imm<128&&imm>=-128) {
-      output_modrm(1,rt,rt);
-      output_byte(imm);
-    }else{
-      output_modrm(2,rt,rt);
-      output_w32(imm);
-    }
+    output_modrm_disp(imm,rt,rt);
   }
 }
 
 static void emit_adcimm(int imm,u_int rt)
 {
   assem_debug("adc $%d,%%%s",imm,regname[rt]);
-  assert(rt<8);
+  assert(rt<16);
+  output_rex_opt(0,0,0,rt);
   if(imm<128&&imm>=-128) {
     output_byte(0x83);
-    output_modrm(3,rt,2);
+    output_modrm(3,rt&7,2);
     output_byte(imm);
   }
   else
   {
     output_byte(0x81);
-    output_modrm(3,rt,2);
+    output_modrm(3,rt&7,2);
     output_w32(imm);
   }
 }
 static void emit_sbbimm(int imm,u_int rt)
 {
   assem_debug("sbb $%d,%%%s",imm,regname[rt]);
-  assert(rt<8);
+  assert(rt<16);
+  output_rex_opt(0,0,0,rt);
   if(imm<128&&imm>=-128) {
     output_byte(0x83);
-    output_modrm(3,rt,3);
+    output_modrm(3,rt&7,3);
     output_byte(imm);
   }
   else
   {
     output_byte(0x81);
-    output_modrm(3,rt,3);
+    output_modrm(3,rt&7,3);
     output_w32(imm);
   }
 }
@@ -1223,22 +1272,8 @@ static void emit_sbbimm(int imm,u_int rt)
 static void emit_addimm64_32(int rsh,int rsl,int imm,int rth,int rtl)
 {
   if(rsh==rth&&rsl==rtl) {
-    assem_debug("add $%d,%%%s",imm,regname[rtl]);
-    if(imm<128&&imm>=-128) {
-      output_byte(0x83);
-      output_modrm(3,rtl,0);
-      output_byte(imm);
-    }
-    else
-    {
-      output_byte(0x81);
-      output_modrm(3,rtl,0);
-      output_w32(imm);
-    }
-    assem_debug("adc $%d,%%%s",imm>>31,regname[rth]);
-    output_byte(0x83);
-    output_modrm(3,rth,2);
-    output_byte(imm>>31);
+    emit_addimm_and_set_flags(imm,rtl);
+    emit_adcimm(imm>>31,rth);
   }
   else {
     emit_mov(rsh,rth);
@@ -1247,43 +1282,32 @@ static void emit_addimm64_32(int rsh,int rsl,int imm,int rth,int rtl)
   }
 }
 
+static void emit_sbb(int rs1,int rs2)
+{
+  assem_debug("sbb %%%s,%%%s",regname[rs1],regname[rs2]);
+  output_rex_opt(0,rs1,0,rs2);
+  output_byte(0x19);
+  output_modrm(3,rs2&7,rs1&7);
+}
 static void emit_sub64_32(int rs1l,int rs1h,int rs2l,int rs2h,int rtl,int rth)
 {
   if((rs1l==rtl)&&(rs1h==rth)) {
-    assem_debug("sub %%%s,%%%s",regname[rs2l],regname[rs1l]);
-    output_byte(0x29);
-    output_modrm(3,rs1l,rs2l);
-    assem_debug("sbb %%%s,%%%s",regname[rs2h],regname[rs1h]);
-    output_byte(0x19);
-    output_modrm(3,rs1h,rs2h);
+    emit_sub(rs1l,rs2l,rs1l);
+    emit_sbb(rs2h,rs1h);
   } else if((rs2l==rtl)&&(rs2h==rth)) {
     emit_neg(rs2l,rs2l);
     emit_adcimm(-1,rs2h);
-    assem_debug("add %%%s,%%%s",regname[rs1l],regname[rs2l]);
-    output_byte(0x01);
-    output_modrm(3,rs2l,rs1l);
+    emit_add(rs2l,rs1l,rs2l);
     emit_not(rs2h,rs2h);
-    assem_debug("adc %%%s,%%%s",regname[rs1h],regname[rs2h]);
-    output_byte(0x11);
-    output_modrm(3,rs2h,rs1h);
+    emit_adc(rs2h,rs1h,rs2h);
   } else {
     emit_mov(rs1l,rtl);
-    assem_debug("sub %%%s,%%%s",regname[rs2l],regname[rtl]);
-    output_byte(0x29);
-    output_modrm(3,rtl,rs2l);
+    emit_sub(rtl,rs2l,rtl);
     emit_mov(rs1h,rth);
-    assem_debug("sbb %%%s,%%%s",regname[rs2h],regname[rth]);
-    output_byte(0x19);
-    output_modrm(3,rth,rs2h);
+    emit_sbb(rs2h,rth);
   }
 }
 
-static void emit_sbb(int rs1,int rs2)
-{
-  assem_debug("sbb %%%s,%%%s",regname[rs1],regname[rs2]);
-  output_byte(0x19);
-  output_modrm(3,rs2,rs1);
-}
 
 static void emit_andimm(int rs,int imm,int rt)
 {
@@ -1292,15 +1316,16 @@ static void emit_andimm(int rs,int imm,int rt)
   }
   else if(rs==rt) {
     assem_debug("and $%d,%%%s",imm,regname[rt]);
+    output_rex_opt(0,0,0,rt);
     if(imm<128&&imm>=-128) {
       output_byte(0x83);
-      output_modrm(3,rt,4);
+      output_modrm(3,rt&7,4);
       output_byte(imm);
     }
     else
     {
       output_byte(0x81);
-      output_modrm(3,rt,4);
+      output_modrm(3,rt&7,4);
       output_w32(imm);
     }
   }
@@ -1315,15 +1340,16 @@ static void emit_orimm(int rs,int imm,int rt)
   if(rs==rt) {
     if(imm!=0) {
       assem_debug("or $%d,%%%s",imm,regname[rt]);
+      output_rex_opt(0,0,0,rt);
       if(imm<128&&imm>=-128) {
         output_byte(0x83);
-        output_modrm(3,rt,1);
+        output_modrm(3,rt&7,1);
         output_byte(imm);
       }
       else
       {
         output_byte(0x81);
-        output_modrm(3,rt,1);
+        output_modrm(3,rt&7,1);
         output_w32(imm);
       }
     }
@@ -1339,15 +1365,16 @@ static void emit_xorimm(int rs,int imm,int rt)
   if(rs==rt) {
     if(imm!=0) {
       assem_debug("xor $%d,%%%s",imm,regname[rt]);
+      output_rex_opt(0,0,0,rt);
       if(imm<128&&imm>=-128) {
         output_byte(0x83);
-        output_modrm(3,rt,6);
+        output_modrm(3,rt&7,6);
         output_byte(imm);
       }
       else
       {
         output_byte(0x81);
-        output_modrm(3,rt,6);
+        output_modrm(3,rt&7,6);
         output_w32(imm);
       }
     }
@@ -1363,9 +1390,10 @@ static void emit_shlimm(int rs,u_int imm,int rt)
   if(rs==rt) {
     assem_debug("shl %%%s,%d",regname[rt],imm);
     assert(imm>0);
+    output_rex_opt(0,0,0,rt);
     if(imm==1) output_byte(0xD1);
     else output_byte(0xC1);
-    output_modrm(3,rt,4);
+    output_modrm(3,rt&7,4);
     if(imm>1) output_byte(imm);
   }
   else {
@@ -1396,9 +1424,10 @@ static void emit_shrimm(int rs,u_int imm,int rt)
   if(rs==rt) {
     assem_debug("shr %%%s,%d",regname[rt],imm);
     assert(imm>0);
+    output_rex_opt(0,0,0,rt);
     if(imm==1) output_byte(0xD1);
     else output_byte(0xC1);
-    output_modrm(3,rt,5);
+    output_modrm(3,rt&7,5);
     if(imm>1) output_byte(imm);
   }
   else {
@@ -1447,9 +1476,10 @@ static void emit_rorimm(int rs,u_int imm,int rt)
   if(rs==rt) {
     assem_debug("ror %%%s,%d",regname[rt],imm);
     assert(imm>0);
+    output_rex_opt(0,0,0,rt);
     if(imm==1) output_byte(0xD1);
     else output_byte(0xC1);
-    output_modrm(3,rt,1);
+    output_modrm(3,rt&7,1);
     if(imm>1) output_byte(imm);
   }
   else {
@@ -1463,9 +1493,10 @@ static void emit_shldimm(int rs,int rs2,u_int imm,int rt)
   if(rs==rt) {
     assem_debug("shld %%%s,%%%s,%d",regname[rt],regname[rs2],imm);
     assert(imm>0);
+    output_rex_opt(0,rs2,0,rt);
     output_byte(0x0F);
     output_byte(0xA4);
-    output_modrm(3,rt,rs2);
+    output_modrm(3,rt&7,rs2&7);
     output_byte(imm);
   }
   else {
@@ -1479,9 +1510,10 @@ static void emit_shrdimm(int rs,int rs2,u_int imm,int rt)
   if(rs==rt) {
     assem_debug("shrd %%%s,%%%s,%d",regname[rt],regname[rs2],imm);
     assert(imm>0);
+    output_rex_opt(0,rs2,0,rt);
     output_byte(0x0F);
     output_byte(0xAC);
-    output_modrm(3,rt,rs2);
+    output_modrm(3,rt&7,rs2&7);
     output_byte(imm);
   }
   else {
@@ -1507,37 +1539,41 @@ static void emit_shrcl(int r)
 static void emit_sarcl(int r)
 {
   assem_debug("sar %%%s,%%cl",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xD3);
-  output_modrm(3,r,7);
+  output_modrm(3,r&7,7);
 }
 
 static void emit_shldcl(int r1,int r2)
 {
   assem_debug("shld %%%s,%%%s,%%cl",regname[r1],regname[r2]);
+  output_rex_opt(0,r2,0,r1);
   output_byte(0x0F);
   output_byte(0xA5);
-  output_modrm(3,r1,r2);
+  output_modrm(3,r1&7,r2&7);
 }
 static void emit_shrdcl(int r1,int r2)
 {
   assem_debug("shrd %%%s,%%%s,%%cl",regname[r1],regname[r2]);
+  output_rex_opt(0,r2,0,r1);
   output_byte(0x0F);
   output_byte(0xAD);
-  output_modrm(3,r1,r2);
+  output_modrm(3,r1&7,r2&7);
 }
 
 static void emit_cmpimm(int rs,int imm)
 {
   assem_debug("cmp $%d,%%%s",imm,regname[rs]);
+  output_rex_opt(0,0,0,rs);
   if(imm<128&&imm>=-128) {
     output_byte(0x83);
-    output_modrm(3,rs,7);
+    output_modrm(3,rs&7,7);
     output_byte(imm);
   }
   else
   {
     output_byte(0x81);
-    output_modrm(3,rs,7);
+    output_modrm(3,rs&7,7);
     output_w32(imm);
   }
 }
@@ -1549,9 +1585,10 @@ static void emit_cmovne(const u_int *addr,int rt)
   if(addr==&const_zero) assem_debug(" [zero]");
   else if(addr==&const_one) assem_debug(" [one]");
   else assem_debug("");
+  output_rex_opt(0,rt,0,0);
   output_byte(0x0F);
   output_byte(0x45);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32((intptr_t)addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_cmovl(const u_int *addr,int rt)
@@ -1561,9 +1598,10 @@ static void emit_cmovl(const u_int *addr,int rt)
   if(addr==&const_zero) assem_debug(" [zero]");
   else if(addr==&const_one) assem_debug(" [one]");
   else assem_debug("");
+  output_rex_opt(0,rt,0,0);
   output_byte(0x0F);
   output_byte(0x4C);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32((intptr_t)addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_cmovs(const u_int *addr,int rt)
@@ -1573,84 +1611,83 @@ static void emit_cmovs(const u_int *addr,int rt)
   if(addr==&const_zero) assem_debug(" [zero]");
   else if(addr==&const_one) assem_debug(" [one]");
   else assem_debug("");
+  output_rex_opt(0,rt,0,0);
   output_byte(0x0F);
   output_byte(0x48);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32((intptr_t)addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_cmovne_reg(int rs,int rt)
 {
   assem_debug("cmovne %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0x45);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_cmovl_reg(int rs,int rt)
 {
   assem_debug("cmovl %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0x4C);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_cmovs_reg(int rs,int rt)
 {
   assem_debug("cmovs %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0x48);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_cmovnc_reg(int rs,int rt)
 {
   assem_debug("cmovae %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0x43);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_cmova_reg(int rs,int rt)
 {
   assem_debug("cmova %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0x47);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_cmovp_reg(int rs,int rt)
 {
   assem_debug("cmovp %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0x4A);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_cmovnp_reg(int rs,int rt)
 {
   assem_debug("cmovnp %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0x4B);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_setl(int rt)
 {
-  assem_debug("setl %%%s",regname[rt]);
+  assem_debug("setl %%%s",regname8[rt]);
+  if(rt>=4) output_rex(0,0,0,rt>>3);
   output_byte(0x0F);
   output_byte(0x9C);
-  output_modrm(3,rt,2);
+  output_modrm(3,rt&7,2);
 }
 static void emit_movzbl_reg(int rs, int rt)
 {
-  if(rs<4&&rt<8) {
-    assem_debug("movzbl %%%s,%%%s",regname[rs]+1,regname[rt]);
-    output_byte(0x0F);
-    output_byte(0xB6);
-    output_modrm(3,rs,rt);
-  }
-  else {
-    assert(rs<8);
-    assert(rt<8);
-    assem_debug("movzbl %%%s,%%%s",regname[rs]+1,regname[rt]);
-    output_rex(0,rt>>3,0,rs>>3);
-    output_byte(0x0F);
-    output_byte(0xB6);
-    output_modrm(3,rs&7,rt&7);
-  }
+  assem_debug("movzbl %%%s,%%%s",regname8[rs],regname[rt]);
+  if(rs>=4||rt>=8) output_rex(0,rt>>3,0,rs>>3);
+  output_byte(0x0F);
+  output_byte(0xB6);
+  output_modrm(3,rs&7,rt&7);
 }
 
 static void emit_slti32(int rs,int imm,int rt)
@@ -1710,8 +1747,9 @@ static void emit_sltiu64_32(int rsh,int rsl,int imm,int rt)
 static void emit_cmp(int rs,int rt)
 {
   assem_debug("cmp %%%s,%%%s",regname[rt],regname[rs]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x39);
-  output_modrm(3,rs,rt);
+  output_modrm(3,rs&7,rt&7);
 }
 static void emit_set_gz32(int rs, int rt)
 {
@@ -1887,24 +1925,26 @@ static void emit_popreg(u_int r)
 static void emit_callreg(u_int r)
 {
   assem_debug("call *%%%s",regname[r]);
-  assert(r<8);
+  assert(r<16);
+  output_rex_opt(0,0,0,r);
   output_byte(0xFF);
-  output_modrm(3,r,2);
+  output_modrm(3,r&7,2);
 }
 static void emit_jmpreg(u_int r)
 {
   assem_debug("jmp *%%%s",regname[r]);
-  assert(r<8);
+  assert(r<16);
+  output_rex_opt(0,0,0,r);
   output_byte(0xFF);
-  output_modrm(3,r,4);
+  output_modrm(3,r&7,4);
 }
 static void emit_jmpmem_indexed(u_int addr,u_int r)
 {
   assem_debug("jmp *%x(%%%s)",addr,regname[r]);
-  assert(r<8);
+  assert(r<16);
+  output_rex_opt(0,0,0,r);
   output_byte(0xFF);
-  output_modrm(2,r,4);
-  output_w32(addr);
+  output_modrm_disp(addr,r,4);
 }
 
 static void emit_addmem64(intptr_t addr,int hr)
@@ -1936,26 +1976,18 @@ static void emit_readword(intptr_t addr, int rt)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
   assem_debug("mov %llx,%%%s",addr,regname[rt]);
+  output_rex_opt(0,rt,0,0);
   output_byte(0x8B);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_readword_indexed(intptr_t addr, int rs, int rt)
 {
   assem_debug("mov %llx+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  assert((addr<128&&addr>=-128)||(uintptr_t)addr<4294967296LL);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x8B);
-  if(addr<128&&addr>=-128) {
-    output_modrm(1,rs,rt);
-    if(rs==ESP) output_sib(0,4,4);
-    output_byte(addr);
-  }
-  else
-  {
-    assert((uintptr_t)addr<4294967296LL);
-    output_modrm(2,rs,rt);
-    if(rs==ESP) output_sib(0,4,4);
-    output_w32(addr);
-  }
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_readword_indexed_tlb(int addr, int rs, int map, int rt)
 {
@@ -1965,27 +1997,9 @@ static void emit_readword_indexed_tlb(int addr, int rs, int map, int rt)
     assem_debug("mov %x(%%%s,%%%s),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
     //output_byte(0x67);
-    if(map>=8)
-    {
-      assert(map==HOST_TEMPREG);
-      output_rex(0,0,map>>3,0);
-    }
+    output_rex_opt(0,rt,map,rs);
     output_byte(0x8B);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt);
-      output_sib(0,map&7,rs);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt);
-      output_sib(0,map&7,rs);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt);
-      output_sib(0,map&7,rs);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 static void emit_readdword_dualindexedx8(int rs1, int rs2, int rt)
@@ -1994,15 +2008,7 @@ static void emit_readdword_dualindexedx8(int rs1, int rs2, int rt)
   assert(rs1!=ESP);
   output_rex(1,rt>>3,rs2>>3,rs1>>3);
   output_byte(0x8B);
-  if(rs1!=EBP) {
-    output_modrm(0,4,rt&7);
-    output_sib(3,rs2&7,rs1&7);
-  }
-  else {
-    output_modrm(1,4,rt);
-    output_sib(3,rs2&7,rs1&7);
-    output_byte(0);
-  }
+  output_modrm_sib(0,rs1,rs2,3,rt);
 }
 static void emit_movmem_indexedx4(int addr, int rs, int rt)
 {
@@ -2059,20 +2065,10 @@ static void emit_movmem64(intptr_t addr, int rt)
 static void emit_readdword_indexed(intptr_t addr, int rs, int rt)
 {
   assem_debug("mov %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  assert((addr<128&&addr>=-128)||addr<4294967296LL);
   output_rex(1,rt>>3,0,rs>>3);
   output_byte(0x8B);
-  if(addr<128&&addr>=-128) {
-    output_modrm(1,rs&7,rt&7);
-    if(rs==ESP) output_sib(0,4,4);
-    output_byte(addr);
-  }
-  else
-  {
-    assert(addr<4294967296LL);
-    output_modrm(2,rs&7,rt&7);
-    if(rs==ESP) output_sib(0,4,4);
-    output_w32(addr);
-  }
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_readdword_indexed_tlb(int addr, int rs, int map, int rh, int rl)
 {
@@ -2085,19 +2081,20 @@ static void emit_movsbl(intptr_t addr, int rt)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
   assem_debug("movsbl %llx,%%%s",addr,regname[rt]);
+  output_rex_opt(0,rt,0,0);
   output_byte(0x0F);
   output_byte(0xBE);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_movsbl_indexed(uintptr_t addr, int rs, int rt)
 {
   assert(addr<4294967296LL);
   assem_debug("movsbl %llx+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0xBE);
-  output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_movsbl_indexed_tlb(int addr, int rs, int map, int rt)
 {
@@ -2107,47 +2104,30 @@ static void emit_movsbl_indexed_tlb(int addr, int rs, int map, int rt)
     assem_debug("movsbl %x(%%%s,%%%s),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
     //output_byte(0x67);
-    if(map>=8)
-    {
-      assert(map==HOST_TEMPREG);
-      output_rex(0,0,map>>3,0);
-    }
+    output_rex_opt(0,rt,map,rs);
     output_byte(0x0F);
     output_byte(0xBE);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt);
-      output_sib(0,map&7,rs);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt);
-      output_sib(0,map&7,rs);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt);
-      output_sib(0,map&7,rs);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 static void emit_movswl(intptr_t addr, int rt)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
   assem_debug("movswl %llx,%%%s",addr,regname[rt]);
+  output_rex_opt(0,rt,0,0);
   output_byte(0x0F);
   output_byte(0xBF);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_movswl_indexed(uintptr_t addr, int rs, int rt)
 {
   assert(addr<4294967296LL);
   assem_debug("movswl %llx+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0xBF);
-  output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_movswl_indexed_tlb(int addr, int rs, int map, int rt)
 {
@@ -2157,47 +2137,30 @@ static void emit_movswl_indexed_tlb(int addr, int rs, int map, int rt)
     assem_debug("movswl %x(%%%s,%%%s),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
     //output_byte(0x67);
-    if(map>=8)
-    {
-      assert(map==HOST_TEMPREG);
-      output_rex(0,0,map>>3,0);
-    }
+    output_rex_opt(0,rt,map,rs);
     output_byte(0x0F);
     output_byte(0xBF);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt);
-      output_sib(0,map&7,rs);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt);
-      output_sib(0,map&7,rs);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt);
-      output_sib(0,map&7,rs);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 static void emit_movzbl(intptr_t addr, int rt)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
   assem_debug("movzbl %llx,%%%s",addr,regname[rt]);
+  output_rex_opt(0,rt,0,0);
   output_byte(0x0F);
   output_byte(0xB6);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_movzbl_indexed(uintptr_t addr, int rs, int rt)
 {
   assert(addr<4294967296LL);
   assem_debug("movzbl %llx+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0xB6);
-  output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_movzbl_indexed_tlb(int addr, int rs, int map, int rt)
 {
@@ -2207,47 +2170,30 @@ static void emit_movzbl_indexed_tlb(int addr, int rs, int map, int rt)
     assem_debug("movzbl %x(%%%s,%%%s),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
     //output_byte(0x67);
-    if(map>=8)
-    {
-      assert(map==HOST_TEMPREG);
-      output_rex(0,0,map>>3,0);
-    }
+    output_rex_opt(0,rt,map,rs);
     output_byte(0x0F);
     output_byte(0xB6);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt);
-      output_sib(0,map&7,rs);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt);
-      output_sib(0,map&7,rs);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt);
-      output_sib(0,map&7,rs);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 static void emit_movzwl(intptr_t addr, int rt)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
   assem_debug("movzwl %llx,%%%s",addr,regname[rt]);
+  output_rex_opt(0,rt,0,0);
   output_byte(0x0F);
   output_byte(0xB7);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_movzwl_indexed(uintptr_t addr, int rs, int rt)
 {
   assert(addr<4294967296LL);
   assem_debug("movzwl %llx+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x0F);
   output_byte(0xB7);
-  output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_movzwl_indexed_tlb(int addr, int rs, int map, int rt)
 {
@@ -2257,28 +2203,10 @@ static void emit_movzwl_indexed_tlb(int addr, int rs, int map, int rt)
     assem_debug("movzwl %x(%%%s,%%%s),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
     //output_byte(0x67);
-    if(map>=8)
-    {
-      assert(map==HOST_TEMPREG);
-      output_rex(0,0,map>>3,0);
-    }
+    output_rex_opt(0,rt,map,rs);
     output_byte(0x0F);
     output_byte(0xB7);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt);
-      output_sib(0,map&7,rs);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt);
-      output_sib(0,map&7,rs);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt);
-      output_sib(0,map&7,rs);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 
@@ -2286,52 +2214,46 @@ static void emit_xchg(int rs, int rt)
 {
   assem_debug("xchg %%%s,%%%s",regname[rs],regname[rt]);
   if(rs==EAX) {
-    output_byte(0x90+rt);
+    output_rex_opt(0,0,0,rt);
+    output_byte(0x90+(rt&7));
   }
   else
   {
+    output_rex_opt(0,rt,0,rs);
     output_byte(0x87);
-    output_modrm(3,rs,rt);
+    output_modrm(3,rs&7,rt&7);
   }
 }
 static void emit_xchg64(int rs, int rt)
 {
   assem_debug("xchg %%%s,%%%s",regname[rs],regname[rt]);
   if(rs==EAX) {
-    output_rex(1,0,0,rt>>3); // FIXME
+    output_rex(1,0,0,rt>>3);
     output_byte(0x90+(rt&7));
   }
   else
   {
-    output_rex(1,0,0,rt>>3); // FIXME
+    output_rex(1,rt>>3,0,rs>>3);
     output_byte(0x87);
-    output_modrm(3,rs,rt&7);
+    output_modrm(3,rs&7,rt&7);
   }
 }
 static void emit_writeword(int rt, intptr_t addr)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
   assem_debug("movl %%%s,%llx",regname[rt],addr);
+  output_rex_opt(0,rt,0,0);
   output_byte(0x89);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_writeword_indexed(int rt, intptr_t addr, int rs)
 {
   assem_debug("mov %%%s,%llx+%%%s",regname[rt],addr,regname[rs]);
+  assert((addr<128&&addr>=-128)||(uintptr_t)addr<4294967296LL);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x89);
-  if(addr<128&&addr>=-128) {
-    output_modrm(1,rs,rt);
-    if(rs==ESP) output_sib(0,4,4);
-    output_byte(addr);
-  }
-  else
-  {
-    assert((uintptr_t)addr<4294967296LL);
-    output_modrm(2,rs,rt);
-    if(rs==ESP) output_sib(0,4,4);
-    output_w32(addr);
-  }
+  output_modrm_disp(addr,rs,rt);
 }
 
 static void emit_writeword_indexed_tlb(int rt, int addr, int rs, int map)
@@ -2342,27 +2264,9 @@ static void emit_writeword_indexed_tlb(int rt, int addr, int rs, int map)
     assem_debug("mov %%%s,%x(%%%s,%%%s)",regname[rt],addr,regname[rs],regname[map]);
     assert(rs!=ESP);
     //output_byte(0x67);
-    if(map>=8)
-    {
-      assert(map==HOST_TEMPREG);
-      output_rex(0,0,map>>3,0);
-    }
+    output_rex_opt(0,rt,map,rs);
     output_byte(0x89);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt);
-      output_sib(0,map&7,rs);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt);
-      output_sib(0,map&7,rs);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt);
-      output_sib(0,map&7,rs);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 
@@ -2376,27 +2280,21 @@ static void emit_writedword_indexed_tlb(int rh, int rl, int addr, int rs, int ma
 static void emit_writehword(int rt, int addr)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
-  assem_debug("movw %%%s,%llx",regname[rt]+1,addr);
+  assem_debug("movw %%%s,%llx",regname16[rt],addr);
   output_byte(0x66);
+  output_rex_opt(0,rt,0,0);
   output_byte(0x89);
-  output_modrm(0,5,rt);
+  output_modrm(0,5,rt&7);
   output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
 }
 static void emit_writehword_indexed(int rt, intptr_t addr, int rs)
 {
-  assem_debug("movw %%%s,%llx+%%%s",regname[rt]+1,addr,regname[rs]);
+  assem_debug("movw %%%s,%llx+%%%s",regname16[rt],addr,regname[rs]);
+  assert((addr<128&&addr>=-128)||(uintptr_t)addr<4294967296LL);
   output_byte(0x66);
+  output_rex_opt(0,rt,0,rs);
   output_byte(0x89);
-  if(addr<128&&addr>=-128) {
-    output_modrm(1,rs,rt);
-    output_byte(addr);
-  }
-  else
-  {
-    assert((uintptr_t)addr<4294967296LL);
-    output_modrm(2,rs,rt);
-    output_w32(addr);
-  }
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_writehword_indexed_tlb(int rt, int addr, int rs, int map)
 {
@@ -2404,37 +2302,18 @@ static void emit_writehword_indexed_tlb(int rt, int addr, int rs, int map)
   /*if(map<0) emit_writehword_indexed(rt, addr+(intptr_t)g_dev.rdram.dram-0x80000000LL, rs);
   else*/
   {
-    assem_debug("movw %%%s,%x(%%%s,%%%s)",regname[rt]+1,addr,regname[rs],regname[map]);
+    assem_debug("movw %%%s,%x(%%%s,%%%s)",regname16[rt],addr,regname[rs],regname[map]);
     assert(rs!=ESP);
     output_byte(0x66);
-    if(rt>=4||rs>=8||map>=8)
-    {
-      if(map>=8) assert(map==HOST_TEMPREG);
-      assert(rs<8);
-      output_rex(0,rt>>3,map>>3,rs>>3);
-    }
+    output_rex_opt(0,rt,map,rs);
     output_byte(0x89);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt&7);
-      output_sib(0,map&7,rs&7);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt&7);
-      output_sib(0,map&7,rs&7);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt&7);
-      output_sib(0,map&7,rs&7);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 static void emit_writebyte(int rt, int addr)
 {
   assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
-  assem_debug("movb %%%cl,%llx",regname[rt][1],addr);
+  assem_debug("movb %%%s,%llx",regname8[rt],addr);
   if(rt>=4) output_rex(0,rt>>3,0,0);
   output_byte(0x88);
   output_modrm(0,5,rt&7);
@@ -2442,19 +2321,11 @@ static void emit_writebyte(int rt, int addr)
 }
 static void emit_writebyte_indexed(int rt, intptr_t addr, int rs)
 {
-  assem_debug("movb %%%cl,%llx+%%%s",regname[rt][1],addr,regname[rs]);
+  assem_debug("movb %%%s,%llx+%%%s",regname8[rt],addr,regname[rs]);
+  assert((addr<128&&addr>=-128)||(uintptr_t)addr<4294967296LL);
   if(rt>=4||rs>=8) output_rex(0,rt>>3,0,rs>>3);
   output_byte(0x88);
-  if(addr<128&&addr>=-128) {
-    output_modrm(1,rs&7,rt&7);
-    output_byte(addr);
-  }
-  else
-  {
-    assert((uintptr_t)addr<4294967296LL);
-    output_modrm(2,rs,rt);
-    output_w32(addr);
-  }
+  output_modrm_disp(addr,rs,rt);
 }
 static void emit_writebyte_indexed_tlb(int rt, int addr, int rs, int map)
 {
@@ -2462,31 +2333,13 @@ static void emit_writebyte_indexed_tlb(int rt, int addr, int rs, int map)
   /*if(map<0) emit_writebyte_indexed(rt, addr+(intptr_t)g_dev.rdram.dram-0x80000000LL, rs);
   else*/
   {
-    assem_debug("movb %%%cl,%x(%%%s,%%%s)",regname[rt][1],addr,regname[rs],regname[map]);
+    assem_debug("movb %%%s,%x(%%%s,%%%s)",regname8[rt],addr,regname[rs],regname[map]);
     assert(rs!=ESP);
     //output_byte(0x67);
     if(rt>=4||rs>=8||map>=8)
-    {
-      if(map>=8) assert(map==HOST_TEMPREG);
-      assert(rs<8);
       output_rex(0,rt>>3,map>>3,rs>>3);
-    }
     output_byte(0x88);
-    if(addr==0&&rs!=EBP) {
-      output_modrm(0,4,rt&7);
-      output_sib(0,map&7,rs&7);
-    }
-    else if(addr<128&&addr>=-128) {
-      output_modrm(1,4,rt&7);
-      output_sib(0,map&7,rs&7);
-      output_byte(addr);
-    }
-    else
-    {
-      output_modrm(2,4,rt&7);
-      output_sib(0,map&7,rs&7);
-      output_w32(addr);
-    }
+    output_modrm_sib(addr,rs,map,0,rt);
   }
 }
 static void emit_writeword_imm(int imm, intptr_t addr)
@@ -2509,6 +2362,13 @@ static void emit_writeword_imm_esp(int imm, intptr_t addr)
   if(addr) output_byte(addr);
   output_w32(imm);
 }
+static void emit_writedword_indexed(int rt, int addr, int rs)
+{
+  assem_debug("movq %%%s,%x+%%%s",regname[rt],addr,regname[rs]);
+  output_rex(1,rt>>3,0,rs>>3);
+  output_byte(0x89);
+  output_modrm_disp(addr,rs,rt);
+}
 static void emit_writedword_imm32(int imm, intptr_t addr)
 {
   assert(0);
@@ -2530,39 +2390,34 @@ static void emit_writebyte_imm(int imm, intptr_t addr)
   output_w32(addr-(intptr_t)out-5); // Note: rip-relative in 64-bit mode
   output_byte(imm);
 }
-static void emit_writedword(int rt, intptr_t addr)
-{
-  assert((intptr_t)addr-(intptr_t)out>=(-VADDR_MASK)&&(intptr_t)addr-(intptr_t)out<(VADDR_MASK - 1));
-  assem_debug("movq %%%s,%llx",regname[rt],addr);
-  output_rex(1,rt>>3,0,0);
-  output_byte(0x89);
-  output_modrm(0,5,rt&7);
-  output_w32(addr-(intptr_t)out-4); // Note: rip-relative in 64-bit mode
-}
 
 static void emit_mul(int rs)
 {
   assem_debug("mul %%%s",regname[rs]);
+  output_rex_opt(0,0,0,rs);
   output_byte(0xF7);
-  output_modrm(3,rs,4);
+  output_modrm(3,rs&7,4);
 }
 static void emit_imul(int rs)
 {
   assem_debug("imul %%%s",regname[rs]);
+  output_rex_opt(0,0,0,rs);
   output_byte(0xF7);
-  output_modrm(3,rs,5);
+  output_modrm(3,rs&7,5);
 }
 static void emit_div(int rs)
 {
   assem_debug("div %%%s",regname[rs]);
+  output_rex_opt(0,0,0,rs);
   output_byte(0xF7);
-  output_modrm(3,rs,6);
+  output_modrm(3,rs&7,6);
 }
 static void emit_idiv(int rs)
 {
   assem_debug("idiv %%%s",regname[rs]);
+  output_rex_opt(0,0,0,rs);
   output_byte(0xF7);
-  output_modrm(3,rs,7);
+  output_modrm(3,rs&7,7);
 }
 static void emit_cdq(void)
 {
@@ -2598,16 +2453,16 @@ static void emit_cmpmem_indexedsr12_imm(int addr,int r,int imm)
 static void emit_cmpmem_indexedsr12_reg(int base,int r,int imm)
 {
   assert(imm<128&&imm>=-127);
-  assert(r>=0&&r<8);
+  assert(r>=0&&r<16);
   emit_shrimm(r,12,r);
   assem_debug("cmp $%d,(%%%s,%%%s)",imm,regname[r],regname[base]);
-  output_byte(0x80);
-  output_modrm(0,4,7);
   assert(r!=base);
-  if(r!=EBP) {
-    output_sib(0,base,r);
+  output_rex_opt(0,0,((r&7)!=EBP)?base:r,((r&7)!=EBP)?r:base);
+  output_byte(0x80);
+  if((r&7)!=EBP) {
+    output_modrm_sib(0,r,base,0,7);
   }else{
-    output_sib(0,r,base);
+    output_modrm_sib(0,base,r,0,7);
   }
   output_byte(imm);
 }
@@ -2615,33 +2470,24 @@ static void emit_cmpmem_indexedsr12_reg(int base,int r,int imm)
 // special case for checking hash_table
 static void emit_cmpmem_dualindexed(int base,int rs,int rt)
 {
-  assert(rs>=0&&rs<8);
-  assert(rt>=0&&rt<8);
+  assert(rs>=0&&rs<16);
+  assert(rt>=0&&rt<16);
   assert(base==HOST_TEMPREG);
   assem_debug("cmp (%%%s,%%%s),%%%s",regname[rs],regname[base],regname[rt]);
-  output_rex(0,0,0,base>>3);
+  output_rex_opt(0,rt,rs,base);
   output_byte(0x3B);
-  output_modrm(0,4,rt);
-  output_sib(0,rs,base&7);
+  output_modrm_sib(0,base,rs,0,rt);
 }
 static void emit_readdword_dualindexed(int offset, int base,int rs,int rt)
 {
-  assert(rs>=0&&rs<8);
-  assert(rt>=0&&rt<8);
+  assert(rs>=0&&rs<16);
+  assert(rt>=0&&rt<16);
   assert(base==HOST_TEMPREG);
   assert(offset<128&&offset>=-128);
   assem_debug("mov %x(%%%s,%%%s),%%%s",offset,regname[rs],regname[base],regname[rt]);
-  output_rex(1,0,0,base>>3);
+  output_rex(1,rt>>3,rs>>3,base>>3);
   output_byte(0x8B);
-  if(offset==0) {
-    output_modrm(0,4,rt);
-    output_sib(0,rs,base&7);
-  }
-  else if(offset<128&&offset>=-128) {
-    output_modrm(1,4,rt);
-    output_sib(0,rs,base&7);
-    output_byte(offset);
-  }
+  output_modrm_sib(offset,base,rs,0,rt);
 }
 
 // special case for checking memory_map in verify_mapping
@@ -2687,16 +2533,16 @@ static void emit_readptr(intptr_t addr, int rt)
 static void emit_flds(int r)
 {
   assem_debug("flds (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xd9);
-  if(r!=EBP) output_modrm(0,r,0);
-  else {output_modrm(1,EBP,0);output_byte(0);}
+  output_modrm_disp(0,r,0);
 }
 static void emit_fldl(int r)
 {
   assem_debug("fldl (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdd);
-  if(r!=EBP) output_modrm(0,r,0);
-  else {output_modrm(1,EBP,0);output_byte(0);}
+  output_modrm_disp(0,r,0);
 }
 static void emit_fucomip(u_int r)
 {
@@ -2726,16 +2572,16 @@ static void emit_fsqrt(void)
 static void emit_fadds(int r)
 {
   assem_debug("fadds (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xd8);
-  if(r!=EBP) output_modrm(0,r,0);
-  else {output_modrm(1,EBP,0);output_byte(0);}
+  output_modrm_disp(0,r,0);
 }
 static void emit_faddl(int r)
 {
   assem_debug("faddl (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdc);
-  if(r!=EBP) output_modrm(0,r,0);
-  else {output_modrm(1,EBP,0);output_byte(0);}
+  output_modrm_disp(0,r,0);
 }
 static void emit_fadd(int r)
 {
@@ -2746,16 +2592,16 @@ static void emit_fadd(int r)
 static void emit_fsubs(int r)
 {
   assem_debug("fsubs (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xd8);
-  if(r!=EBP) output_modrm(0,r,4);
-  else {output_modrm(1,EBP,4);output_byte(0);}
+  output_modrm_disp(0,r,4);
 }
 static void emit_fsubl(int r)
 {
   assem_debug("fsubl (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdc);
-  if(r!=EBP) output_modrm(0,r,4);
-  else {output_modrm(1,EBP,4);output_byte(0);}
+  output_modrm_disp(0,r,4);
 }
 static void emit_fsub(int r)
 {
@@ -2766,16 +2612,16 @@ static void emit_fsub(int r)
 static void emit_fmuls(int r)
 {
   assem_debug("fmuls (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xd8);
-  if(r!=EBP) output_modrm(0,r,1);
-  else {output_modrm(1,EBP,1);output_byte(0);}
+  output_modrm_disp(0,r,1);
 }
 static void emit_fmull(int r)
 {
   assem_debug("fmull (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdc);
-  if(r!=EBP) output_modrm(0,r,1);
-  else {output_modrm(1,EBP,1);output_byte(0);}
+  output_modrm_disp(0,r,1);
 }
 static void emit_fmul(int r)
 {
@@ -2786,16 +2632,16 @@ static void emit_fmul(int r)
 static void emit_fdivs(int r)
 {
   assem_debug("fdivs (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xd8);
-  if(r!=EBP) output_modrm(0,r,6);
-  else {output_modrm(1,EBP,6);output_byte(0);}
+  output_modrm_disp(0,r,6);
 }
 static void emit_fdivl(int r)
 {
   assem_debug("fdivl (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdc);
-  if(r!=EBP) output_modrm(0,r,6);
-  else {output_modrm(1,EBP,6);output_byte(0);}
+  output_modrm_disp(0,r,6);
 }
 static void emit_fdiv(int r)
 {
@@ -2813,44 +2659,44 @@ static void emit_fpop(void)
 static void emit_fildl(int r)
 {
   assem_debug("fildl (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdb);
-  if(r!=EBP) output_modrm(0,r,0);
-  else {output_modrm(1,EBP,0);output_byte(0);}
+  output_modrm_disp(0,r,0);
 }
 static void emit_fildll(int r)
 {
   assem_debug("fildll (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdf);
-  if(r!=EBP) output_modrm(0,r,5);
-  else {output_modrm(1,EBP,5);output_byte(0);}
+  output_modrm_disp(0,r,5);
 }
 static void emit_fistpl(int r)
 {
   assem_debug("fistpl (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdb);
-  if(r!=EBP) output_modrm(0,r,3);
-  else {output_modrm(1,EBP,3);output_byte(0);}
+  output_modrm_disp(0,r,3);
 }
 static void emit_fistpll(int r)
 {
   assem_debug("fistpll (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdf);
-  if(r!=EBP) output_modrm(0,r,7);
-  else {output_modrm(1,EBP,7);output_byte(0);}
+  output_modrm_disp(0,r,7);
 }
 static void emit_fstps(int r)
 {
   assem_debug("fstps (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xd9);
-  if(r!=EBP) output_modrm(0,r,3);
-  else {output_modrm(1,EBP,3);output_byte(0);}
+  output_modrm_disp(0,r,3);
 }
 static void emit_fstpl(int r)
 {
   assem_debug("fstpl (%%%s)",regname[r]);
+  output_rex_opt(0,0,0,r);
   output_byte(0xdd);
-  if(r!=EBP) output_modrm(0,r,3);
-  else {output_modrm(1,EBP,3);output_byte(0);}
+  output_modrm_disp(0,r,3);
 }
 static void emit_fnstcw_stack(void)
 {
@@ -2879,10 +2725,9 @@ static void emit_fldcw_indexedx4(int addr, int r)
 {
   assem_debug("fldcw (%%%s,%%%s,4)",regname[addr],regname[r]);
   assert(addr==HOST_TEMPREG);
-  output_rex(0,0,0,addr>>3);
+  output_rex_opt(0,0,r,addr);
   output_byte(0xd9);
-  output_modrm(0,4,5);
-  output_sib(2,r,addr&7);
+  output_modrm_sib(0,addr,r,2,5);
 }
 static void emit_fldcw(intptr_t addr)
 {
@@ -2897,30 +2742,30 @@ static void emit_movss_load(u_int addr,u_int ssereg)
   assem_debug("movss (%%%s),xmm%d",regname[addr],ssereg);
   assert(ssereg<8);
   output_byte(0xf3);
+  output_rex_opt(0,0,0,addr);
   output_byte(0x0f);
   output_byte(0x10);
-  if(addr!=EBP) output_modrm(0,addr,ssereg);
-  else {output_modrm(1,EBP,ssereg);output_byte(0);}
+  output_modrm_disp(0,addr,ssereg);
 }
 static void emit_movsd_load(u_int addr,u_int ssereg)
 {
   assem_debug("movsd (%%%s),xmm%d",regname[addr],ssereg);
   assert(ssereg<8);
   output_byte(0xf2);
+  output_rex_opt(0,0,0,addr);
   output_byte(0x0f);
   output_byte(0x10);
-  if(addr!=EBP) output_modrm(0,addr,ssereg);
-  else {output_modrm(1,EBP,ssereg);output_byte(0);}
+  output_modrm_disp(0,addr,ssereg);
 }
 static void emit_movd_store(u_int ssereg,u_int addr)
 {
   assem_debug("movd xmm%d,(%%%s)",ssereg,regname[addr]);
   assert(ssereg<8);
   output_byte(0x66);
+  output_rex_opt(0,0,0,addr);
   output_byte(0x0f);
   output_byte(0x7e);
-  if(addr!=EBP) output_modrm(0,addr,ssereg);
-  else {output_modrm(1,EBP,ssereg);output_byte(0);}
+  output_modrm_disp(0,addr,ssereg);
 }
 static void emit_cvttps2dq(u_int ssereg1,u_int ssereg2)
 {
@@ -2964,7 +2809,7 @@ static void save_regs2(u_int reglist)
   reglist&=~(1<<ESP);
   int count=count_bits(reglist);
   if(count) {
-    for(hr=0;hr<HOST_REGS*2;hr++) {
+    for(hr=0;hr<16;hr++) {
       if(hr!=EXCLUDE_REG) {
         if((reglist>>hr)&1) {
           emit_pushreg(hr);
@@ -2981,10 +2826,10 @@ static void restore_regs2(u_int reglist)
   int hr;
   reglist&=~(1<<ESP);
   int count=count_bits(reglist);
-  assert(count<=8);
+  assert(count<=12); // leave room for the Win64 shadow space
   emit_addimm64(ESP,(16-count)*8,ESP);
   if(count) {
-    for(hr=(HOST_REGS*2)-1;hr>=0;hr--) {
+    for(hr=15;hr>=0;hr--) {
       if(hr!=EXCLUDE_REG) {
         if((reglist>>hr)&1) {
           emit_popreg(hr);
@@ -4247,8 +4092,13 @@ static void multdiv_assemble_x64(int i,struct regstat *i_regs)
 }
 #define multdiv_assemble multdiv_assemble_x64
 
+// On x64 the mini_ht hooks implement a return address stack (ras) instead
+// of a hash.  JAL/JALR push {return address, host address} and JR $ra pops
+// the top entry, jumping straight to it if the guest address matches.
+#define RAS_MASK (sizeof(g_dev.r4300.new_dynarec_hot_state.ras)-1)
+
 static void do_preload_rhash(int r) {
-  emit_movimm(0x1f0,r);
+  emit_readword((intptr_t)&g_dev.r4300.new_dynarec_hot_state.ras_top,r);
 }
 
 static void do_preload_rhtbl(int r) {
@@ -4256,7 +4106,7 @@ static void do_preload_rhtbl(int r) {
 }
 
 static void do_rhash(int rs,int rh) {
-  emit_and(rs,rh,rh);
+  // ras_top is already a byte offset
 }
 
 static void do_miniht_load(int ht,int rh) {
@@ -4265,7 +4115,12 @@ static void do_miniht_load(int ht,int rh) {
 }
 
 static void do_miniht_jump(int rs,int rh,int ht) {
-  emit_lea_rip((intptr_t)g_dev.r4300.new_dynarec_hot_state.mini_ht,HOST_TEMPREG);
+  // Pop, whether or not the prediction turns out to be right
+  emit_mov(rh,HOST_TEMPREG);
+  emit_addimm(HOST_TEMPREG,-16,HOST_TEMPREG);
+  emit_andimm(HOST_TEMPREG,RAS_MASK,HOST_TEMPREG);
+  emit_writeword(HOST_TEMPREG,(intptr_t)&g_dev.r4300.new_dynarec_hot_state.ras_top);
+  emit_lea_rip((intptr_t)g_dev.r4300.new_dynarec_hot_state.ras,HOST_TEMPREG);
   emit_cmpmem_dualindexed(HOST_TEMPREG,rh,rs);
   emit_jne(jump_vaddr_reg[rs]);
   emit_readdword_dualindexed(8,HOST_TEMPREG,rh,rh);
@@ -4273,11 +4128,18 @@ static void do_miniht_jump(int rs,int rh,int ht) {
 }
 
 static void do_miniht_insert(int return_address,int rt,int temp) {
-  emit_movimm(return_address,rt); // PC into link register
-  emit_writeword(rt,(intptr_t)&g_dev.r4300.new_dynarec_hot_state.mini_ht[(return_address&0x1FF)>>4][0]);
+  emit_readword((intptr_t)&g_dev.r4300.new_dynarec_hot_state.ras_top,temp);
+  emit_addimm(temp,16,temp);
+  emit_andimm(temp,RAS_MASK,temp);
+  emit_writeword(temp,(intptr_t)&g_dev.r4300.new_dynarec_hot_state.ras_top);
+  emit_lea_rip((intptr_t)g_dev.r4300.new_dynarec_hot_state.ras,rt);
+  emit_leairrx1(0,rt,temp,rt);
+  emit_movimm(return_address,temp);
+  emit_writeword_indexed(temp,0,rt);
   add_to_linker((intptr_t)out,return_address,1);
   emit_movimm64(0,temp);
-  emit_writedword(temp,(intptr_t)&g_dev.r4300.new_dynarec_hot_state.mini_ht[(return_address&0x1FF)>>4][1]);
+  emit_writedword_indexed(temp,8,rt);
+  emit_movimm(return_address,rt); // PC into link register
 }
 
 // We don't need this for x64
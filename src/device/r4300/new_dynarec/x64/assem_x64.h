@@ -27,7 +27,7 @@
 #define R14 14
 #define R15 15
 
-#define HOST_REGS 8
+#define HOST_REGS 15 // R15 is HOST_TEMPREG and never allocated
 #define HOST_BTREG EBP
 #define EXCLUDE_REG ESP
 #define HOST_TEMPREG R15
@@ -40,6 +40,7 @@
 //#define DESTRUCTIVE_WRITEBACK 1
 #define DESTRUCTIVE_SHIFT 1
 #define USE_MINI_HT 1
+#define USE_RETURN_STACK 1 // The mini_ht hooks drive a return address stack
 
 #define TARGET_SIZE_2 25 // 2^25 = 32 megabytes
 #define JUMP_TABLE_SIZE 0 // Not needed for x86
@@ -82,6 +82,13 @@ cglobal jump_vaddr_ebx
 cglobal jump_vaddr_ebp
 cglobal jump_vaddr_esi
 cglobal jump_vaddr_edi
+cglobal jump_vaddr_r8
+cglobal jump_vaddr_r9
+cglobal jump_vaddr_r10
+cglobal jump_vaddr_r11
+cglobal jump_vaddr_r12
+cglobal jump_vaddr_r13
+cglobal jump_vaddr_r14
 cglobal verify_code
 cglobal cc_interrupt
 cglobal do_interrupt
@@ -96,6 +103,13 @@ cglobal invalidate_block_ebx
 cglobal invalidate_block_ebp
 cglobal invalidate_block_esi
 cglobal invalidate_block_edi
+cglobal invalidate_block_r8
+cglobal invalidate_block_r9
+cglobal invalidate_block_r10
+cglobal invalidate_block_r11
+cglobal invalidate_block_r12
+cglobal invalidate_block_r13
+cglobal invalidate_block_r14
 cglobal breakpoint
 cglobal dyna_linker
 cglobal dyna_linker_ds
@@ -154,6 +168,34 @@ jump_vaddr_esi:
     jmp     jump_vaddr
 %endif
 
+jump_vaddr_r8:
+    mov     ARG1_REG,    r8d
+    jmp     jump_vaddr
+
+jump_vaddr_r9:
+    mov     ARG1_REG,    r9d
+    jmp     jump_vaddr
+
+jump_vaddr_r10:
+    mov     ARG1_REG,    r10d
+    jmp     jump_vaddr
+
+jump_vaddr_r11:
+    mov     ARG1_REG,    r11d
+    jmp     jump_vaddr
+
+jump_vaddr_r12:
+    mov     ARG1_REG,    r12d
+    jmp     jump_vaddr
+
+jump_vaddr_r13:
+    mov     ARG1_REG,    r13d
+    jmp     jump_vaddr
+
+jump_vaddr_r14:
+    mov     ARG1_REG,    r14d
+    jmp     jump_vaddr
+
 jump_vaddr_ecx:
     mov     ARG1_REG,    ecx
 
@@ -229,7 +271,9 @@ fp_exception:
 
 jump_syscall:
     mov     DWORD[rel g_dev_r4300_new_dynarec_hot_state_pcaddr],    eax
+    mov     DWORD[rel g_dev_r4300_new_dynarec_hot_state_cycle_count],    CCREG
     call    SYSCALL_new
+    mov     CCREG,    DWORD[rel g_dev_r4300_new_dynarec_hot_state_cycle_count]
     jmp     rax
 
 jump_eret:
@@ -291,6 +335,34 @@ invalidate_block_esi:
     mov     ARG1_REG,    esi
     jmp     invalidate_block_call
 
+invalidate_block_r8:
+    mov     ARG1_REG,    r8d
+    jmp     invalidate_block_call
+
+invalidate_block_r9:
+    mov     ARG1_REG,    r9d
+    jmp     invalidate_block_call
+
+invalidate_block_r10:
+    mov     ARG1_REG,    r10d
+    jmp     invalidate_block_call
+
+invalidate_block_r11:
+    mov     ARG1_REG,    r11d
+    jmp     invalidate_block_call
+
+invalidate_block_r12:
+    mov     ARG1_REG,    r12d
+    jmp     invalidate_block_call
+
+invalidate_block_r13:
+    mov     ARG1_REG,    r13d
+    jmp     invalidate_block_call
+
+invalidate_block_r14:
+    mov     ARG1_REG,    r14d
+    jmp     invalidate_block_call
+
 invalidate_block_ecx:
     mov     ARG1_REG,    ecx
 
@@ -220,7 +220,9 @@ fp_exception:
 jump_syscall:
     get_got_address
     mov     [find_local_data(g_dev_r4300_new_dynarec_hot_state_pcaddr)],    eax
+    mov     [find_local_data(g_dev_r4300_new_dynarec_hot_state_cycle_count)],    esi
     call    SYSCALL_new
+    mov     esi,    [find_local_data(g_dev_r4300_new_dynarec_hot_state_cycle_count)]
     jmp     eax
 
 jump_eret:
@@ -766,6 +766,60 @@ void InterpretOpcode(struct r4300_core* r4300)
 	} /* switch ((op >> 26) & 0x3F) */
 }
 
+static osal_inline void run_hooks(struct r4300_core* r4300, unsigned int hooks)
+{
+#ifdef COMPARE_CORE
+   if (hooks & R4300_HOOK_COMPARE_CORE) CoreCompareCallback();
+#endif
+#ifdef DBG
+   if (hooks & R4300_HOOK_DEBUGGER) update_debugger(*r4300_pc(r4300));
+#endif
+}
+
+/* One loop per hook combination; returns when the active set changes */
+#define PURE_INTERP_LOOP(HOOKS) \
+   static void pure_interp_loop_##HOOKS(struct r4300_core* r4300) \
+   { \
+      while (!*r4300_stop(r4300) && r4300->hooks == HOOKS) \
+      { \
+         run_hooks(r4300, HOOKS); \
+         if ((HOOKS & R4300_HOOK_NATIVE_CALLS) && r4300_do_native_call(r4300, *r4300_pc(r4300))) continue; \
+         InterpretOpcode(r4300); \
+         gInstructionsPerFrame++; \
+         if (HOOKS & R4300_HOOK_CODE_CALLBACKS) r4300_ml64_do_code_callbacks(r4300); \
+      } \
+   }
+
+PURE_INTERP_LOOP(0)
+PURE_INTERP_LOOP(1)
+PURE_INTERP_LOOP(2)
+PURE_INTERP_LOOP(3)
+PURE_INTERP_LOOP(4)
+PURE_INTERP_LOOP(5)
+PURE_INTERP_LOOP(6)
+PURE_INTERP_LOOP(7)
+PURE_INTERP_LOOP(8)
+PURE_INTERP_LOOP(9)
+PURE_INTERP_LOOP(10)
+PURE_INTERP_LOOP(11)
+PURE_INTERP_LOOP(12)
+PURE_INTERP_LOOP(13)
+PURE_INTERP_LOOP(14)
+PURE_INTERP_LOOP(15)
+
+static void (*const pure_interp_loops[R4300_HOOK_COUNT])(struct r4300_core* r4300) =
+{
+   pure_interp_loop_0, pure_interp_loop_1, pure_interp_loop_2, pure_interp_loop_3,
+   pure_interp_loop_4, pure_interp_loop_5, pure_interp_loop_6, pure_interp_loop_7,
+   pure_interp_loop_8, pure_interp_loop_9, pure_interp_loop_10, pure_interp_loop_11,
+   pure_interp_loop_12, pure_interp_loop_13, pure_interp_loop_14, pure_interp_loop_15
+};
+
+void pure_interp_step(struct r4300_core* r4300)
+{
+   InterpretOpcode(r4300);
+}
+
 void run_pure_interpreter(struct r4300_core* r4300)
 {
    *r4300_stop(r4300) = 0;
@@ -774,14 +828,6 @@ void run_pure_interpreter(struct r4300_core* r4300)
 
    while (!*r4300_stop(r4300))
    {
-#ifdef COMPARE_CORE
-     CoreCompareCallback();
-#endif
-#ifdef DBG
-     if (g_DebuggerActive) update_debugger(*r4300_pc(r4300));
-#endif
-     InterpretOpcode(r4300);
-	 gInstructionsPerFrame++;
-	 r4300_ml64_do_code_callbacks(r4300);
+      pure_interp_loops[r4300->hooks](r4300);
    }
 }
@@ -26,4 +26,7 @@ struct r4300_core;
 
 void run_pure_interpreter(struct r4300_core* r4300);
 
+/* Run the instruction at pc (with its delay slot), without the hooks */
+void pure_interp_step(struct r4300_core* r4300);
+
 #endif /* M64P_DEVICE_R4300_PURE_INTERP_H */
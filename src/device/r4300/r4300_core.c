@@ -24,6 +24,8 @@
 #if defined(COUNT_INSTR)
 #include "instr_counters.h"
 #endif
+#include "libultra_hle.h"
+#include "lockstep.h"
 #include "new_dynarec/new_dynarec.h"
 #include "pure_interp.h"
 #include "recomp.h"
@@ -32,6 +34,7 @@
 #include "api/debugger.h"
 #include "api/m64p_types.h"
 #ifdef DBG
+#include "debugger/dbg_breakpoints.h"
 #include "debugger/dbg_debugger.h"
 #endif
 #include "main/main.h"
@@ -43,7 +46,7 @@
 #include "api/memoryexport.h"
 
 void init_r4300(struct r4300_core* r4300, struct memory* mem, struct mi_controller* mi, struct rdram* rdram, const struct interrupt_handler* interrupt_handlers,
-    unsigned int emumode, unsigned int count_per_op, unsigned int count_per_op_denom_pot, int no_compiled_jump, int randomize_interrupt, uint32_t start_address)
+    unsigned int emumode, unsigned int count_per_op, unsigned int count_per_op_denom_pot, int no_compiled_jump, int randomize_interrupt, int libultra_hle, uint32_t start_address)
 {
     struct new_dynarec_hot_state* new_dynarec_hot_state =
 #ifdef NEW_DYNAREC
@@ -65,6 +68,8 @@ void init_r4300(struct r4300_core* r4300, struct memory* mem, struct mi_controll
     r4300->mi = mi;
     r4300->rdram = rdram;
     r4300->randomize_interrupt = randomize_interrupt;
+    r4300->libultra_hle = libultra_hle;
+    r4300->lockstep = NULL;
     r4300->start_address = start_address;
     srand((unsigned int) time(NULL));
 }
@@ -123,6 +128,8 @@ void poweron_r4300(struct r4300_core* r4300)
 
     /* setup CP2 registers */
     poweron_cp2(&r4300->cp2);
+
+    lockstep_reset(r4300);
 }
 
 
@@ -136,7 +143,8 @@ void run_r4300(struct r4300_core* r4300)
 #endif
 
     *r4300_stop(r4300) = 0;
-    g_rom_pause = 0;
+    main_unpause();
+    r4300_update_hooks(r4300);
 
     /* clear instruction counters */
 #if defined(COUNT_INSTR)
@@ -155,6 +163,12 @@ void run_r4300(struct r4300_core* r4300)
         DebugMessage(M64MSG_INFO, "Starting R4300 emulator: Dynamic Recompiler");
         r4300->emumode = EMUMODE_DYNAREC;
         init_blocks(&r4300->cached_interp);
+#ifdef DBG
+        /* the recompilers only stop at breakpoints: give the front-end
+         * the chance to set them before any code is compiled */
+        if (g_DebuggerActive)
+            update_debugger(r4300->start_address);
+#endif
 #ifdef NEW_DYNAREC
         new_dynarec_init();
         new_dyna_start();
@@ -424,6 +438,32 @@ void invalidate_r4300_cached_code(struct r4300_core* r4300, uint32_t address, si
     }
 }
 
+void invalidate_r4300_cached_code_dma(struct r4300_core* r4300, uint32_t dram_addr, size_t size)
+{
+    invalidate_r4300_cached_code(r4300, R4300_KSEG0 + dram_addr, size);
+    invalidate_r4300_cached_code(r4300, R4300_KSEG1 + dram_addr, size);
+
+#ifdef NEW_DYNAREC
+    /* Identical reloads (overlays) get their blocks back without recompiling */
+    if (r4300->emumode == EMUMODE_DYNAREC)
+    {
+        restore_cached_code_new_dynarec(r4300, R4300_KSEG0 + dram_addr, size);
+    }
+#endif
+}
+
+void discard_r4300_cached_code(struct r4300_core* r4300, uint32_t address, size_t size)
+{
+#ifdef NEW_DYNAREC
+    if (r4300->emumode == EMUMODE_DYNAREC)
+    {
+        discard_cached_code_new_dynarec(r4300, address, size);
+        return;
+    }
+#endif
+    invalidate_r4300_cached_code(r4300, address, size);
+}
+
 
 void generic_jump_to(struct r4300_core* r4300, uint32_t address)
 {
@@ -456,10 +496,44 @@ void generic_jump_to(struct r4300_core* r4300, uint32_t address)
 
 
 /* XXX: not really a good interface but it gets the job done... */
-void savestates_load_set_pc(struct r4300_core* r4300, uint32_t pc)
+static int page_changed(const uint32_t* changed_pages, size_t page_count, uint32_t page)
 {
+    return page < page_count && (changed_pages[page >> 5] & (UINT32_C(1) << (page & 31)));
+}
+
+void savestates_load_set_pc(struct r4300_core* r4300, uint32_t pc, const uint32_t* changed_pages, size_t page_count)
+{
+    uint32_t page;
+    uint32_t lut;
+
+    lockstep_reset(r4300);
+
+    if (changed_pages == NULL || r4300->emumode == EMUMODE_PURE_INTERPRETER)
+    {
+        generic_jump_to(r4300, pc);
+        invalidate_r4300_cached_code(r4300, 0, 0);
+        return;
+    }
+
+    for (page = 0; page < page_count; ++page)
+    {
+        if (page_changed(changed_pages, page_count, page))
+            invalidate_r4300_cached_code_dma(r4300, page << 12, 0x1000);
+    }
+
+    /* TLB mapped views of the changed pages */
+    for (page = 0; page < 0x100000; ++page)
+    {
+        if (page == 0x80000)
+            page = 0xc0000;
+
+        lut = r4300->cp0.tlb.LUT_r[page];
+        if (lut != 0 && page_changed(changed_pages, page_count, ((lut & UINT32_C(0xfffff000)) - R4300_KSEG0) >> 12))
+            invalidate_r4300_cached_code(r4300, page << 12, 0x1000);
+    }
+
+    /* Only now, so the block containing pc is decoded from the new contents */
     generic_jump_to(r4300, pc);
-    invalidate_r4300_cached_code(r4300, 0, 0);
 }
 
 void r4300_ml64_do_code_callbacks(struct r4300_core* r4300) {
@@ -472,3 +546,64 @@ void r4300_ml64_do_code_callbacks(struct r4300_core* r4300) {
         node = node->next;
     }
 }
+
+int r4300_has_native_call(struct r4300_core* r4300, uint32_t address)
+{
+    if ((r4300->hooks & R4300_HOOK_NATIVE_CALLS) && FindNativeReplacement(address) != NULL)
+        return 1;
+
+    return r4300->libultra_hle && libultra_hle_match(r4300, address) != LIBULTRA_HLE_NONE;
+}
+
+int r4300_do_native_call(struct r4300_core* r4300, uint32_t address)
+{
+    int64_t* regs = r4300_regs(r4300);
+    Ml64_NativeFn pfn = FindNativeReplacement(address);
+    enum libultra_hle_routine routine = LIBULTRA_HLE_NONE;
+
+    if (pfn == NULL) {
+        if (r4300->libultra_hle)
+            routine = libultra_hle_match(r4300, address);
+        if (routine == LIBULTRA_HLE_NONE)
+            return 0;
+    }
+
+    cp0_update_count(r4300);
+    if (pfn != NULL)
+        pfn((u64*)regs);
+    else
+        libultra_hle_run(r4300, routine);
+    regs[0] = 0;
+
+    generic_jump_to(r4300, (uint32_t)regs[31]);
+    r4300->cp0.last_addr = *r4300_pc(r4300);
+    return 1;
+}
+
+int r4300_has_exec_breakpoint(struct r4300_core* r4300, uint32_t address)
+{
+#ifdef DBG
+    return (r4300->hooks & R4300_HOOK_DEBUGGER) && check_breakpoints(address) != -1;
+#else
+    return 0;
+#endif
+}
+
+void r4300_update_hooks(struct r4300_core* r4300)
+{
+    unsigned int hooks = 0;
+
+#ifdef COMPARE_CORE
+    hooks |= R4300_HOOK_COMPARE_CORE;
+#endif
+#ifdef DBG
+    if (g_DebuggerActive)
+        hooks |= R4300_HOOK_DEBUGGER;
+#endif
+    if (g_ml64_codecallback_head != NULL)
+        hooks |= R4300_HOOK_CODE_CALLBACKS;
+    if (g_ml64_native_count != 0)
+        hooks |= R4300_HOOK_NATIVE_CALLS;
+
+    r4300->hooks = hooks;
+}
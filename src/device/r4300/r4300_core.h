@@ -42,6 +42,7 @@
 struct memory;
 struct mi_controller;
 struct rdram;
+struct lockstep;
 
 struct jump_table;
 struct cached_interp
@@ -187,6 +188,15 @@ struct r4300_core
 
     unsigned int emumode;
 
+    /* R4300_HOOK_* work the interpreters do between instructions */
+    unsigned int hooks;
+
+    /* run recognized libultra routines natively (see libultra_hle.h) */
+    int libultra_hle;
+
+    /* pure interpreter the recompiler is checked against (see lockstep.h), or NULL */
+    struct lockstep* lockstep;
+
     struct cp0 cp0;
 
     struct cp1 cp1;
@@ -205,6 +215,14 @@ struct r4300_core
 #define R4300_KSEG0 UINT32_C(0x80000000)
 #define R4300_KSEG1 UINT32_C(0xa0000000)
 
+/* Per-instruction hooks. Interpreter loops are specialized for each
+ * combination and switch when r4300_update_hooks() changes the set. */
+#define R4300_HOOK_COMPARE_CORE     0x1
+#define R4300_HOOK_DEBUGGER         0x2
+#define R4300_HOOK_CODE_CALLBACKS   0x4
+#define R4300_HOOK_NATIVE_CALLS     0x8
+#define R4300_HOOK_COUNT            16
+
 #ifndef NEW_DYNAREC
 #define R4300_REGS_OFFSET \
     offsetof(struct r4300_core, regs)
@@ -214,7 +232,7 @@ struct r4300_core
     offsetof(struct new_dynarec_hot_state, regs))
 #endif
 
-void init_r4300(struct r4300_core* r4300, struct memory* mem, struct mi_controller* mi, struct rdram* rdram, const struct interrupt_handler* interrupt_handlers, unsigned int emumode, unsigned int count_per_op, unsigned int count_per_op_denom_pot, int no_compiled_jump, int randomize_interrupt, uint32_t start_address);
+void init_r4300(struct r4300_core* r4300, struct memory* mem, struct mi_controller* mi, struct rdram* rdram, const struct interrupt_handler* interrupt_handlers, unsigned int emumode, unsigned int count_per_op, unsigned int count_per_op_denom_pot, int no_compiled_jump, int randomize_interrupt, int libultra_hle, uint32_t start_address);
 void poweron_r4300(struct r4300_core* r4300);
 
 void run_r4300(struct r4300_core* r4300);
@@ -247,12 +265,44 @@ int r4300_write_aligned_dword(struct r4300_core* r4300, uint32_t address, uint64
  */
 void invalidate_r4300_cached_code(struct r4300_core* r4300, uint32_t address, size_t size);
 
+/* Invalidate cached code after a DMA wrote size bytes of RDRAM at dram_addr
+ * (both kseg0 and kseg1 views). The data must already be in place.
+ */
+void invalidate_r4300_cached_code_dma(struct r4300_core* r4300, uint32_t dram_addr, size_t size);
+
+/* Like invalidate_r4300_cached_code, but code compiled for the range is
+ * never brought back by checksum either. Use when the way the range gets
+ * compiled changes (native calls, breakpoints) rather than its contents.
+ */
+void discard_r4300_cached_code(struct r4300_core* r4300, uint32_t address, size_t size);
+
 /* Jump to the given address. This works for all r4300 emulator, but is slower.
  * Use this for common code which can be executed from any r4300 emulator. */
 void generic_jump_to(struct r4300_core* r4300, unsigned int address);
 
-void savestates_load_set_pc(struct r4300_core* r4300, uint32_t pc);
+/* Jump to pc after a savestate load. changed_pages has one bit per 4KB
+ * page of RDRAM the load modified; only cached code from those pages is
+ * invalidated. NULL (e.g. when the TLB mappings changed) invalidates all.
+ * Code from other memories the load changed (SP memory) must have been
+ * invalidated by the caller.
+ */
+void savestates_load_set_pc(struct r4300_core* r4300, uint32_t pc, const uint32_t* changed_pages, size_t page_count);
 
 void r4300_ml64_do_code_callbacks(struct r4300_core* r4300);
 
+/* Whether the guest function at address runs natively, either replaced
+ * by a mod or recognized as a libultra routine */
+int r4300_has_native_call(struct r4300_core* r4300, uint32_t address);
+
+/* Run the guest function at address natively, if it can be, and return
+ * to the guest's $ra. Returns 0 when it has to be executed. */
+int r4300_do_native_call(struct r4300_core* r4300, uint32_t address);
+
+/* Whether the recompilers have to stop for the debugger before the
+ * instruction at address */
+int r4300_has_exec_breakpoint(struct r4300_core* r4300, uint32_t address);
+
+/* Recompute r4300->hooks; call after toggling the debugger or code callbacks */
+void r4300_update_hooks(struct r4300_core* r4300);
+
 #endif
@@ -42,6 +42,9 @@
 #include "device/r4300/idec.h"
 #include "device/r4300/recomp_types.h"
 #include "device/r4300/tlb.h"
+#ifdef DBG
+#include "debugger/dbg_debugger.h"
+#endif
 #include "main/main.h"
 #if defined(PROFILE)
 #include "main/profile.h"
@@ -66,6 +69,8 @@ void genlink_subblock(struct r4300_core* r4300);
 void genni(struct r4300_core* r4300);
 void gennotcompiled(struct r4300_core* r4300);
 void genfin_block(struct r4300_core* r4300);
+void gennative_call(struct r4300_core* r4300);
+void genbreakpoint(struct r4300_core* r4300);
 #ifdef COMPARE_CORE
 void gendebug(struct r4300_core* r4300);
 #endif
@@ -681,7 +686,21 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
 
         /* decode instruction */
         opcode = r4300_decode(r4300->recomp.dst, r4300, r4300_get_idec(iw[i]), iw[i], iw[i+1], block);
-        recomp_funcs[opcode](r4300);
+        if (r4300_has_exec_breakpoint(r4300, r4300->recomp.dst->addr))
+        {
+            /* stop for the debugger before the instruction runs */
+            genbreakpoint(r4300);
+        }
+        if (r4300_has_native_call(r4300, r4300->recomp.dst->addr))
+        {
+            /* the guest function runs natively: call out and return to $ra */
+            gennative_call(r4300);
+            opcode = R4300_OP_NOP;
+        }
+        else
+        {
+            recomp_funcs[opcode](r4300);
+        }
 
         if (r4300->recomp.delay_slot_compiled)
         {
@@ -911,6 +930,31 @@ void dynarec_jump_to_recomp_address(void)
     dynarec_jump_to(r4300, r4300->recomp.jump_to_address);
 }
 
+/* Runs the native replacement of the guest function entered at PC */
+void dynarec_native_call(void)
+{
+    struct r4300_core* r4300 = &g_dev.r4300;
+    uint32_t address = *r4300_pc(r4300);
+
+    if (!r4300_do_native_call(r4300, address))
+    {
+        /* the native version is gone: recompile the block without it */
+        invalidate_r4300_cached_code(r4300, address, 4);
+        dynarec_jump_to(r4300, address);
+    }
+}
+
+/* Hands over to the debugger at an execution breakpoint compiled into the block */
+void dynarec_breakpoint(void)
+{
+#ifdef DBG
+    struct r4300_core* r4300 = &g_dev.r4300;
+
+    cp0_update_count(r4300);
+    update_debugger(*r4300_pc(r4300));
+#endif
+}
+
 /* Parameterless version of exception_general to ease usage in dynarec. */
 void dynarec_exception_general(void)
 {
@@ -44,6 +44,8 @@ void dynarec_notcompiled(void);
 void dynarec_notcompiled2(void);
 void dynarec_setup_code(void);
 void dynarec_jump_to_recomp_address(void);
+void dynarec_native_call(void);
+void dynarec_breakpoint(void);
 void dynarec_exception_general(void);
 int dynarec_check_cop1_unusable(void);
 void dynarec_cp0_update_count(void);
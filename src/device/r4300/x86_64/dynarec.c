@@ -364,6 +364,16 @@ void genfin_block(struct r4300_core* r4300)
     gencallinterp(r4300, (unsigned long long)dynarec_fin_block, 0);
 }
 
+void gennative_call(struct r4300_core* r4300)
+{
+    gencallinterp(r4300, (unsigned long long)dynarec_native_call, 0);
+}
+
+void genbreakpoint(struct r4300_core* r4300)
+{
+    gencallinterp(r4300, (unsigned long long)dynarec_breakpoint, 0);
+}
+
 /* Reserved */
 
 void gen_RESERVED(struct r4300_core* r4300)
@@ -25,6 +25,7 @@
 #include "api/callbacks.h"
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
+#include "device/rcp/rsp/rsp_core.h"
 #include "device/rdram/rdram.h"
 #include "osal/preproc.h"
 #include "plugin/plugin.h"
@@ -101,11 +102,13 @@ void post_framebuffer_write(struct fb* fb, uint32_t address, uint32_t length)
 void init_fb(struct fb* fb,
              struct memory* mem,
              struct rdram* rdram,
-             struct r4300_core* r4300)
+             struct r4300_core* r4300,
+             struct rsp_core* sp)
 {
     fb->mem = mem;
     fb->rdram = rdram;
     fb->r4300 = r4300;
+    fb->sp = sp;
 }
 
 void poweron_fb(struct fb* fb)
@@ -118,6 +121,7 @@ void poweron_fb(struct fb* fb)
 void read_rdram_fb(void* opaque, uint32_t address, uint32_t* value)
 {
     struct fb* fb = (struct fb*)opaque;
+    rsp_wait_gfx_task(fb->sp);
     pre_framebuffer_read(fb, address);
     read_rdram_dram(fb->rdram, address, value);
 }
@@ -125,6 +129,7 @@ void read_rdram_fb(void* opaque, uint32_t address, uint32_t* value)
 void write_rdram_fb(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
 {
     struct fb* fb = (struct fb*)opaque;
+    rsp_wait_gfx_task(fb->sp);
     write_rdram_dram(fb->rdram, address, value, mask);
 
     uint32_t addr = address & ~0x3;
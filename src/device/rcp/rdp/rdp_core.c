@@ -66,7 +66,7 @@ void init_rdp(struct rdp_core* dp,
     dp->sp = sp;
     dp->mi = mi;
 
-    init_fb(&dp->fb, mem, rdram, r4300);
+    init_fb(&dp->fb, mem, rdram, r4300, sp);
 }
 
 void poweron_rdp(struct rdp_core* dp)
@@ -86,6 +86,8 @@ void read_dpc_regs(void* opaque, uint32_t address, uint32_t* value)
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dpc_reg(address);
 
+    rsp_wait_gfx_task(dp->sp);
+
     *value = dp->dpc_regs[reg];
 }
 
@@ -94,6 +96,8 @@ void write_dpc_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dpc_reg(address);
 
+    rsp_wait_gfx_task(dp->sp);
+
     switch(reg)
     {
     case DPC_STATUS_REG:
@@ -128,6 +132,8 @@ void read_dps_regs(void* opaque, uint32_t address, uint32_t* value)
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dps_reg(address);
 
+    rsp_wait_gfx_task(dp->sp);
+
     *value = dp->dps_regs[reg];
 }
 
@@ -136,6 +142,8 @@ void write_dps_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dps_reg(address);
 
+    rsp_wait_gfx_task(dp->sp);
+
     masked_write(&dp->dps_regs[reg], value, mask);
 }
 
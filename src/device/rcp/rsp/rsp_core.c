@@ -34,6 +34,7 @@
 #include "main/profile.h"
 #endif
 #include "plugin/plugin.h"
+#include "plugin/rsp_thread.h"
 #include "api/callbacks.h"
 #include "api//modloader_common.h"
 
@@ -207,16 +208,21 @@ void init_rsp(struct rsp_core* sp,
               uint32_t* sp_mem,
               struct mi_controller* mi,
               struct rdp_core* dp,
-              struct ri_controller* ri)
+              struct ri_controller* ri,
+              int async_gfx)
 {
     sp->mem = sp_mem;
     sp->mi = mi;
     sp->dp = dp;
     sp->ri = ri;
+    sp->async_gfx = async_gfx;
 }
 
 void poweron_rsp(struct rsp_core* sp)
 {
+    rsp_wait_gfx_task(sp);
+    sp->gfx_task_deadline = 0;
+
     memset(sp->mem, 0, SP_MEM_SIZE);
     memset(sp->regs, 0, SP_REGS_COUNT*sizeof(uint32_t));
     memset(sp->regs2, 0, SP_REGS2_COUNT*sizeof(uint32_t));
@@ -233,6 +239,8 @@ void read_rsp_mem(void* opaque, uint32_t address, uint32_t* value)
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t addr = rsp_mem_address(address);
 
+    rsp_wait_gfx_task(sp);
+
     *value = sp->mem[addr];
 }
 
@@ -241,6 +249,8 @@ void write_rsp_mem(void* opaque, uint32_t address, uint32_t value, uint32_t mask
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t addr = rsp_mem_address(address);
 
+    rsp_wait_gfx_task(sp);
+
     masked_write(&sp->mem[addr], value, mask);
 }
 
@@ -250,6 +260,8 @@ void read_rsp_regs(void* opaque, uint32_t address, uint32_t* value)
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg(address);
 
+    rsp_wait_gfx_task(sp);
+
     *value = sp->regs[reg];
 
     if (reg == SP_SEMAPHORE_REG)
@@ -263,6 +275,8 @@ void write_rsp_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg(address);
 
+    rsp_wait_gfx_task(sp);
+
     switch(reg)
     {
     case SP_STATUS_REG:
@@ -294,6 +308,8 @@ void read_rsp_regs2(void* opaque, uint32_t address, uint32_t* value)
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg2(address);
 
+    rsp_wait_gfx_task(sp);
+
     *value = sp->regs2[reg];
 }
 
@@ -302,15 +318,88 @@ void write_rsp_regs2(void* opaque, uint32_t address, uint32_t value, uint32_t ma
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg2(address);
 
+    rsp_wait_gfx_task(sp);
+
     masked_write(&sp->regs2[reg], value, mask);
 }
 
+static void end_gfx_task(struct rsp_core* sp)
+{
+    new_frame();
+
+    if (sp->mi->regs[MI_INTR_REG] & MI_INTR_DP)
+    {
+        sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_DP;
+        if (sp->dp->dpc_regs[DPC_STATUS_REG] & DPC_STATUS_FREEZE) {
+            sp->dp->do_on_unfreeze |= DELAY_DP_INT;
+        } else {
+            cp0_update_count(sp->mi->r4300);
+            add_interrupt_event(&sp->mi->r4300->cp0, DP_INT, 4000);
+        }
+    }
+
+    protect_framebuffers(&sp->dp->fb);
+}
+
+/* Returns whether the task raises an SP interrupt. Its event is only
+ * scheduled here if one isn't already queued for it. */
+static int end_sp_task(struct rsp_core* sp, uint32_t sp_delay_time, int event_queued)
+{
+    int sp_int = 0;
+
+    sp->rsp_task_locked = 0;
+    sp->mi->r4300->cp0.interrupt_unsafe_state &= ~INTR_UNSAFE_RSP;
+    if ((sp->regs[SP_STATUS_REG] & (SP_STATUS_HALT | SP_STATUS_BROKE)) == 0)
+    {
+        sp->rsp_task_locked = 1;
+        sp->mi->r4300->cp0.interrupt_unsafe_state |= INTR_UNSAFE_RSP;
+        sp->mi->regs[MI_INTR_REG] |= MI_INTR_SP;
+    }
+    if (sp->mi->regs[MI_INTR_REG] & MI_INTR_SP)
+    {
+        if (!event_queued) {
+            cp0_update_count(sp->mi->r4300);
+            add_interrupt_event(&sp->mi->r4300->cp0, SP_INT, sp_delay_time);
+        }
+        sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_SP;
+        sp_int = 1;
+    }
+
+    sp->regs[SP_STATUS_REG] &=
+        ~(SP_STATUS_TASKDONE | SP_STATUS_BROKE | SP_STATUS_HALT);
+
+    return sp_int;
+}
+
 void do_SP_Task(struct rsp_core* sp)
 {
     uint32_t save_pc = sp->regs2[SP_PC_REG] & ~0xfff;
 
     uint32_t sp_delay_time;
 
+    rsp_wait_gfx_task(sp);
+
+    /* Only while the video plugin reports framebuffers: their handlers, as
+     * mapped after the previous task, stay in place and make the CPU wait
+     * for this one when it touches them. That covers the buffers the game
+     * cycles through, not one the plugin hasn't reported yet. The CPU also
+     * waits at the SP interrupt, queued where a synchronous task would
+     * have put it. */
+    if (sp->mem[0xfc0/4] == 1 && sp->async_gfx && rsp_thread_active()
+     && sp->dp->fb.infos[0].addr != 0)
+    {
+        sp->regs2[SP_PC_REG] &= 0xfff;
+        sp->gfx_task_pc = save_pc;
+        sp->gfx_task_pending = 1;
+        sp->mi->r4300->cp0.interrupt_unsafe_state |= INTR_UNSAFE_RSP;
+        rsp_thread_run(0xffffffff);
+
+        sp->gfx_task_deadline = 1;
+        cp0_update_count(sp->mi->r4300);
+        add_interrupt_event(&sp->mi->r4300->cp0, SP_INT, 1000);
+        return;
+    }
+
     if (sp->mem[0xfc0/4] == 1)
     {
         unprotect_framebuffers(&sp->dp->fb);
@@ -325,21 +414,8 @@ void do_SP_Task(struct rsp_core* sp)
         timed_section_end(TIMED_SECTION_GFX);
 #endif
         sp->regs2[SP_PC_REG] |= save_pc;
-        new_frame();
-
-        if (sp->mi->regs[MI_INTR_REG] & MI_INTR_DP)
-        {
-            sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_DP;
-            if (sp->dp->dpc_regs[DPC_STATUS_REG] & DPC_STATUS_FREEZE) {
-                sp->dp->do_on_unfreeze |= DELAY_DP_INT;
-            } else {
-                cp0_update_count(sp->mi->r4300);
-                add_interrupt_event(&sp->mi->r4300->cp0, DP_INT, 4000);
-            }
-        }
+        end_gfx_task(sp);
         sp_delay_time = 1000;
-
-        protect_framebuffers(&sp->dp->fb);
     }
     else if (sp->mem[0xfc0/4] == 2)
     {
@@ -365,29 +441,35 @@ void do_SP_Task(struct rsp_core* sp)
         sp_delay_time = 0;
     }
 
-    sp->rsp_task_locked = 0;
-    sp->mi->r4300->cp0.interrupt_unsafe_state &= ~INTR_UNSAFE_RSP;
-    if ((sp->regs[SP_STATUS_REG] & (SP_STATUS_HALT | SP_STATUS_BROKE)) == 0)
-    {
-        sp->rsp_task_locked = 1;
-        sp->mi->r4300->cp0.interrupt_unsafe_state |= INTR_UNSAFE_RSP;
-        sp->mi->regs[MI_INTR_REG] |= MI_INTR_SP;
-    }
-    if (sp->mi->regs[MI_INTR_REG] & MI_INTR_SP)
-    {
-        cp0_update_count(sp->mi->r4300);
-        add_interrupt_event(&sp->mi->r4300->cp0, SP_INT, sp_delay_time);
-        sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_SP;
-    }
+    end_sp_task(sp, sp_delay_time, 0);
+}
 
-    sp->regs[SP_STATUS_REG] &=
-        ~(SP_STATUS_TASKDONE | SP_STATUS_BROKE | SP_STATUS_HALT);
+void rsp_finish_gfx_task(struct rsp_core* sp)
+{
+    rsp_thread_wait();
+    sp->gfx_task_pending = 0;
+    sp->regs2[SP_PC_REG] |= sp->gfx_task_pc;
+
+    unprotect_framebuffers(&sp->dp->fb);
+    end_gfx_task(sp);
+    sp->gfx_task_sp_int = end_sp_task(sp, 1000, sp->gfx_task_deadline);
 }
 
 void rsp_interrupt_event(void* opaque)
 {
     struct rsp_core* sp = (struct rsp_core*)opaque;
 
+    rsp_wait_gfx_task(sp);
+
+    /* Deadline of an asynchronous graphics task which didn't raise it */
+    if (sp->gfx_task_deadline)
+    {
+        sp->gfx_task_deadline = 0;
+        if (!sp->gfx_task_sp_int) {
+            return;
+        }
+    }
+
     if (!sp->rsp_task_locked)
     {
         sp->regs[SP_STATUS_REG] |=
@@ -403,5 +485,6 @@ void rsp_interrupt_event(void* opaque)
 void rsp_end_of_dma_event(void* opaque)
 {
     struct rsp_core* sp = (struct rsp_core*)opaque;
+    rsp_wait_gfx_task(sp);
     fifo_pop(sp);
 }
@@ -96,6 +96,13 @@ struct rsp_core
     uint32_t regs2[SP_REGS2_COUNT];
     uint32_t rsp_task_locked;
 
+    /* graphics tasks on the RSP thread */
+    int async_gfx;
+    uint32_t gfx_task_pending;  /* a task is running there */
+    uint32_t gfx_task_pc;       /* SP_PC_REG bits to restore when it ends */
+    uint32_t gfx_task_deadline; /* its SP_INT event is still queued */
+    uint32_t gfx_task_sp_int;   /* and should raise the interrupt */
+
     struct mi_controller* mi;
     struct rdp_core* dp;
     struct ri_controller* ri;
@@ -121,7 +128,8 @@ void init_rsp(struct rsp_core* sp,
               uint32_t* sp_mem,
               struct mi_controller* mi,
               struct rdp_core* dp,
-              struct ri_controller* ri);
+              struct ri_controller* ri,
+              int async_gfx);
 
 void poweron_rsp(struct rsp_core* sp);
 
@@ -136,6 +144,18 @@ void write_rsp_regs2(void* opaque, uint32_t address, uint32_t value, uint32_t ma
 
 void do_SP_Task(struct rsp_core* sp);
 
+void rsp_finish_gfx_task(struct rsp_core* sp);
+
+/* Wait for a graphics task running on the RSP thread and complete it.
+ * Anything the task may touch (RCP registers, SP memory, framebuffers,
+ * plugin calls) must be preceded by this. */
+static osal_inline void rsp_wait_gfx_task(struct rsp_core* sp)
+{
+    if (sp->gfx_task_pending) {
+        rsp_finish_gfx_task(sp);
+    }
+}
+
 void rsp_interrupt_event(void* opaque);
 void rsp_end_of_dma_event(void* opaque);
 
@@ -27,6 +27,9 @@
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rcp/mi/mi_controller.h"
+#include "device/rcp/rdp/rdp_core.h"
+#include "device/rcp/rsp/rsp_core.h"
+#include "device/rdram/rdram.h"
 #include "main/main.h"
 #include "plugin/plugin.h"
 
@@ -80,6 +83,7 @@ void poweron_vi(struct vi_controller* vi)
     memset(vi->regs, 0, VI_REGS_COUNT*sizeof(uint32_t));
     vi->field = 0;
     vi->delay = 0;
+    vi->intr_count = 0;
     vi->count_per_scanline = 0;
 }
 
@@ -113,6 +117,9 @@ void write_vi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
     struct vi_controller* vi = (struct vi_controller*)opaque;
     uint32_t reg = vi_reg(address);
 
+    /* the video plugin may get called */
+    rsp_wait_gfx_task(vi->dp->sp);
+
     switch(reg)
     {
     case VI_STATUS_REG:
@@ -157,6 +164,9 @@ void write_vi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
 void vi_vertical_interrupt_event(void* opaque)
 {
     struct vi_controller* vi = (struct vi_controller*)opaque;
+
+    rsp_wait_gfx_task(vi->dp->sp);
+
     if (vi->dp->do_on_unfreeze & DELAY_DP_INT)
         vi->dp->do_on_unfreeze |= DELAY_UPDATESCREEN;
     else
@@ -165,6 +175,8 @@ void vi_vertical_interrupt_event(void* opaque)
     /* allow main module to do things on VI event */
     new_vi();
 
+    ++vi->intr_count;
+
     /* toggle vi field if in interlaced mode */
     vi->field ^= (vi->regs[VI_STATUS_REG] >> 6) & 0x1;
 
@@ -177,3 +189,100 @@ void vi_vertical_interrupt_event(void* opaque)
     raise_rcp_interrupt(vi->mi, MI_INTR_VI);
 }
 
+
+int vi_get_frame(const struct vi_controller* vi, struct vi_frame* frame)
+{
+    uint32_t h_start = (vi->regs[VI_H_START_REG] >> 16) & 0x3ff;
+    uint32_t h_end = vi->regs[VI_H_START_REG] & 0x3ff;
+    uint32_t v_start = (vi->regs[VI_V_START_REG] >> 16) & 0x3ff;
+    uint32_t v_end = vi->regs[VI_V_START_REG] & 0x3ff;
+
+    memset(frame, 0, sizeof(*frame));
+
+    switch (vi->regs[VI_STATUS_REG] & 3)
+    {
+    case 2: frame->bpp = 2; break;
+    case 3: frame->bpp = 4; break;
+    default: return 0;
+    }
+
+    frame->origin = vi->regs[VI_ORIGIN_REG] & 0xffffff;
+    frame->fb_width = vi->regs[VI_WIDTH_REG] & 0xfff;
+    frame->x_scale = vi->regs[VI_X_SCALE_REG] & 0xfff;
+    frame->x_offset = (vi->regs[VI_X_SCALE_REG] >> 16) & 0xfff;
+    frame->y_scale = vi->regs[VI_Y_SCALE_REG] & 0xfff;
+    frame->y_offset = (vi->regs[VI_Y_SCALE_REG] >> 16) & 0xfff;
+
+    /* vertical positions count half lines */
+    frame->width = (h_end > h_start) ? h_end - h_start : 0;
+    frame->height = (v_end > v_start) ? (v_end - v_start) >> 1 : 0;
+
+    if (frame->width == 0 || frame->height == 0 || frame->fb_width == 0) {
+        return 0;
+    }
+
+    frame->rows = ((frame->y_offset + (frame->height - 1) * frame->y_scale) >> 10) + 1;
+    return 1;
+}
+
+static void scanout_line16(const uint32_t* dram, uint32_t line, const uint16_t* xs, uint32_t width, uint8_t* rgb)
+{
+    uint32_t i;
+
+    for (i = 0; i < width; ++i) {
+        uint32_t a = line + 2 * xs[i];
+        uint32_t p = (dram[a >> 2] >> ((~a & 2) << 3)) & 0xffff;
+        uint32_t r = (p >> 11) & 0x1f;
+        uint32_t g = (p >> 6) & 0x1f;
+        uint32_t b = (p >> 1) & 0x1f;
+
+        rgb[3 * i + 0] = (uint8_t)((r << 3) | (r >> 2));
+        rgb[3 * i + 1] = (uint8_t)((g << 3) | (g >> 2));
+        rgb[3 * i + 2] = (uint8_t)((b << 3) | (b >> 2));
+    }
+}
+
+static void scanout_line32(const uint32_t* dram, uint32_t line, const uint16_t* xs, uint32_t width, uint8_t* rgb)
+{
+    uint32_t i;
+
+    for (i = 0; i < width; ++i) {
+        uint32_t p = dram[(line >> 2) + xs[i]];
+
+        rgb[3 * i + 0] = (uint8_t)(p >> 24);
+        rgb[3 * i + 1] = (uint8_t)(p >> 16);
+        rgb[3 * i + 2] = (uint8_t)(p >> 8);
+    }
+}
+
+void vi_scanout(const struct vi_frame* frame, const struct rdram* rdram, uint8_t* rgb)
+{
+    /* framebuffer column of each screen pixel, at most 1023 of them */
+    uint16_t xs[0x400];
+    uint32_t x_max = 0;
+    uint32_t i, j;
+    size_t pitch = (size_t)frame->width * 3;
+
+    for (i = 0; i < frame->width; ++i) {
+        xs[i] = (uint16_t)((frame->x_offset + i * frame->x_scale) >> 10);
+        if (xs[i] > x_max) {
+            x_max = xs[i];
+        }
+    }
+
+    for (j = 0; j < frame->height; ++j) {
+        uint32_t y = (frame->y_offset + j * frame->y_scale) >> 10;
+        uint32_t line = frame->origin + y * frame->fb_width * frame->bpp;
+        uint8_t* out = rgb + (frame->height - 1 - j) * pitch;
+
+        if ((size_t)line + (size_t)(x_max + 1) * frame->bpp > rdram->dram_size) {
+            memset(out, 0, pitch);
+        }
+        else if (frame->bpp == 2) {
+            scanout_line16(rdram->dram, line, xs, frame->width, out);
+        }
+        else {
+            scanout_line32(rdram->dram, line, xs, frame->width, out);
+        }
+    }
+}
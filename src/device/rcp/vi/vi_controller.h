@@ -28,6 +28,7 @@
 
 struct mi_controller;
 struct rdp_core;
+struct rdram;
 
 enum vi_registers
 {
@@ -53,6 +54,7 @@ struct vi_controller
     uint32_t regs[VI_REGS_COUNT];
     unsigned int field;
     unsigned int delay;
+    uint64_t intr_count; /* number of vertical interrupts since power-on */
 
     unsigned int clock;
     unsigned int expected_refresh_rate;
@@ -62,6 +64,18 @@ struct vi_controller
     struct rdp_core* dp;
 };
 
+/* Framebuffer area the VI displays, as set up by its registers */
+struct vi_frame
+{
+    uint32_t origin;            /* RDRAM address of the first displayed line */
+    uint32_t fb_width;          /* framebuffer line length in pixels */
+    uint32_t bpp;               /* bytes per pixel, 2 or 4 */
+    uint32_t x_scale, x_offset; /* 2.10 fixed point framebuffer steps */
+    uint32_t y_scale, y_offset;
+    uint32_t width, height;     /* displayed size in screen pixels */
+    uint32_t rows;              /* framebuffer lines read for the display */
+};
+
 static osal_inline uint32_t vi_reg(uint32_t address)
 {
     return (address & 0xffff) >> 2;
@@ -82,4 +96,12 @@ void write_vi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
 
 void vi_vertical_interrupt_event(void* opaque);
 
+/* Fill frame from the VI registers. Returns 0 if the display is blanked. */
+int vi_get_frame(const struct vi_controller* vi, struct vi_frame* frame);
+
+/* Convert the displayed frame to RGB888, bottom line first like the video
+ * plugins' ReadScreen2. rgb must hold frame->width * frame->height * 3 bytes.
+ * Lines outside RDRAM come out black. */
+void vi_scanout(const struct vi_frame* frame, const struct rdram* rdram, uint8_t* rgb);
+
 #endif
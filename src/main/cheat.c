@@ -494,43 +494,110 @@ static int cheat_parse_hacks_code(char *code, m64p_cheat_code **hack)
     return num_codes;
 }
 
-int cheat_add_hacks(struct cheat_ctx* ctx, const char* rom_cheats)
+struct cheat_hacks* cheat_compile_hacks(const char* rom_cheats)
 {
     char *cheat_raw = NULL;
     char *saveptr = NULL;
     char *input, *token;
-    unsigned int i = 0;
+    const char *p;
+    unsigned int max_hacks = 1, max_codes = 1;
     int num_codes;
-    char cheatname[32];
     m64p_cheat_code *hack;
+    struct cheat_hacks *hacks = NULL;
+    m64p_cheat_code *next;
 
     if (!rom_cheats)
-        return 0;
+        return NULL;
+
+    /* upper bounds for the blob: every ';' starts a hack, every ',' a code */
+    for (p = rom_cheats; *p != '\0'; ++p) {
+        if (*p == ';') {
+            max_hacks++;
+            max_codes++;
+        }
+        else if (*p == ',') {
+            max_codes++;
+        }
+    }
+
+    hacks = malloc(sizeof(*hacks) + max_codes * sizeof(*hacks->codes) + max_hacks * sizeof(*hacks->num_codes));
+    if (!hacks)
+        return NULL;
+    hacks->count = 0;
+    hacks->codes = (m64p_cheat_code*)(hacks + 1);
+    hacks->num_codes = (int*)(hacks->codes + max_codes);
+    next = hacks->codes;
 
     /* copy ini entry for tokenizing */
     cheat_raw = strdup(rom_cheats);
     if (!cheat_raw)
         goto out;
 
-    /* split into cheats for the cheat engine */
     input = cheat_raw;
     while ((token = strtok_compat(input, ";", &saveptr))) {
         input = NULL;
 
-        snprintf(cheatname, sizeof(cheatname), "HACK%u", i);
-        cheatname[sizeof(cheatname) - 1] = '\0';
-
-        /* parse and add cheat */
         num_codes = cheat_parse_hacks_code(token, &hack);
         if (num_codes <= 0)
             continue;
 
-        cheat_add_new(ctx, cheatname, hack, num_codes);
+        memcpy(next, hack, num_codes * sizeof(*hack));
         free(hack);
-        i++;
+        next += num_codes;
+        hacks->num_codes[hacks->count++] = num_codes;
     }
 
 out:
     free(cheat_raw);
+    return hacks;
+}
+
+int cheat_add_hacks(struct cheat_ctx* ctx, const struct cheat_hacks* hacks)
+{
+    unsigned int i;
+    char cheatname[32];
+    m64p_cheat_code *codes;
+
+    if (!hacks)
+        return 0;
+
+    /* add to the cheat engine as HACK0, HACK1, ... */
+    codes = hacks->codes;
+    for (i = 0; i < hacks->count; ++i) {
+        snprintf(cheatname, sizeof(cheatname), "HACK%u", i);
+        cheatname[sizeof(cheatname) - 1] = '\0';
+
+        cheat_add_new(ctx, cheatname, codes, hacks->num_codes[i]);
+        codes += hacks->num_codes[i];
+    }
+
     return 0;
 }
+
+void cheat_append_digest(struct cheat_ctx* ctx, md5_state_t* state)
+{
+    cheat_t *cheat;
+    cheat_code_t *code;
+
+    if (list_empty(&ctx->active_cheats))
+        return;
+
+    if (ctx->mutex == NULL || SDL_LockMutex(ctx->mutex) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "Internal error: failed to lock mutex in cheat_append_digest()");
+        return;
+    }
+
+    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
+        if (!cheat->enabled)
+            continue;
+
+        md5_append(state, (const md5_byte_t*)cheat->name, (int)strlen(cheat->name) + 1);
+        list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+            md5_append(state, (const md5_byte_t*)&code->address, sizeof(code->address));
+            md5_append(state, (const md5_byte_t*)&code->value, sizeof(code->value));
+        }
+    }
+
+    SDL_UnlockMutex(ctx->mutex);
+}
@@ -26,6 +26,8 @@
 
 #include "list.h"
 
+#include <md5.h>
+
 #include <stdint.h>
 
 #define ENTRY_BOOT 0
@@ -40,6 +42,15 @@ struct cheat_ctx
     struct list_head active_cheats;
 };
 
+/* ROM database hacks, parsed once by cheat_compile_hacks().
+ * Everything lives in a single allocation. */
+struct cheat_hacks
+{
+    unsigned int count;         /* number of hacks */
+    int* num_codes;             /* codes in each hack */
+    m64p_cheat_code* codes;     /* all hacks, back to back */
+};
+
 void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry);
 
 void cheat_init(struct cheat_ctx* ctx);
@@ -47,6 +58,10 @@ void cheat_uninit(struct cheat_ctx* ctx);
 int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code_list, int num_codes);
 int cheat_set_enabled(struct cheat_ctx* ctx, const char* name, int enabled);
 void cheat_delete_all(struct cheat_ctx* ctx);
-int cheat_add_hacks(struct cheat_ctx* ctx, const char* rom_cheats);
+struct cheat_hacks* cheat_compile_hacks(const char* rom_cheats);
+int cheat_add_hacks(struct cheat_ctx* ctx, const struct cheat_hacks* hacks);
+
+/* Append the enabled cheats and their codes to an MD5 digest */
+void cheat_append_digest(struct cheat_ctx* ctx, md5_state_t* state);
 
 #endif
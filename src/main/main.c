@@ -36,6 +36,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
 #define M64P_CORE_PROTOTYPES 1
 #include "api/callbacks.h"
 #include "api/config.h"
@@ -53,6 +56,7 @@
 #include "backends/api/video_capture_backend.h"
 #include "backends/plugins_compat/plugins_compat.h"
 #include "backends/clock_ctime_plus_delta.h"
+#include "backends/clock_emulated.h"
 #include "backends/file_storage.h"
 #include "cheat.h"
 #include "device/device.h"
@@ -64,12 +68,14 @@
 #include "device/controllers/paks/transferpak.h"
 #include "device/gb/gb_cart.h"
 #include "device/pif/bootrom_hle.h"
+#include "device/r4300/lockstep.h"
 #include "eventloop.h"
 #include "main.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "plugin/plugin.h"
+#include "plugin/rsp_thread.h"
 #if defined(PROFILE)
 #include "profile.h"
 #endif
@@ -77,11 +83,13 @@
 #include "savestates.h"
 #include "screenshot.h"
 #include "util.h"
+#include "version.h"
 #include "netplay.h"
 #include "api/event.h"
 #include "api/memoryexport.h"
 
 #ifdef DBG
+#include "debugger/dbg_breakpoints.h"
 #include "debugger/dbg_debugger.h"
 #endif
 
@@ -125,6 +133,13 @@ static int   l_TakeScreenshot = 0;       // Tell OSD Rendering callback to take
 static int   l_SpeedFactor = 100;        // percentage of nominal game speed at which emulator is running
 static int   l_FrameAdvance = 0;         // variable to check if we pause on next frame
 static int   l_MainSpeedLimit = 1;       // insert delay during vi_interrupt to keep speed at real-time
+static char *l_BootCachePath = NULL;     // snapshot to take for the boot cache, if any
+static uint64_t l_BootCacheVI = 0;       // VI count at which to take it
+static md5_byte_t l_BootCacheCheats[16]; // digest of the cheats it was keyed with
+static SDL_atomic_t l_BootCacheCancel;   // state left the pristine boot path (load, reset, save write)
+static int   l_SoftwareScanout = 0;      // video plugin can't read the screen back, scan frames out of RDRAM
+static struct vi_frame l_ScanoutFrame;   // frame geometry last reported by main_get_screen_size
+static FILE *l_FrameDigestLog = NULL;    // (VI count, framebuffer digest) records, one per VI
 
 static osd_message_t *l_msgVol = NULL;
 static osd_message_t *l_msgFF = NULL;
@@ -140,6 +155,11 @@ static size_t l_pak_type_idx[6];
 /* PRNG state - used for Mempaks ID generation */
 static struct xoshiro256pp_state l_mpk_idgen;
 
+/* clock backend used by AF-RTC, 64DD RTC and GB MBC3 RTC */
+static struct emulated_clock l_emulated_clock;
+static void* l_rtc_clock = NULL;
+static const struct clock_backend_interface* l_irtc_clock = &g_iclock_ctime_plus_delta;
+
 SDL_Window* g_backup_current_window = NULL;
 SDL_GLContext g_backup_current_context = NULL;
 
@@ -361,6 +381,212 @@ const char *get_savesrampath(void)
     return get_savepathdefault(ConfigGetParamString(g_CoreConfig, "SaveSRAMPath"));
 }
 
+static void boot_cache_append_plugin(md5_state_t* state, ptr_PluginGetVersion get_version)
+{
+    m64p_plugin_type type;
+    int version = 0;
+    const char* name = NULL;
+
+    if (get_version == NULL || get_version(&type, &version, NULL, &name, NULL) != M64ERR_SUCCESS)
+        return;
+
+    md5_append(state, (const md5_byte_t*)&version, sizeof(version));
+    if (name != NULL)
+        md5_append(state, (const md5_byte_t*)name, (int)strlen(name) + 1);
+}
+
+static void boot_cache_cheats_digest(md5_byte_t digest[16])
+{
+    md5_state_t state;
+
+    md5_init(&state);
+    cheat_append_digest(&g_cheat_ctx, &state);
+    md5_finish(&state, digest);
+}
+
+/* Drop a pending boot cache snapshot: the machine state no longer comes
+ * from an untouched boot. Can be called from any thread. */
+void main_cancel_boot_cache(void)
+{
+    SDL_AtomicSet(&l_BootCacheCancel, 1);
+}
+
+/* Save storages of cached boots: a save written before the snapshot isn't
+ * part of it, and restoring it would leave the game's RAM out of sync with
+ * the save data, so any write cancels the snapshot */
+static uint8_t* boot_cache_storage_data(const void* storage)
+{
+    return g_ifile_storage.data(storage);
+}
+
+static size_t boot_cache_storage_size(const void* storage)
+{
+    return g_ifile_storage.size(storage);
+}
+
+static void boot_cache_storage_save(void* storage, size_t start, size_t size)
+{
+    main_cancel_boot_cache();
+    g_ifile_storage.save(storage, start, size);
+}
+
+static void boot_cache_substorage_save(void* storage, size_t start, size_t size)
+{
+    main_cancel_boot_cache();
+    g_isubfile_storage.save(storage, start, size);
+}
+
+static const struct storage_backend_interface l_iboot_cache_storage =
+{
+    boot_cache_storage_data,
+    boot_cache_storage_size,
+    boot_cache_storage_save
+};
+
+static const struct storage_backend_interface l_iboot_cache_substorage =
+{
+    boot_cache_storage_data,
+    boot_cache_storage_size,
+    boot_cache_substorage_save
+};
+
+/* The boot cache key covers everything that shapes the machine state up to
+ * the snapshot: ROM, core version, the settings passed to init_device, the
+ * controller setup, the contents of the save storages, the plugins and the
+ * enabled cheats. Boots with mod hooks installed aren't cached. */
+static void boot_cache_init(const uint32_t* settings, size_t count, const struct file_storage* const* saves, size_t saves_count)
+{
+    md5_state_t state;
+    md5_byte_t digest[16];
+    char key[33];
+    const char *dir;
+    FILE *f;
+    size_t i;
+
+    free(l_BootCachePath);
+    l_BootCachePath = NULL;
+    l_BootCacheVI = 0;
+    SDL_AtomicSet(&l_BootCacheCancel, 0);
+
+    if (!ConfigGetParamBool(g_CoreConfig, "BootCache") || netplay_is_init() || ModLoaderHooksActive())
+        return;
+
+    md5_init(&state);
+    md5_append(&state, (const md5_byte_t*)ROM_SETTINGS.MD5, (int)strlen(ROM_SETTINGS.MD5));
+    md5_append(&state, (const md5_byte_t*)settings, (int)(count * sizeof(*settings)));
+    for (i = 0; i < GAME_CONTROLLERS_COUNT; ++i) {
+        md5_append(&state, (const md5_byte_t*)&Controls[i].Present, sizeof(Controls[i].Present));
+        md5_append(&state, (const md5_byte_t*)&Controls[i].RawData, sizeof(Controls[i].RawData));
+        md5_append(&state, (const md5_byte_t*)&Controls[i].Plugin, sizeof(Controls[i].Plugin));
+        md5_append(&state, (const md5_byte_t*)&Controls[i].Type, sizeof(Controls[i].Type));
+    }
+    for (i = 0; i < saves_count; ++i) {
+        if (saves[i]->data != NULL)
+            md5_append(&state, (const md5_byte_t*)saves[i]->data, (int)saves[i]->size);
+    }
+    boot_cache_append_plugin(&state, gfx.getVersion);
+    boot_cache_append_plugin(&state, audio.getVersion);
+    boot_cache_append_plugin(&state, input.getVersion);
+    boot_cache_append_plugin(&state, rsp.getVersion);
+    boot_cache_cheats_digest(l_BootCacheCheats);
+    md5_append(&state, l_BootCacheCheats, sizeof(l_BootCacheCheats));
+    md5_finish(&state, digest);
+
+    for (i = 0; i < 16; ++i)
+        sprintf(key + 2 * i, "%02x", digest[i]);
+
+    dir = ConfigGetUserCachePath();
+    if (dir == NULL)
+        return;
+
+    l_BootCachePath = formatstr("%sbootcache%c", dir, OSAL_DIR_SEPARATORS[0]);
+    osal_mkdirp(l_BootCachePath, 0700);
+    free(l_BootCachePath);
+    l_BootCachePath = formatstr("%sbootcache%c%s.st", dir, OSAL_DIR_SEPARATORS[0], key);
+
+    if ((f = osal_file_open(l_BootCachePath, "rb")) != NULL) {
+        fclose(f);
+        DebugMessage(M64MSG_INFO, "Booting from cached state %s", l_BootCachePath);
+        savestates_set_job(savestates_job_load, savestates_type_m64p, l_BootCachePath);
+        free(l_BootCachePath);
+        l_BootCachePath = NULL;
+    }
+    else {
+        l_BootCacheVI = (uint64_t)ConfigGetParamInt(g_CoreConfig, "BootCacheVI");
+    }
+}
+
+/* Queue the boot cache snapshot once the VI count is reached, unless the
+ * state stopped being a plain boot of what the key describes */
+static void boot_cache_new_vi(void)
+{
+    md5_byte_t cheats[16];
+
+    if (l_BootCachePath == NULL)
+        return;
+
+    boot_cache_cheats_digest(cheats);
+    if (ModLoaderHooksActive() || memcmp(cheats, l_BootCacheCheats, sizeof(cheats)) != 0)
+        main_cancel_boot_cache();
+    if (SDL_AtomicGet(&l_BootCacheCancel)) {
+        DebugMessage(M64MSG_INFO, "Not saving boot cache state, the boot was altered");
+        free(l_BootCachePath);
+        l_BootCachePath = NULL;
+        return;
+    }
+
+    if (g_dev.vi.intr_count < l_BootCacheVI)
+        return;
+
+    /* Let a pending user request go first */
+    if (savestates_get_job() != savestates_job_nothing)
+        return;
+
+    DebugMessage(M64MSG_INFO, "Saving boot cache state %s", l_BootCachePath);
+    savestates_set_job(savestates_job_save, savestates_type_m64p, l_BootCachePath);
+    free(l_BootCachePath);
+    l_BootCachePath = NULL;
+}
+
+/* Append the VI count and an XXH3 digest of the displayed framebuffer,
+ * as two little-endian 64-bit words. Blanked frames get a zero digest. */
+static void frame_digest_new_vi(void)
+{
+    struct vi_frame frame;
+    unsigned char record[16];
+    uint64_t digest = 0;
+    uint64_t count = g_dev.vi.intr_count;
+    size_t size;
+    int i;
+
+    if (l_FrameDigestLog == NULL)
+        return;
+
+    if (vi_get_frame(&g_dev.vi, &frame) && frame.origin < g_dev.rdram.dram_size)
+    {
+        size = (size_t)frame.rows * frame.fb_width * frame.bpp;
+        if (size > g_dev.rdram.dram_size - frame.origin)
+            size = g_dev.rdram.dram_size - frame.origin;
+
+        /* seeded with the geometry so mode changes show up too */
+        digest = XXH3_64bits_withSeed((const uint8_t*)g_dev.rdram.dram + frame.origin, size,
+                                      XXH3_64bits(&frame, sizeof(frame)));
+    }
+
+    for (i = 0; i < 8; ++i)
+    {
+        record[i] = (unsigned char)(count >> (8 * i));
+        record[8 + i] = (unsigned char)(digest >> (8 * i));
+    }
+
+    if (fwrite(record, 1, sizeof(record), l_FrameDigestLog) != sizeof(record))
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't write frame digest log, disabling it");
+        fclose(l_FrameDigestLog);
+        l_FrameDigestLog = NULL;
+    }
+}
+
 const char *get_savestatefilename(void)
 {
     /* return same file name as save files */
@@ -440,7 +666,15 @@ int main_set_core_defaults(void)
     ConfigSetDefaultString(g_CoreConfig, "SaveSRAMPath", "", "Path to directory where SRAM/EEPROM data (in-game saves) are stored. If this is blank, the default value of ${UserDataPath}/save will be used");
     ConfigSetDefaultString(g_CoreConfig, "SharedDataPath", "", "Path to a directory to search when looking for shared data files");
     ConfigSetDefaultBool(g_CoreConfig, "RandomizeInterrupt", 1, "Randomize PI/SI Interrupt Timing");
+    ConfigSetDefaultBool(g_CoreConfig, "BootCache", 0, "Cache a snapshot of the machine after boot and restore it on later boots with the same ROM, settings and save data");
+    ConfigSetDefaultInt(g_CoreConfig, "BootCacheVI", 60, "Number of VIs after power-on at which the boot cache snapshot is taken");
+    ConfigSetDefaultString(g_CoreConfig, "FrameDigestLog", "", "File to which the VI count and an XXH3 digest of the displayed framebuffer are appended at each VI. Disabled if blank");
+    ConfigSetDefaultBool(g_CoreConfig, "AsyncGfxTasks", 0, "Run graphics tasks on a separate thread while the CPU emulation continues up to their interrupts");
+    ConfigSetDefaultBool(g_CoreConfig, "LibultraHLE", 0, "Run libultra bzero/bcopy natively when the recompilers recognize them");
+    ConfigSetDefaultBool(g_CoreConfig, "Lockstep", 0, "Check the dynamic recompiler against a pure interpreter at every block entry and report the first divergence (slow; for debugging the recompiler)");
     ConfigSetDefaultInt(g_CoreConfig, "SiDmaDuration", -1, "Duration of SI DMA (-1: use per game settings)");
+    ConfigSetDefaultBool(g_CoreConfig, "EmulatedRtc", 0, "Derive RTC time from emulated time instead of host wall-clock (deterministic replays)");
+    ConfigSetDefaultInt(g_CoreConfig, "EmulatedRtcEpoch", 946684800, "RTC time at power-on when EmulatedRtc is set, in seconds since 1970-01-01");
     ConfigSetDefaultString(g_CoreConfig, "GbCameraVideoCaptureBackend1", DEFAULT_VIDEO_CAPTURE_BACKEND, "Gameboy Camera Video Capture backend");
     ConfigSetDefaultInt(g_CoreConfig, "SaveDiskFormat", 1, "Disk Save Format (0: Full Disk Copy (*.ndr/*.d6r), 1: RAM Area Only (*.ram))");
     ConfigSetDefaultInt(g_CoreConfig, "SaveFilenameFormat", 1, "Save (SRAM/State) Filename Format (0: ROM Header Name, 1: Automatic (including partial MD5 hash))");
@@ -573,6 +807,14 @@ static int main_is_paused(void)
     return (g_EmulatorRunning && g_rom_pause);
 }
 
+/* Lift the pause, waking the emulation thread right away if it waits in
+ * pause_loop */
+void main_unpause(void)
+{
+    g_rom_pause = 0;
+    event_pause_wake();
+}
+
 void main_toggle_pause(void)
 {
     if (!g_EmulatorRunning)
@@ -603,14 +845,17 @@ void main_toggle_pause(void)
         StateChanged(M64CORE_EMU_STATE, M64EMU_PAUSED);
     }
 
-    g_rom_pause = !g_rom_pause;
+    if (g_rom_pause)
+        main_unpause();
+    else
+        g_rom_pause = 1;
     l_FrameAdvance = 0;
 }
 
 void main_advance_one(void)
 {
     l_FrameAdvance = 1;
-    g_rom_pause = 0;
+    main_unpause();
     StateChanged(M64CORE_EMU_STATE, M64EMU_RUNNING);
 }
 
@@ -841,6 +1086,15 @@ m64p_error main_core_state_set(m64p_core_param param, int val)
 
 m64p_error main_get_screen_size(int *width, int *height)
 {
+    if (l_SoftwareScanout)
+    {
+        /* main_read_screen will produce an image of this size */
+        vi_get_frame(&g_dev.vi, &l_ScanoutFrame);
+        *width = (int)l_ScanoutFrame.width;
+        *height = (int)l_ScanoutFrame.height;
+        return M64ERR_SUCCESS;
+    }
+
     gfx.readScreen(NULL, width, height, 0);
     return M64ERR_SUCCESS;
 }
@@ -848,6 +1102,21 @@ m64p_error main_get_screen_size(int *width, int *height)
 m64p_error main_read_screen(void *pixels, int bFront)
 {
     int width_trash, height_trash;
+
+    if (l_SoftwareScanout)
+    {
+        struct vi_frame frame;
+
+        /* the caller sized pixels after main_get_screen_size */
+        if (vi_get_frame(&g_dev.vi, &frame)
+         && frame.width == l_ScanoutFrame.width && frame.height == l_ScanoutFrame.height)
+            l_ScanoutFrame = frame;
+
+        if (l_ScanoutFrame.width != 0 && l_ScanoutFrame.height != 0)
+            vi_scanout(&l_ScanoutFrame, &g_dev.rdram, (uint8_t*)pixels);
+        return M64ERR_SUCCESS;
+    }
+
     gfx.readScreen(pixels, &width_trash, &height_trash, bFront);
     return M64ERR_SUCCESS;
 }
@@ -902,6 +1171,8 @@ int main_volume_get_muted(void)
 
 m64p_error main_reset(int do_hard_reset)
 {
+    main_cancel_boot_cache();
+
     if (gResetCallback) {
         gResetCallback(do_hard_reset);
     }
@@ -958,16 +1229,18 @@ static void video_plugin_render_callback(int bScreenRedrawn)
 
     g_backup_current_window = SDL_GL_GetCurrentWindow();
     g_backup_current_context = SDL_GL_GetCurrentContext();
-    if (gVICallback) {
+    if (gSyncCallbacks && gVICallback) {
         gVICallback();
+        SDL_GL_MakeCurrent(g_backup_current_window, g_backup_current_context);
     }
-    SDL_GL_MakeCurrent(g_backup_current_window, g_backup_current_context);
+    event_post(ML64_EVENT_VI, (u32)g_dev.vi.intr_count);
 }
 
 void new_frame(void)
 {
     if (g_FrameCallback != NULL)
         (*g_FrameCallback)(l_CurrentFrame);
+    event_post(ML64_EVENT_FRAME, l_CurrentFrame);
 
     /* advance the current frame */
     l_CurrentFrame++;
@@ -1012,7 +1285,11 @@ static void apply_speed_limiter(void)
 #endif
 
 #ifdef DBG
-    if(g_DebuggerActive) DebuggerCallback(DEBUG_UI_VI, 0);
+    if(g_DebuggerActive) {
+        DebuggerCallback(DEBUG_UI_VI, 0);
+        /* the recompilers only reach update_debugger at breakpoints */
+        apply_breakpoint_changes();
+    }
 #endif
 
     double totalElapsedGameTime = AdjustedLimit*totalVIs;
@@ -1072,14 +1349,18 @@ static void pause_loop(void)
         osd_render();  // draw Paused message in case gfx.updateScreen didn't do it
         VidExt_GL_SwapBuffers();
         InvalidateCachedCode();
+        event_post(ML64_EVENT_PAUSE, l_CurrentFrame);
         while(g_rom_pause)
         {
-            SDL_Delay(10);
+            /* returns early as soon as the pause is lifted */
+            event_pause_wait(10);
             main_check_inputs();
-            if (gPauseCallback) {
+            DynarecApplyRequests();
+            if (gSyncCallbacks && gPauseCallback) {
                 gPauseCallback();
             }
         }
+        event_post(ML64_EVENT_RESUME, l_CurrentFrame);
     }
 }
 
@@ -1093,12 +1374,26 @@ void new_vi(void)
 
     gs_apply_cheats(&g_cheat_ctx);
 
+    /* merge all save data modified during this frame into a single storage update */
+    flush_cart(&g_dev.cart);
+    DynarecApplyRequests();
+
     apply_speed_limiter();
     main_check_inputs();
 
     pause_loop();
 
     netplay_check_sync(&g_dev.r4300.cp0);
+
+    /* no rendering callback comes from the video plugin in this case */
+    if (l_SoftwareScanout && l_TakeScreenshot != 0)
+    {
+        TakeScreenshot(l_TakeScreenshot - 1);
+        l_TakeScreenshot = 0;
+    }
+
+    boot_cache_new_vi();
+    frame_digest_new_vi();
 }
 
 static void main_switch_pak(int control_id)
@@ -1548,7 +1843,7 @@ static void init_gb_ram(void* opaque, size_t ram_size, void** storage, const str
 
     /* init GB RAM storage */
     *storage = &data->ram_fstorage;
-    *istorage = &g_ifile_storage;
+    *istorage = &l_iboot_cache_storage;
 }
 
 static void release_gb_ram(void* opaque)
@@ -1573,7 +1868,7 @@ void main_change_gb_cart(int control_id)
     init_gb_cart(gb_cart,
             data, init_gb_rom, release_gb_rom,
             data, init_gb_ram, release_gb_ram,
-            NULL, &g_iclock_ctime_plus_delta,
+            l_rtc_clock, l_irtc_clock,
             &data->control_id, &g_irumble_backend_plugin_compat,
             data->gbcam_backend, data->igbcam_backend);
 
@@ -1610,6 +1905,9 @@ m64p_error main_run(void)
     int32_t si_dma_duration;
     int32_t no_compiled_jump;
     int32_t randomize_interrupt;
+    int32_t libultra_hle;
+    int32_t async_gfx;
+    int32_t lockstep;
     struct file_storage eep;
     struct file_storage fla;
     struct file_storage sra;
@@ -1652,6 +1950,16 @@ m64p_error main_run(void)
     no_compiled_jump = ConfigGetParamBool(g_CoreConfig, "NoCompiledJump");
     //We disable any randomness for netplay
     randomize_interrupt = !netplay_is_init() ? ConfigGetParamBool(g_CoreConfig, "RandomizeInterrupt") : 0;
+    //Peers must run the same code paths
+    libultra_hle = !netplay_is_init() ? ConfigGetParamBool(g_CoreConfig, "LibultraHLE") : 0;
+    async_gfx = !netplay_is_init() ? ConfigGetParamBool(g_CoreConfig, "AsyncGfxTasks") : 0;
+    /* The CPU only waits for a graphics task at the framebuffers reported
+     * by the video plugin, and the dynarecs access those directly */
+    if (async_gfx && (emumode == EMUMODE_DYNAREC || !(gfx.fBGetFrameBufferInfo && gfx.fBRead && gfx.fBWrite))) {
+        DebugMessage(M64MSG_WARNING, "AsyncGfxTasks needs an interpreter and a video plugin with framebuffer info, running graphics tasks synchronously");
+        async_gfx = 0;
+    }
+    lockstep = !netplay_is_init() ? ConfigGetParamBool(g_CoreConfig, "Lockstep") : 0;
     count_per_op = ConfigGetParamInt(g_CoreConfig, "CountPerOp");
     count_per_op_denom_pot = ConfigGetParamInt(g_CoreConfig, "CountPerOpDenomPot");
 
@@ -1681,6 +1989,18 @@ m64p_error main_run(void)
     if (count_per_op_denom_pot > 11)
         count_per_op_denom_pot = 11;
 
+    /* select RTC clock backend */
+    if (ConfigGetParamBool(g_CoreConfig, "EmulatedRtc")) {
+        l_emulated_clock.epoch = (time_t)ConfigGetParamInt(g_CoreConfig, "EmulatedRtcEpoch");
+        l_emulated_clock.vi = &g_dev.vi;
+        l_rtc_clock = &l_emulated_clock;
+        l_irtc_clock = &g_iclock_emulated;
+    }
+    else {
+        l_rtc_clock = NULL;
+        l_irtc_clock = &g_iclock_ctime_plus_delta;
+    }
+
     si_dma_duration = ConfigGetParamInt(g_CoreConfig, "SiDmaDuration");
     if (si_dma_duration < 0)
         si_dma_duration = ROM_SETTINGS.sidmaduration;
@@ -1690,7 +2010,7 @@ m64p_error main_run(void)
 
     rdram_size = (disable_extra_mem == 0) ? 0x800000 : 0x400000;
 
-    cheat_add_hacks(&g_cheat_ctx, ROM_PARAMS.cheats);
+    cheat_add_hacks(&g_cheat_ctx, ROM_PARAMS.hacks);
 
     /* do byte-swapping if it hasn't been done yet */
 #if !defined(M64P_BIG_ENDIAN)
@@ -1757,7 +2077,7 @@ m64p_error main_run(void)
     /* try to load DD disk first, if that succeeds, pass the region to load_dd_rom */
     if (load_dd_disk(&dd_disk, &dd_idisk))
     {
-        dd_rtc_iclock = &g_iclock_ctime_plus_delta;
+        dd_rtc_iclock = l_irtc_clock;
         load_dd_rom((uint8_t*)mem_base_u32(&g_mem_base, MM_DD_ROM), &dd_rom_size, &dd_disk.region);
     }
     else
@@ -1863,7 +2183,7 @@ m64p_error main_run(void)
                     mpk_storages[i].size = MEMPAK_SIZE;
                     mpk_storages[i].filename = (void*)&mpk; /* OK for isubfile_storage */
 
-                    init_mempak(&g_dev.mempaks[i], &mpk_storages[i], &g_isubfile_storage);
+                    init_mempak(&g_dev.mempaks[i], &mpk_storages[i], &l_iboot_cache_substorage);
                     l_paks[i][k] = &g_dev.mempaks[i];
 
                     if (Controls[i].Plugin == PLUGIN_MEMPAK) {
@@ -1887,7 +2207,7 @@ m64p_error main_run(void)
                     init_gb_cart(&g_dev.gb_carts[i],
                             &l_gb_carts_data[i], init_gb_rom, release_gb_rom,
                             &l_gb_carts_data[i], init_gb_ram, release_gb_ram,
-                            NULL, &g_iclock_ctime_plus_delta,
+                            l_rtc_clock, l_irtc_clock,
                             &l_gb_carts_data[i].control_id, &g_irumble_backend_plugin_compat,
                             l_gb_carts_data[i].gbcam_backend, l_gb_carts_data[i].igbcam_backend);
 
@@ -1941,23 +2261,41 @@ m64p_error main_run(void)
                 count_per_op_denom_pot,
                 no_compiled_jump,
                 randomize_interrupt,
+                libultra_hle,
                 g_start_address,
+                async_gfx,
                 &g_dev.ai, &g_iaudio_out_backend_plugin_compat, ((float)ROM_SETTINGS.aidmamodifier / 100.0),
                 si_dma_duration,
                 rdram_size,
                 joybus_devices, ijoybus_devices,
                 vi_clock_from_tv_standard(ROM_PARAMS.systemtype), vi_expected_refresh_rate_from_tv_standard(ROM_PARAMS.systemtype),
-                NULL, &g_iclock_ctime_plus_delta,
+                l_rtc_clock, l_irtc_clock,
                 g_rom_size,
                 eeprom_type,
-                &eep, &g_ifile_storage,
+                &eep, &l_iboot_cache_storage,
                 flashram_type,
-                &fla, &g_ifile_storage,
-                &sra, &g_ifile_storage,
-                NULL, dd_rtc_iclock,
+                &fla, &l_iboot_cache_storage,
+                &sra, &l_iboot_cache_storage,
+                l_rtc_clock, dd_rtc_iclock,
                 dd_rom_size,
                 &dd_disk, dd_idisk);
 
+    /* 64DD disks are written in place, so their boots aren't cached */
+    if (dd_rom_size == 0) {
+        const uint32_t boot_settings[] = {
+            MUPEN_CORE_VERSION, emumode, count_per_op, count_per_op_denom_pot,
+            (uint32_t)no_compiled_jump, (uint32_t)randomize_interrupt, (uint32_t)libultra_hle,
+            (uint32_t)si_dma_duration, (uint32_t)rdram_size, (uint32_t)ROM_PARAMS.systemtype,
+            (uint32_t)ConfigGetParamBool(g_CoreConfig, "EmulatedRtc"),
+            (uint32_t)ConfigGetParamInt(g_CoreConfig, "EmulatedRtcEpoch"),
+            (uint32_t)async_gfx, (uint32_t)ROM_SETTINGS.aidmamodifier,
+        };
+        const struct file_storage* const boot_saves[] = { &eep, &fla, &sra, &mpk };
+
+        boot_cache_init(boot_settings, sizeof(boot_settings) / sizeof(boot_settings[0]),
+                        boot_saves, sizeof(boot_saves) / sizeof(boot_saves[0]));
+    }
+
     // Attach rom to plugins
     failure_rval = M64ERR_PLUGIN_FAIL;
     if (!gfx.romOpen())
@@ -1973,6 +2311,25 @@ m64p_error main_run(void)
         goto on_input_open_failure;
     }
 
+    /* video plugins without ReadScreen2 support (e.g. the dummy one) report no size */
+    {
+        int width = 0, height = 0;
+        gfx.readScreen(NULL, &width, &height, 0);
+        l_SoftwareScanout = (width <= 0 || height <= 0);
+        memset(&l_ScanoutFrame, 0, sizeof(l_ScanoutFrame));
+    }
+
+    /* open the frame digest log, if requested */
+    {
+        const char *digest_log = ConfigGetParamString(g_CoreConfig, "FrameDigestLog");
+        if (digest_log != NULL && strlen(digest_log) > 0)
+        {
+            l_FrameDigestLog = osal_file_open(digest_log, "wb");
+            if (l_FrameDigestLog == NULL)
+                DebugMessage(M64MSG_ERROR, "Couldn't open frame digest log %s", digest_log);
+        }
+    }
+
     /* set up the SDL key repeat and event filter to catch keyboard/joystick commands for the core */
     event_initialize();
 
@@ -2020,14 +2377,27 @@ m64p_error main_run(void)
         DebugMessage(M64MSG_STATUS, "gl_context OK!");
     }
 
+    event_init();
     g_EmulatorRunning = 1;
     StateChanged(M64CORE_EMU_STATE, M64EMU_RUNNING);
 
+    if (async_gfx)
+        rsp_thread_init();
+
     poweron_device(&g_dev);
     pif_bootrom_hle_execute(&g_dev.r4300);
+    if (lockstep)
+        lockstep_init(&g_dev.r4300);
+    DynarecApplyRequests();
     run_device(&g_dev);
+    lockstep_release(&g_dev.r4300);
+    DynarecApplyRequests();
 
     /* now begin to shut down */
+    rsp_wait_gfx_task(&g_dev.sp);
+    rsp_thread_shutdown();
+    flush_cart(&g_dev.cart);
+
 #ifdef WITH_LIRC
     lircStop();
 #endif // WITH_LIRC
@@ -2053,6 +2423,12 @@ m64p_error main_run(void)
     close_file_storage(&mpk);
     close_dd_disk(&dd_disk);
 
+    if (l_FrameDigestLog != NULL)
+    {
+        fclose(l_FrameDigestLog);
+        l_FrameDigestLog = NULL;
+    }
+
     if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
     {
         osd_exit();
@@ -2124,7 +2500,7 @@ void main_stop(void)
     }
     if (g_rom_pause)
     {
-        g_rom_pause = 0;
+        main_unpause();
         StateChanged(M64CORE_EMU_STATE, M64EMU_RUNNING);
     }
 
@@ -73,6 +73,7 @@ void main_message(m64p_msg_level level, unsigned int osd_corner, const char *for
 m64p_error main_run(void);
 void main_stop(void);
 void main_toggle_pause(void);
+void main_unpause(void);
 void main_advance_one(void);
 
 void main_speedup(int percent);
@@ -86,6 +87,7 @@ void main_state_set_slot(int slot);
 void main_state_inc_slot(void);
 void main_state_load(const char *filename);
 void main_state_save(int format, const char *filename);
+void main_cancel_boot_cache(void);
 
 m64p_error main_core_state_query(m64p_core_param param, int *rval);
 m64p_error main_core_state_set(m64p_core_param param, int val);
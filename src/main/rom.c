@@ -35,6 +35,7 @@
 #include "api/config.h"
 #include "api/m64p_config.h"
 #include "api/m64p_types.h"
+#include "cheat.h"
 #include "device/dd/disk.h"
 #include "backends/file_storage.h"
 #include "device/device.h"
@@ -172,7 +173,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
 
     /* add some useful properties to ROM_PARAMS */
     ROM_PARAMS.systemtype = rom_country_code_to_system_type(ROM_HEADER.Country_code);
-    ROM_PARAMS.cheats = NULL;
+    ROM_PARAMS.hacks = NULL;
 
     memcpy(ROM_PARAMS.headername, ROM_HEADER.Name, 20);
     ROM_PARAMS.headername[20] = '\0';
@@ -195,7 +196,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.disableextramem = entry->disableextramem;
         ROM_SETTINGS.sidmaduration = entry->sidmaduration;
         ROM_SETTINGS.aidmamodifier = entry->aidmamodifier;
-        ROM_PARAMS.cheats = entry->cheats;
+        ROM_PARAMS.hacks = entry->hacks;
     }
     else
     {
@@ -211,7 +212,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.disableextramem = DEFAULT_DISABLE_EXTRA_MEM;
         ROM_SETTINGS.sidmaduration = DEFAULT_SI_DMA_DURATION;
         ROM_SETTINGS.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
-        ROM_PARAMS.cheats = NULL;
+        ROM_PARAMS.hacks = NULL;
 
         /* check if ROM has the Advanced Homebrew ROM Header (see https://n64brew.dev/wiki/ROM_Header) */
         if (ROM_HEADER.Cartridge_ID == 0x4445)
@@ -332,7 +333,7 @@ m64p_error open_disk(void)
         ROM_SETTINGS.disableextramem = entry->disableextramem;
         ROM_SETTINGS.sidmaduration = entry->sidmaduration;
         ROM_SETTINGS.aidmamodifier = entry->aidmamodifier;
-        ROM_PARAMS.cheats = entry->cheats;
+        ROM_PARAMS.hacks = entry->hacks;
     }
     else
     {
@@ -349,7 +350,7 @@ m64p_error open_disk(void)
         ROM_SETTINGS.disableextramem = DEFAULT_DISABLE_EXTRA_MEM;
         ROM_SETTINGS.sidmaduration = DEFAULT_SI_DMA_DURATION;
         ROM_SETTINGS.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
-        ROM_PARAMS.cheats = NULL;
+        ROM_PARAMS.hacks = NULL;
     }
 
     /* set system type */
@@ -645,6 +646,7 @@ void romdatabase_open(void)
             search->entry.countperop = DEFAULT_COUNT_PER_OP;
             search->entry.disableextramem = DEFAULT_DISABLE_EXTRA_MEM;
             search->entry.cheats = NULL;
+            search->entry.hacks = NULL;
             search->entry.transferpak = 0;
             search->entry.mempak = 1;
             search->entry.biopak = 0;
@@ -867,6 +869,10 @@ void romdatabase_open(void)
 
     fclose(fPtr);
     romdatabase_resolve();
+
+    /* parse the hacks now so that starting a ROM is a plain lookup */
+    for (search = g_romdatabase.list; search != NULL; search = search->next_entry)
+        search->entry.hacks = cheat_compile_hacks(search->entry.cheats);
 }
 
 void romdatabase_close(void)
@@ -882,6 +888,7 @@ void romdatabase_close(void)
         if(g_romdatabase.list->entry.refmd5)
             free(g_romdatabase.list->entry.refmd5);
         free(g_romdatabase.list->entry.cheats);
+        free(g_romdatabase.list->entry.hacks);
         free(g_romdatabase.list);
         g_romdatabase.list = search;
         }
@@ -46,9 +46,11 @@ m64p_error close_disk(void);
 
 extern int g_rom_size;
 
+struct cheat_hacks;
+
 typedef struct _rom_params
 {
-   char *cheats;
+   const struct cheat_hacks *hacks;
    m64p_system_type systemtype;
    char headername[21];  /* ROM Name as in the header, removing trailing whitespace */
 } rom_params;
@@ -104,6 +106,7 @@ typedef struct
    md5_byte_t md5[16];
    md5_byte_t* refmd5;
    char *cheats;
+   struct cheat_hacks *hacks; /* cheats, parsed when the database is loaded */
    unsigned int crc1;
    unsigned int crc2;
    unsigned char status; /* Rom status on a scale from 0-5. */
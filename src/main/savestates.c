@@ -58,7 +58,7 @@ enum { GB_CART_FINGERPRINT_OFFSET = 0x134 };
 enum { DD_DISK_ID_OFFSET = 0x43670 };
 
 static const char* savestate_magic = "M64+SAVE";
-static const int savestate_latest_version = 0x00010900;  /* 1.9 */
+static const int savestate_latest_version = 0x00010A00;  /* 1.10 */
 static const unsigned char pj64_magic[4] = { 0xC8, 0xA6, 0xD8, 0x23 };
 
 static savestates_job job = savestates_job_nothing;
@@ -185,6 +185,19 @@ static void savestates_clear_job(void)
 #define PUTDATA(buff, type, value) \
     do { type x = value; PUTARRAY(&x, buff, type, 1); } while(0)
 
+/* Set a bit in changed for each 4KB page of dram that differs from data */
+static void diff_rdram_pages(const uint32_t* dram, const unsigned char* data, uint32_t* changed)
+{
+    size_t page;
+
+    memset(changed, 0, RDRAM_MEMORY_SIZE / 0x1000 / 8);
+    for (page = 0; page < RDRAM_MEMORY_SIZE / 0x1000; ++page)
+    {
+        if (memcmp(dram + page * (0x1000 / 4), data + page * 0x1000, 0x1000) != 0)
+            changed[page / 32] |= UINT32_C(1) << (page % 32);
+    }
+}
+
 static int savestates_load_m64p(struct device* dev, char *filepath)
 {
     unsigned char header[44];
@@ -198,6 +211,9 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     char queue[1024];
     unsigned char using_tlb_data[4];
     unsigned char data_0001_0200[4096]; // 4k for extra state from v1.2
+    static uint32_t changed_pages[RDRAM_MEMORY_SIZE / 0x1000 / 32];
+    int tlb_changed;
+    int sp_mem_changed;
 
     uint32_t* cp0_regs = r4300_cp0_regs(&dev->r4300.cp0);
 
@@ -419,7 +435,9 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     dev->dp.dps_regs[DPS_BUFTEST_ADDR_REG] = GETDATA(curr, uint32_t);
     dev->dp.dps_regs[DPS_BUFTEST_DATA_REG] = GETDATA(curr, uint32_t);
 
+    diff_rdram_pages(dev->rdram.dram, curr, changed_pages);
     COPYARRAY(dev->rdram.dram, curr, uint32_t, RDRAM_MEMORY_SIZE/4);
+    sp_mem_changed = memcmp(dev->sp.mem, curr, SP_MEM_SIZE) != 0;
     COPYARRAY(dev->sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
     COPYARRAY(dev->pif.ram, curr, uint8_t, PIF_RAM_SIZE);
 
@@ -428,6 +446,9 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     /* by default, reset flashram state here and load it later if available */
     poweron_flashram(&dev->cart.flashram);
 
+    /* Code compiled under other mappings can't be kept */
+    tlb_changed = memcmp(dev->r4300.cp0.tlb.LUT_r, curr, 0x100000 * sizeof(uint32_t)) != 0
+               || memcmp(dev->r4300.cp0.tlb.LUT_w, curr + 0x100000 * sizeof(uint32_t), 0x100000 * sizeof(uint32_t)) != 0;
     COPYARRAY(dev->r4300.cp0.tlb.LUT_r, curr, uint32_t, 0x100000);
     COPYARRAY(dev->r4300.cp0.tlb.LUT_w, curr, uint32_t, 0x100000);
 
@@ -471,7 +492,15 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
         dev->r4300.cp0.tlb.entries[i].phys_odd = GETDATA(curr, uint32_t);
     }
 
-    savestates_load_set_pc(&dev->r4300, GETDATA(curr, uint32_t));
+    /* IPL3 and some games run code from SP memory */
+    if (sp_mem_changed)
+    {
+        invalidate_r4300_cached_code(&dev->r4300, R4300_KSEG0 + MM_RSP_MEM, SP_MEM_SIZE);
+        invalidate_r4300_cached_code(&dev->r4300, R4300_KSEG1 + MM_RSP_MEM, SP_MEM_SIZE);
+    }
+
+    savestates_load_set_pc(&dev->r4300, GETDATA(curr, uint32_t),
+                           tlb_changed ? NULL : changed_pages, RDRAM_MEMORY_SIZE / 0x1000);
 
     *r4300_cp0_next_interrupt(&dev->r4300.cp0) = GETDATA(curr, uint32_t);
     curr += 4; /* here there used to be next_vi */
@@ -878,6 +907,12 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
             *r4300_cp0_latch(&dev->r4300.cp0) = GETDATA(curr, uint64_t);
             *r4300_cp2_latch(&dev->r4300.cp2) = GETDATA(curr, uint64_t);
         }
+
+        if (version >= 0x00010A00)
+        {
+            /* extra vi state */
+            dev->vi.intr_count = GETDATA(curr, uint64_t);
+        }
     }
     else
     {
@@ -950,6 +985,7 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     poweron_fb(&dev->dp.fb);
 
     dev->sp.rsp_task_locked = 0;
+    dev->sp.gfx_task_deadline = 0;
     dev->r4300.cp0.interrupt_unsafe_state = 0;
 
     *r4300_cp0_last_addr(&dev->r4300.cp0) = *r4300_pc(&dev->r4300);
@@ -1254,6 +1290,7 @@ static int savestates_load_pj64(struct device* dev,
     poweron_flashram(&dev->cart.flashram);
 
     dev->sp.rsp_task_locked = 0;
+    dev->sp.gfx_task_deadline = 0;
     dev->r4300.cp0.interrupt_unsafe_state = 0;
 
     /* extra fb state */
@@ -1294,7 +1331,7 @@ static int savestates_load_pj64(struct device* dev,
         poweron_dd(&dev->dd);
     }
 
-    savestates_load_set_pc(&dev->r4300, *r4300_cp0_last_addr(&dev->r4300.cp0));
+    savestates_load_set_pc(&dev->r4300, *r4300_cp0_last_addr(&dev->r4300.cp0), NULL, 0);
 
     // assert(savestateData+savestateSize == curr)
 
@@ -1470,6 +1507,9 @@ int savestates_load(void)
         filepath = NULL;
     }
 
+    if (ret)
+        main_cancel_boot_cache();
+
     // deliver callback to indicate completion of state loading operation
     StateChanged(M64CORE_STATE_LOADCOMPLETE, ret);
 
@@ -1910,6 +1950,9 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     PUTDATA(curr, uint64_t, *r4300_cp0_latch((struct cp0*)&dev->r4300.cp0));
     PUTDATA(curr, uint64_t, *r4300_cp2_latch((struct cp2*)&dev->r4300.cp2));
 
+    /* vi interrupt counter (since 1.10) */
+    PUTDATA(curr, uint64_t, dev->vi.intr_count);
+
     init_work(&save->work, savestates_save_m64p_work);
     queue_work(&save->work);
 
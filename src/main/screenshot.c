@@ -230,7 +230,13 @@ void TakeScreenshot(int iFrameNumber)
     // get the width and height
     int width = 640;
     int height = 480;
-    gfx.readScreen(NULL, &width, &height, 0);
+    main_get_screen_size(&width, &height);
+    if (width <= 0 || height <= 0)
+    {
+        StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
+        free(filename);
+        return;
+    }
 
     // allocate memory for the image
     unsigned char *pucFrame = (unsigned char *) malloc(width * height * 3);
@@ -241,8 +247,8 @@ void TakeScreenshot(int iFrameNumber)
         return;
     }
 
-    // grab the back image from OpenGL by calling the video plugin
-    gfx.readScreen(pucFrame, &width, &height, 0);
+    // grab the back image from OpenGL by calling the video plugin, or from RDRAM without one
+    main_read_screen(pucFrame, 0);
 
     // write the image to a PNG
     int rval = SaveRGBBufferToFile(filename, pucFrame, width, height, width * 3);
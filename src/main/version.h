@@ -29,7 +29,7 @@
 
 #define FRONTEND_API_VERSION 0x020106
 #define CONFIG_API_VERSION   0x020302
-#define DEBUG_API_VERSION    0x020001
+#define DEBUG_API_VERSION    0x020002
 #define VIDEXT_API_VERSION   0x030300
 #define NETPLAY_API_VERSION  0x010001
 
@@ -0,0 +1,155 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rsp_thread.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "rsp_thread.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "api/vidext.h"
+
+static SDL_Thread* l_thread = NULL;
+static SDL_sem* l_start = NULL;
+static SDL_sem* l_done = NULL;
+
+static uint32_t l_cycles;
+static int l_busy = 0;
+static int l_quit = 0;
+
+static SDL_Window* l_window = NULL;
+static SDL_GLContext l_context = NULL;
+
+static int rsp_thread_handler(void* data)
+{
+    for (;;) {
+        SDL_SemWait(l_start);
+        if (l_quit) {
+            break;
+        }
+
+        if (l_context != NULL) {
+            SDL_GL_MakeCurrent(l_window, l_context);
+        }
+
+        rsp.doRspCycles(l_cycles);
+
+        if (l_context != NULL) {
+            SDL_GL_MakeCurrent(l_window, NULL);
+        }
+
+        SDL_SemPost(l_done);
+    }
+
+    return 0;
+}
+
+int rsp_thread_init(void)
+{
+    if (l_thread != NULL) {
+        return 0;
+    }
+
+    /* Only a GL context created through the core's own SDL video extension
+     * can be moved to the RSP thread */
+    if (VidExt_Overridden() || SDL_GL_GetCurrentContext() == NULL) {
+        DebugMessage(M64MSG_WARNING, "No core SDL GL context to hand to the RSP thread, running graphics tasks synchronously");
+        return -1;
+    }
+
+    l_start = SDL_CreateSemaphore(0);
+    l_done = SDL_CreateSemaphore(0);
+    l_quit = 0;
+    l_busy = 0;
+
+    if (l_start != NULL && l_done != NULL) {
+        l_thread = SDL_CreateThread(rsp_thread_handler, "m64pRSP", NULL);
+    }
+
+    if (l_thread == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not create RSP thread, running tasks synchronously");
+        rsp_thread_shutdown();
+        return -1;
+    }
+
+    return 0;
+}
+
+void rsp_thread_shutdown(void)
+{
+    if (l_thread != NULL) {
+        rsp_thread_wait();
+        l_quit = 1;
+        SDL_SemPost(l_start);
+        SDL_WaitThread(l_thread, NULL);
+        l_thread = NULL;
+    }
+
+    if (l_start != NULL) {
+        SDL_DestroySemaphore(l_start);
+        l_start = NULL;
+    }
+    if (l_done != NULL) {
+        SDL_DestroySemaphore(l_done);
+        l_done = NULL;
+    }
+}
+
+int rsp_thread_active(void)
+{
+    return l_thread != NULL;
+}
+
+void rsp_thread_run(uint32_t cycles)
+{
+    if (l_thread == NULL) {
+        rsp.doRspCycles(cycles);
+        return;
+    }
+
+    rsp_thread_wait();
+
+    /* a GL context can only be current on one thread at a time */
+    l_window = SDL_GL_GetCurrentWindow();
+    l_context = SDL_GL_GetCurrentContext();
+    if (l_context != NULL) {
+        SDL_GL_MakeCurrent(l_window, NULL);
+    }
+
+    l_cycles = cycles;
+    l_busy = 1;
+    SDL_SemPost(l_start);
+}
+
+void rsp_thread_wait(void)
+{
+    if (!l_busy) {
+        return;
+    }
+
+    SDL_SemWait(l_done);
+    l_busy = 0;
+
+    if (l_context != NULL) {
+        SDL_GL_MakeCurrent(l_window, l_context);
+    }
+}
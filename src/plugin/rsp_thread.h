@@ -0,0 +1,75 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rsp_thread.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_PLUGIN_RSP_THREAD_H
+#define M64P_PLUGIN_RSP_THREAD_H
+
+#include <stdint.h>
+
+#include "osal/preproc.h"
+#include "plugin.h"
+
+#ifdef M64P_PARALLEL
+
+/* Start and stop the thread on which rsp_thread_run hands tasks to the
+ * RSP plugin. Without it, tasks run synchronously. Starting fails unless
+ * a GL context from the core's SDL video extension is current. */
+int rsp_thread_init(void);
+void rsp_thread_shutdown(void);
+
+/* Whether the thread was started */
+int rsp_thread_active(void);
+
+/* Call rsp.doRspCycles(cycles) on the RSP thread. The GL context current
+ * on the calling thread, if any, moves with the task. */
+void rsp_thread_run(uint32_t cycles);
+
+/* Wait for the task started by rsp_thread_run, and take the GL context back */
+void rsp_thread_wait(void);
+
+#else
+
+static osal_inline int rsp_thread_init(void)
+{
+    return 0;
+}
+
+static osal_inline void rsp_thread_shutdown(void)
+{
+}
+
+static osal_inline int rsp_thread_active(void)
+{
+    return 0;
+}
+
+static osal_inline void rsp_thread_run(uint32_t cycles)
+{
+    rsp.doRspCycles(cycles);
+}
+
+static osal_inline void rsp_thread_wait(void)
+{
+}
+
+#endif
+
+#endif /* M64P_PLUGIN_RSP_THREAD_H */
@@ -0,0 +1,100 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - pak_crc_bench.c                                         *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Micro-benchmark comparing the table driven joybus data CRC
+ * with the original bit by bit implementation.
+ *
+ * compile with: gcc -O2 -o pak_crc_bench -I../src pak_crc_bench.c ../src/device/controllers/joybus_crc.c
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "device/controllers/joybus_crc.h"
+
+enum { BLOCK_SIZE = 0x20, BLOCKS_COUNT = 1024, ITERATIONS = 2000 };
+
+/* original implementation, kept as reference */
+static uint8_t bitwise_data_crc(const uint8_t* data, size_t size)
+{
+    size_t i;
+    uint8_t crc = 0;
+
+    for(i = 0; i <= size; ++i)
+    {
+        int mask;
+        for (mask = 0x80; mask >= 1; mask >>= 1)
+        {
+            uint8_t xor_tap = (crc & 0x80) ? 0x85 : 0x00;
+            crc <<= 1;
+            if (i != size && (data[i] & mask)) crc |= 1;
+            crc ^= xor_tap;
+        }
+    }
+    return crc;
+}
+
+static double bench(uint8_t (*crc_func)(const uint8_t*, size_t), const uint8_t* blocks, unsigned int* sink)
+{
+    unsigned int i, k;
+    clock_t start = clock();
+
+    for (k = 0; k < ITERATIONS; ++k) {
+        for (i = 0; i < BLOCKS_COUNT; ++i) {
+            *sink += crc_func(blocks + i * BLOCK_SIZE, BLOCK_SIZE);
+        }
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(void)
+{
+    static uint8_t blocks[BLOCKS_COUNT * BLOCK_SIZE];
+    unsigned int i, sink = 0;
+    double t_bitwise, t_table;
+
+    srand(0x64);
+    for (i = 0; i < sizeof(blocks); ++i) {
+        blocks[i] = (uint8_t)rand();
+    }
+
+    /* check both implementations agree */
+    for (i = 0; i < BLOCKS_COUNT; ++i) {
+        size_t size = (i % BLOCK_SIZE) + 1;
+        if (bitwise_data_crc(blocks + i * BLOCK_SIZE, size) != joybus_data_crc(blocks + i * BLOCK_SIZE, size)) {
+            printf("CRC mismatch for block %u (size %u)\n", i, (unsigned int)size);
+            return EXIT_FAILURE;
+        }
+    }
+
+    t_bitwise = bench(bitwise_data_crc, blocks, &sink);
+    t_table = bench(joybus_data_crc, blocks, &sink);
+
+    printf("%u blocks of %u bytes\n", BLOCKS_COUNT * ITERATIONS, BLOCK_SIZE);
+    printf("bitwise: %.3f s (%.1f ns/block)\n", t_bitwise, 1e9 * t_bitwise / (BLOCKS_COUNT * ITERATIONS));
+    printf("table:   %.3f s (%.1f ns/block)\n", t_table, 1e9 * t_table / (BLOCKS_COUNT * ITERATIONS));
+    printf("speedup: %.1fx (checksum %u)\n", t_bitwise / t_table, sink);
+
+    return EXIT_SUCCESS;
+}